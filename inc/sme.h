@@ -118,6 +118,12 @@ typedef SME_UINT32 SME_EVENT_ID_T;
 #define SME_EVENT_STATE_TIMER	(SME_EVENT_TYPE_PREDEFINE | 5) /* State built-in timer event */
 #define SME_EVENT_COND_ELSE		(SME_EVENT_TYPE_PREDEFINE | 6)
 #define SME_EVENT_EXIT_LOOP		(SME_EVENT_TYPE_PREDEFINE | 7)
+#define SME_EVENT_START_REGION	(SME_EVENT_TYPE_PREDEFINE | 8) /* Restart a parked region thread. */
+#define SME_EVENT_REGION_ENDED	(SME_EVENT_TYPE_PREDEFINE | 9) /* A region thread acknowledges an asynchronous exit. */
+#define SME_EVENT_REGIONS_EXITED	(SME_EVENT_TYPE_PREDEFINE | 10) /* All region threads of an exited orthogonal state have stopped. */
+#define SME_EVENT_SHARD_ADD_APP	(SME_EVENT_TYPE_PREDEFINE | 11) /* Activate an application at a shard thread. */
+#define SME_EVENT_SHARD_REMOVE_APP	(SME_EVENT_TYPE_PREDEFINE | 12) /* Deactivate an application at a shard thread. */
+#define SME_EVENT_ADVANCE_TIME	(SME_EVENT_TYPE_PREDEFINE | 13) /* Advance the virtual clock of a thread by SmeAdvanceTime(). */
 
 #define SME_INIT_CHILD_STATE_ID (SME_EVENT_TYPE_PREDEFINE | 100)
 #define SME_JOIN_STATE_ID		(SME_EVENT_TYPE_PREDEFINE | 101)
@@ -154,6 +160,23 @@ typedef enum
 } SME_EVENT_CAT_E;
 typedef unsigned char SME_EVENT_CAT_T;
 
+/* The priority class of an external event. An external event pool receives higher priority events first.
+The priority travels in the upper bits of the category of an external event, and it is cleared on receiving. */
+typedef enum
+{
+	SME_EVENT_PRIORITY_NORMAL=0,
+	SME_EVENT_PRIORITY_HIGH,
+	SME_EVENT_PRIORITY_URGENT,
+	SME_EVENT_PRIORITY_NUM
+} SME_EVENT_PRIORITY_E;
+typedef unsigned char SME_EVENT_PRIORITY_T;
+
+#define SME_EVENT_PRIORITY_SHIFT	6
+#define SME_EVENT_CAT_MASK	((1<<SME_EVENT_PRIORITY_SHIFT)-1)
+#define SME_EVENT_CAT_WITH_PRIORITY(_nCat,_nPriority) ((unsigned char)(((_nCat)&SME_EVENT_CAT_MASK) | ((_nPriority)<<SME_EVENT_PRIORITY_SHIFT)))
+#define SME_EVENT_CAT_OF(_nCat) ((_nCat)&SME_EVENT_CAT_MASK)
+#define SME_EVENT_PRIORITY_OF(_nCat) (((unsigned char)(_nCat))>>SME_EVENT_PRIORITY_SHIFT)
+
 typedef enum 
 {
 	SME_EVENT_ORIGIN_INTERNAL=0,
@@ -343,7 +366,7 @@ and dispatching events to specific applications.
 		strncpy(sAppName,_sAppName,sizeof(sAppName)-1); 
 		pRoot=_pRoot; 
 		pSME_NULL_GUARD=&SME_APP_T::SME_NULL_GUARD; 
-		pParent=pNext=NULL; pRegionThreadContextList=NULL;
+		pParent=pNext=NULL; pRegionThreadContextList=NULL; nTimerSlack=0; pMailbox=NULL; bForkJoin=FALSE;
 	};
 	int SME_NULL_ACTION(SME_APP_T *, SME_EVENT_T *){return TRUE;}; 
 	int SME_NULL_GUARD(SME_APP_T *, SME_EVENT_T *){return TRUE;}; 
@@ -357,8 +380,19 @@ and dispatching events to specific applications.
 
 	void *pRegionThreadContextList; /* Point to the region thread context list for all orthogonal regions. The first item is the current thread context.*/
     int nRegionId; /* Index of current region, when creating a Multi-Region */
+	unsigned int nTimerSlack; /* The milli-seconds the timers of this application may expire late, set by SmeSetTimerSlack(). */
+	void *pMailbox; /* The mailbox of the executor which runs this application, or NULL if it runs at a thread context. */
+	BOOL bForkJoin; /* A region of SME_RUN_MODE_PARALLEL, which handles the events in parallel with its sibling regions. */
 }SME_APP_T, *SME_APP_PT;
 
+/* The timer backends round a deadline up to a multiple of the slack of the destination application, so that 
+the timers expiring within a slack window are batched into a single wakeup and dispatch pass. The built-in timing wheel is 
+compiled out by NO_TIMER_SUPPORT in this tree, so here the slack applies to the high-resolution and the per-thread timers, 
+and to the timer functions of the embedder if they round by SME_TIMER_SLACK_ROUND_UP(). */
+#define SME_GET_TIMER_SLACK(_pApp) ((_pApp) ? (_pApp)->nTimerSlack : 0)
+#define SME_TIMER_SLACK_ROUND_UP(_Deadline, _Slack) \
+	(0!=(_Slack) ? (_Deadline) + ((_Slack) - (_Deadline) % (_Slack)) % (_Slack) : (_Deadline))
+
 #define SME_APP_DATA(app) (app->pData)
 #define SME_GET_APP_STATE(app) (app->pAppState) 
 #define SME_IS_ACTIVATED(app) (app->pAppState!=SME_NULL_STATE)
@@ -368,6 +402,15 @@ struct SME_THREAD_CONTEXT_T_TAG;
 *  State Machine Engine hook function prototypes.
 *********************************************************************************************************/
 typedef BOOL (*SME_GET_EXT_EVENT_PROC_T)(SME_EVENT_T *pEvent);
+
+/* Wait for an external event no longer than nTimeOut milli-seconds, and return one of the following values. */
+typedef enum
+{
+	SME_EXT_EVENT_EXIT=0, /* The thread is requested to exit. */
+	SME_EXT_EVENT_GOT,
+	SME_EXT_EVENT_TIMEOUT
+} SME_EXT_EVENT_WAIT_E;
+typedef int (*SME_GET_EXT_EVENT_TIMEOUT_PROC_T)(SME_EVENT_T *pEvent, unsigned int nTimeOut);
 typedef BOOL (*SME_DEL_EXT_EVENT_PROC_T)(SME_EVENT_T *pEvent);
  
 typedef int (*SME_POST_THREAD_EXT_INT_EVENT_PROC_T)(struct SME_THREAD_CONTEXT_T_TAG* pDestThreadContext, int nMsgID, int Param1, int Param2, 
@@ -376,7 +419,38 @@ typedef int (*SME_POST_THREAD_EXT_INT_EVENT_PROC_T)(struct SME_THREAD_CONTEXT_T_
 typedef int (*SME_POST_THREAD_EXT_PTR_EVENT_PROC_T)(struct SME_THREAD_CONTEXT_T_TAG* pDestThreadContext, int nMsgID, void *pData, int nDataSize, 
 						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory);
 
+/* Descriptor of an external event for SmePostThreadExtEventBatch(). 
+nDataFormat selects Data.Int (nParam1, nParam2) or Data.Ptr (pData, nSize); the pointer data is copied on posting. 
+Use SME_EVENT_CAT_WITH_PRIORITY() on nCategory to post an event of a higher priority. */
+typedef struct SME_EXT_EVENT_DESC_TAG
+{
+	int nMsgID;
+	SME_EVENT_DATA_FORMAT_T nDataFormat;
+	unsigned char nCategory;
+	union SME_EVENT_DATA_T Data;
+	SME_APP_T *pDestApp;
+	unsigned long nSequenceNum;
+} SME_EXT_EVENT_DESC;
+
+typedef int (*SME_POST_THREAD_EXT_EVENT_BATCH_PROC_T)(struct SME_THREAD_CONTEXT_T_TAG* pDestThreadContext, 
+						   const SME_EXT_EVENT_DESC *pEvents, int nNum);
+
+/* Run pfnTask(pParam, i) for each i from 0 to nTaskNum-1 in parallel, and return after all of them have completed. */
+typedef void (*SME_FORK_TASK_PROC_T)(void *pParam, int nIndex);
+typedef void (*SME_FORK_JOIN_PROC_T)(SME_FORK_TASK_PROC_T pfnTask, void *pParam, int nTaskNum);
+
+/* Post an external event to the mailbox of an application which has one, instead of the destination thread. */
+typedef int (*SME_POST_APP_EXT_EVENT_PROC_T)(SME_APP_T *pDestApp, const SME_EXT_EVENT_DESC *pEvent);
+
 typedef BOOL (*SME_INIT_THREAD_EXT_MSG_BUF_PROC_T)();
+
+/* Create or destroy the external event pool of a given thread context, which is not the current one. */
+typedef BOOL (*SME_CREATE_EXT_MSG_POOL_PROC_T)(struct SME_THREAD_CONTEXT_T_TAG *pThreadContext);
+typedef BOOL (*SME_DESTROY_EXT_MSG_POOL_PROC_T)(struct SME_THREAD_CONTEXT_T_TAG *pThreadContext);
+/* Fork the calling process for a region. Return the process ID at the parent, 0 at the child, or -1 on failure. */
+typedef int (*SME_FORK_REGION_PROCESS_PROC_T)(void);
+/* Wait for a region process to exit. */
+typedef int (*SME_WAIT_REGION_PROCESS_PROC_T)(int nPid);
 typedef BOOL (*SME_FREE_THREAD_EXT_MSG_BUF_PROC_T)();
 
 typedef void* (*SME_MEM_ALLOC_PROC_T)(unsigned int nSize);
@@ -386,8 +460,22 @@ typedef int (*SME_ON_EVENT_COME_HOOK_T)(SME_EVENT_ORIGIN_T nEventOrigin, SME_EVE
 typedef int (*SME_ON_EVENT_HANDLE_HOOK_T)(SME_EVENT_ORIGIN_T nEventOrigin, SME_EVENT_T *pEvent, 
 										  SME_APP_T *pDestApp, SME_STATE_T* pNewState);
 
+/* The state timer function gets nTimeOut encoded by SME_STATE_BUILT_IN_TIMEOUT_VAL(). The state timer is periodic, 
+and the engine kills it when the state exits. 
+
+After SmeSetOneShotStateTimers(TRUE), the engine sets the one-shot bit 0x40000000 as well (see SME_ONE_SHOT_TIMEOUT_VAL()), 
+so that a state time-out whose handler does not transit fires once. Opt in only with a timer function which: 
+ - takes the elapse by SME_GET_TIMEOUT_VAL(), which clears the one-shot bit as well; 
+ - when SME_IS_ONE_SHOT_TIMEOUT_VAL() is set, fires once and does not restart the timer; 
+ - lets the kill function fail harmlessly on the handle of an expired one-shot timer, which the engine kills when the state exits, 
+   and never kills another timer which reuses that handle. 
+The built-in, the high resolution and the per-thread timers do. */
 typedef unsigned int (*SME_STATE_TIMER_PROC_T)(SME_APP_T *pDestApp, unsigned  int nTimeOut); 
 typedef int (*SME_KILL_TIMER_PROC_T)(unsigned  int handle); 
+/* Restart an armed timer with a new time-out value. Return the new handle, which differs from the old one, or 0 if the timer does not exist. */
+typedef unsigned int (*SME_REARM_TIMER_PROC_T)(unsigned  int handle, unsigned  int nTimeOut); 
+/* Kill several timers at once, skipping 0 handles. Return the number of timers killed. */
+typedef int (*SME_KILL_TIMERS_PROC_T)(const unsigned int *pHandles, int nNum); 
 
 /********************************************************************************************************
 *  State Machine Engine multi-thread support.
@@ -404,29 +492,65 @@ typedef struct SME_THREAD_CONTEXT_T_TAG{
 	unsigned long		nAppThreadID;
 	void *pData; /* Preserved for application. */
 	void *pExtEventPool; /* A pointer to the external event pool information. */
+	void *pTimers; /* The per-thread timers, which are serviced by SmeRun(). */
+	void *pRegionPool; /* The parked region threads of the orthogonal states at this thread. */
+	struct SME_THREAD_CONTEXT_T_TAG *pForkParent; /* The forking thread while this thread runs a region task of SME_RUN_MODE_PARALLEL. */
+	unsigned int nForkTicket; /* The ticket lock on the per-thread timers, which the region tasks forked here share. */
+	unsigned int nForkServing;
+	SME_UINT64 nVirtualClockNs; /* The nano-seconds which SmeAdvanceTime() has moved the virtual clock of the thread. */
 }SME_THREAD_CONTEXT_T, *SME_THREAD_CONTEXT_PT;
 
+/* The thread context which owns the timers set at a thread context, and gets their time-out events: the forking thread 
+while the thread runs a region task of SME_RUN_MODE_PARALLEL, otherwise the thread itself. */
+#define SME_OWNER_THREAD_CONTEXT(_p) (((_p) && (_p)->pForkParent) ? (_p)->pForkParent : (_p))
+
 typedef BOOL (*SME_SET_THREAD_CONTEXT_PROC)(SME_THREAD_CONTEXT_PT p);
 typedef SME_THREAD_CONTEXT_PT (*SME_GET_THREAD_CONTEXT_PROC)();
 
-/* On orthogonal state entry, the child regions may run at the parent thread or an independent thread. 
+/* On orthogonal state entry, the child regions may run at the parent thread, an independent thread or an independent process. 
 On orthogonal state exit, deactivate the child region(s) which runs at the parent thread,  
 and the orthogonal state will post SME_EVENT_EXIT_LOOP events
-to the running region threads, and hold these regions to exit their threads. 
+to the running region threads and processes, and hold these regions to exit their threads and processes. 
+
+A region process is forked from the parent thread, so it exchanges events with the parent through an external event 
+transport in shared memory, which is installed by SmeSetExtEventOprProc() and SmeSetExtMsgPoolProc(). The process is 
+forked and waited for by the plugin installed by SmeSetRegionProcessProc(). Both plugins are required: without them, 
+or if the transport can not create the event pool or the process can not be forked, the engine asserts and the regions 
+from this one on are not entered.
+
+The regions of SME_RUN_MODE_PARALLEL are activated at the parent thread as SME_RUN_MODE_PARENT_THREAD, but an event 
+to them is forked to the sibling regions by the plugin installed by SmeSetForkJoinProc(), and the parent thread joins 
+them before it goes on with the next application. Each region handles the event and the internal events which it 
+triggers to completion within its task, so the parent sees the same order of completion as with SME_RUN_MODE_PARENT_THREAD. 
+Wherever a task runs, its per-thread timers and the time-out events of its timers go to the parent thread, which serves 
+them after the join. A parallel region sees itself as the only active application of the thread while it handles an 
+event, so it can not activate or deactivate an application, nor have an orthogonal state: the engine asserts and 
+refuses them. 
+Unlike SME_RUN_MODE_PARENT_THREAD, the event goes to all the parallel sibling regions, even if one of them consumes it, 
+since they handle it at the same time. It is consumed for the applications after them if any of the regions consumes it. 
+Without the plugin, the regions handle the event one after another at the parent thread, and all of them get it as well.
 */
 typedef enum 
 {
 	SME_RUN_MODE_PARENT_THREAD=0,
 	SME_RUN_MODE_SEPARATE_THREAD,
-	SME_RUN_MODE_SEPARATE_PROCESS /* Unsupported for the time being. */
+	SME_RUN_MODE_SEPARATE_PROCESS, /* Linux only. */
+	SME_RUN_MODE_PARALLEL
 } SME_REGION_RUN_MODE_E;
 
+#define SME_NUMA_NODE_ANY	-1
+
+/* A region running at an independent thread or process is placed by nCpuMask and nNumaNode, which are defined by 
+SME_MULTI_REGION_DEF_EX(). The region thread binds itself before it creates its thread context and event pools, so 
+that they are allocated on the node. The placement is not applied to a region running at the parent thread. */
 typedef struct SME_REGION_CONTEXT_T_TAG{
 	const char* sRegionName;
 	int nInstanceNum;
 	SME_STATE_T *pRoot;
 	int nRunningMode; /* Running mode for the region state machine. */
 	int nPriority; /* The priority of the running thread. */
+	unsigned long nCpuMask; /* The processors the running thread is bound to, bit n for processor n, or 0 for any processor. */
+	int nNumaNode; /* The NUMA node the running thread and its memory are placed on, or SME_NUMA_NODE_ANY. */
 } SME_REGION_CONTEXT_T;
 
 /******************************************************************************************
@@ -596,8 +720,8 @@ typedef struct SME_REGION_CONTEXT_T_TAG{
 		SME_REGION_CONTEXT_T _HandlerClass::SME_STATE_REGION_TBL_REF(_state)[] =						\
 		{
 
-	#define SME_MULTI_REGION_DEF(_RegionName,_InstanceNum, _Region, _RunMode, _nPriority) \
-        {#_RegionName, _InstanceNum, &C##_Region::SME_COMPSTATE_REF(_Region), _RunMode, _nPriority}, 
+	#define SME_MULTI_REGION_DEF_EX(_RegionName,_InstanceNum, _Region, _RunMode, _nPriority, _nCpuMask, _nNumaNode) \
+        {#_RegionName, _InstanceNum, &C##_Region::SME_COMPSTATE_REF(_Region), _RunMode, _nPriority, _nCpuMask, _nNumaNode}, 
 
 	#define SME_END_ORTHO_STATE_DEF \
         NULL,NULL,0,0};
@@ -759,7 +883,7 @@ typedef struct SME_REGION_CONTEXT_T_TAG{
     */
 	#define SME_APPLICATION_DEF(_app_name, _root_state) \
 		SME_APP_T _app_name##App = { \
-		#_app_name, &SME_COMPSTATE_REF(_root_state), SME_NULL_STATE, SME_NULL_STATE, {0}, 0, NULL, NULL, NULL, NULL, SME_REGIONID_ROOT_APP};
+		#_app_name, &SME_COMPSTATE_REF(_root_state), SME_NULL_STATE, SME_NULL_STATE, {0}, 0, NULL, NULL, NULL, NULL, SME_REGIONID_ROOT_APP, 0, NULL, FALSE};
 
 	/* Get application variable name. */
 	#define SME_GET_APP_VAR(_app) _app##App
@@ -781,16 +905,20 @@ typedef struct SME_REGION_CONTEXT_T_TAG{
 		SME_REGION_CONTEXT_T SME_STATE_REGION_TBL_REF(_state)[] =						\
 		{
 
-	#define SME_MULTI_REGION_DEF(_RegionName,_InstanceNum, _Region, _RunMode, _nPriority) \
-        {#_RegionName, _InstanceNum, &SME_COMPSTATE_REF(_Region), _RunMode, _nPriority}, 
+	#define SME_MULTI_REGION_DEF_EX(_RegionName,_InstanceNum, _Region, _RunMode, _nPriority, _nCpuMask, _nNumaNode) \
+        {#_RegionName, _InstanceNum, &SME_COMPSTATE_REF(_Region), _RunMode, _nPriority, _nCpuMask, _nNumaNode}, 
 
 	#define SME_END_ORTHO_STATE_DEF \
-		{NULL, 0, NULL, 0, 0}       \
+		{NULL, 0, NULL, 0, 0, 0, SME_NUMA_NODE_ANY}       \
 			};
 
 #endif /* SME_CPP=FALSE */
 
+#define SME_MULTI_REGION_DEF(_RegionName,_InstanceNum, _Region, _RunMode, _nPriority) \
+	SME_MULTI_REGION_DEF_EX(_RegionName, _InstanceNum, _Region, _RunMode, _nPriority, 0, SME_NUMA_NODE_ANY)
 #define SME_REGION_DEF(_RegionName, _Region, _RunMode, _nPriority) SME_MULTI_REGION_DEF(_RegionName, 1, _Region, _RunMode, _nPriority)
+#define SME_REGION_DEF_EX(_RegionName, _Region, _RunMode, _nPriority, _nCpuMask, _nNumaNode) \
+	SME_MULTI_REGION_DEF_EX(_RegionName, 1, _Region, _RunMode, _nPriority, _nCpuMask, _nNumaNode)
 
 /* Use SME_CURR_DEFAULT_PARENT as the default parent of all sibling states under a composite state. */
 #define SME_BEGIN_LEAF_STATE_DEF_P(_state, _entry, _exit) \
@@ -814,6 +942,7 @@ BOOL SmeActivateApp(SME_APP_T *pNewApp, SME_APP_T *pParentApp);
 BOOL SmeDeactivateApp(SME_APP_T *pApp);
 BOOL SmeSetFocus(SME_APP_T *pApp);
 BOOL SmeDispatchEvent(SME_EVENT_T *pEvent, SME_APP_T *pApp);
+BOOL SmeDispatchAppEvent(SME_EVENT_T *pEvent, SME_APP_T *pApp);
 void SmeRun();
 
 typedef int (* SME_INIT_CALLBACK_T)(void *);  
@@ -838,8 +967,45 @@ int SmePostThreadExtIntEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgI
 						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory);
 int SmePostThreadExtPtrEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, void *pData, int nDataSize, 
 						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory);
+int SmePostThreadExtIntEventEx(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, int Param1, int Param2, 
+						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory, SME_EVENT_PRIORITY_T nPriority);
+int SmePostThreadExtPtrEventEx(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, void *pData, int nDataSize, 
+						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory, SME_EVENT_PRIORITY_T nPriority);
+int SmePostThreadExtEventBatch(SME_THREAD_CONTEXT_T* pDestThreadContext, const SME_EXT_EVENT_DESC *pEvents, int nNum);
+SME_POST_APP_EXT_EVENT_PROC_T SmeSetAppExtEventProc(SME_POST_APP_EXT_EVENT_PROC_T fnPostAppExtEvent);
+void SmeSetForkJoinProc(SME_FORK_JOIN_PROC_T pfnForkJoin);
 SME_EVENT_HANDLER_T SmeSetEventFilterOprProc(SME_EVENT_HANDLER_T pfnEventFilter);
 void SmeSetTimerProc(SME_STATE_TIMER_PROC_T pfnTimerProc, SME_KILL_TIMER_PROC_T pfnKillTimerProc);
+void SmeSetTimerRearmProc(SME_REARM_TIMER_PROC_T pfnRearmTimerProc);
+void SmeSetKillTimersProc(SME_KILL_TIMERS_PROC_T pfnKillTimersProc);
+void SmeSetOneShotStateTimers(BOOL bOneShot);
+BOOL SmeSetTimerSlack(SME_APP_T *pApp, unsigned int nSlack);
+
+/* Per-thread timers are owned by the calling thread and expire at its SmeRun() loop, which dispatches the time-out events inline, 
+without a timer thread or a global lock. They should be set and killed at the owner thread, or at the region tasks of 
+SME_RUN_MODE_PARALLEL which it forks, which take turns on them. 
+SmeSetTimerProc(SmeSetThreadTimer, SmeKillThreadTimer) and SmeSetTimerRearmProc(SmeRearmThreadTimer) run the state 
+built-in timers as per-thread timers. 
+The SmeRun() loop waits for the next expiry by the hook which SmeSetExtEventTimeoutProc() installs. Without the hook, 
+SmeSetThreadTimer() fails unless the virtual clock is on, because SmeRun() would block past the deadlines. */
+unsigned int SmeSetThreadTimer(SME_APP_T *pDestApp, unsigned int nTimeOut);
+int SmeKillThreadTimer(unsigned int nHandle);
+unsigned int SmeRearmThreadTimer(unsigned int nHandle, unsigned int nTimeOut);
+unsigned int SmeGetThreadTimerRemain(unsigned int nHandle);
+void SmeSetExtEventTimeoutProc(SME_GET_EXT_EVENT_TIMEOUT_PROC_T fnGetExtEventTimeout);
+
+SME_UINT64 SmeClockNowNs(void);
+
+/* Virtual time for deterministic simulation. Each thread has its own virtual clock, which starts at nNowNs, 
+and moves only when SmeAdvanceTime() advances it. The per-thread timers of a thread, and so the state built-in timers 
+installed by SmeSetTimerProc(SmeSetThreadTimer, SmeKillThreadTimer), expire in deadline order as its clock passes them. 
+SmeAdvanceTime() on the context of another thread posts SME_EVENT_ADVANCE_TIME to it, and the thread advances its clock 
+at SmeRun(). While the virtual clock is on, the high resolution timer sets per-thread timers instead, and so does the 
+built-in XSetTimer() timer for time-out events; a timer with a callback function can not be set. The XSetTimer() timer 
+of an embedder keeps the real time. */
+void SmeSetVirtualClock(BOOL bVirtual, SME_UINT64 nNowNs);
+BOOL SmeIsVirtualClock(void);
+BOOL SmeAdvanceTime(SME_THREAD_CONTEXT_T *pThreadContext, SME_UINT64 nNs);
 
 void SmeSetExtEventOprProc(SME_GET_EXT_EVENT_PROC_T fnGetExtEvent, 
 						   SME_DEL_EXT_EVENT_PROC_T fnDelExtEvent,
@@ -847,6 +1013,7 @@ void SmeSetExtEventOprProc(SME_GET_EXT_EVENT_PROC_T fnGetExtEvent,
 	SME_POST_THREAD_EXT_PTR_EVENT_PROC_T fnPostThreadExtPtrEvent,
 	SME_INIT_THREAD_EXT_MSG_BUF_PROC_T fnInitThreadExtMsgBuf,
 	SME_INIT_THREAD_EXT_MSG_BUF_PROC_T fnFreeThreadExtMsgBuf);
+void SmeSetExtEventBatchProc(SME_POST_THREAD_EXT_EVENT_BATCH_PROC_T fnPostThreadExtEventBatch);
 
 SME_ON_EVENT_COME_HOOK_T SmeSetOnEventComeHook(SME_ON_EVENT_COME_HOOK_T pOnEventComeHook);
 SME_ON_EVENT_HANDLE_HOOK_T SmeSetOnEventHandleHook(SME_ON_EVENT_HANDLE_HOOK_T pOnEventHandleHook);
@@ -856,6 +1023,8 @@ BOOL SmeMFreeRelease(void *pUserData);
 void SmeSetMemOprProc(SME_MEM_ALLOC_PROC_T fnMAllocProc, SME_MEM_FREE_PROC_T fnMFreeProc);
 
 void SmeSetTlsProc(SME_SET_THREAD_CONTEXT_PROC pfnSetThreadContext, SME_GET_THREAD_CONTEXT_PROC pfnGetThreadContext);
+void SmeSetExtMsgPoolProc(SME_CREATE_EXT_MSG_POOL_PROC_T fnCreateExtMsgPool, SME_DESTROY_EXT_MSG_POOL_PROC_T fnDestroyExtMsgPool);
+void SmeSetRegionProcessProc(SME_FORK_REGION_PROCESS_PROC_T fnForkRegionProcess, SME_WAIT_REGION_PROCESS_PROC_T fnWaitRegionProcess);
 
 #if SME_UI_SUPPORT
 	#define SME_SET_FOCUS SmeSetFocus
@@ -868,6 +1037,18 @@ BOOL SmeDestroyApp(SME_APP_T *pApp);
 
 int SmeGetRegions(SME_APP_T *pApp, int nCount, SME_APP_T *pRegionAppList[], SME_THREAD_CONTEXT_T *pRegionThreadContextList[]);
 
+/* Keep up to nMaxIdle separate thread regions parked at each thread after its orthogonal states exit, with their thread 
+contexts and external event buffers initialized, and reuse them on the next entry of a region with the same placement. 
+It is 0 by default, which creates a thread on each entry and ends it on exit. */
+void SmeSetRegionThreadPoolSize(int nMaxIdle);
+/* End the parked region threads of the calling thread. Call it before the thread exits. */
+void SmeFreeRegionThreadPool();
+/* Wait at most nTimeOut milli-seconds for the separate thread regions on an orthogonal state exit, 0 for no wait. The 
+region threads post their acknowledgements to the exiting thread, which reaps them in SmeRun() and then posts the internal 
+event SME_EVENT_REGIONS_EXITED to the application. It is XINFINITE by default, which waits for all region threads to stop 
+without the event. The separate process regions are always waited for. */
+void SmeSetRegionExitTimeout(unsigned int nTimeOut);
+
 /********************************************************************************************************** 
  * Macro to avoid compiler warning when a formal parameter is not used within a function.
  * This can happen if the function prototype is forced from outside, e.g. a callback for a system call,
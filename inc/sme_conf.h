@@ -73,6 +73,19 @@
 #define SME_EVENT_POOL_SIZE			8   /* The size of the pool for internal events */
 #define SME_MAX_APP_NAME_LEN    64
 #define SME_MAX_STR_BUF_LEN		513 /* The maximum string buffer length of output debugging string. */
+#define SME_MAX_EXT_EVENT_LANES	8   /* The maximum number of producer threads with an own lock-free lane into a thread's external event pool at once. The lane of an exited thread is taken over. 0 to disable lanes. */
+#define SME_EXT_EVENT_LANE_SIZE	64  /* The number of external events a lane holds. It should be a power of 2. */
+#define SME_TIMER_SLOT_BITS		20   /* Up to 2^20 built-in timers, high-resolution timers, or per-thread timers of a thread, are armed at once. The other bits of a timer handle count the reuses of its slot. */
+#define SME_EXT_EVENT_PRIORITY_BUF_SIZE	16  /* The number of external events of each priority class above normal a thread's external event pool holds. */
+#define SME_SHM_MSG_BUF_SIZE	64  /* The number of external events a shared-memory event pool holds. */
+#define SME_SHM_EVENT_DATA_SIZE	256 /* The maximum data size of a pointer event posted through shared memory. */
+#define SME_UDS_FRAME_SIZE		4096 /* The maximum size of an external event frame on a Unix domain socket, including the header. */
+#define SME_UDS_BATCH_SIZE		32  /* The maximum number of frames sent or received by one system call. */
+#define SME_UDS_MAX_PEERS		16  /* The maximum number of connected processes to a thread's Unix domain socket. */
+#define SME_CLOCK_TSC			FALSE /* TRUE to read the clock by the time stamp counter on x86, calibrated against the monotonic clock. It needs an invariant TSC. */
+#define SME_EXECUTOR_BATCH_SIZE	32  /* The maximum number of events an executor worker handles for an application before it turns to the other ready applications. */
+#define SME_SHARD_KEY_HASH_SIZE	1024 /* The number of hash chains indexing the keys of the sharded applications. It should be a power of 2. */
+#define SME_MAX_PARALLEL_REGIONS	32  /* The maximum number of SME_RUN_MODE_PARALLEL regions an event is forked to at once. More regions are forked in several rounds. */
 
 #define SME_REGION_NAME_FMT "%s:%d"
 //#define SME_DEF_DBGLOG_FILE         "/var/sme.log"
@@ -86,6 +99,11 @@
 typedef unsigned int SME_UINT32;
 typedef int SME_INT32;
 typedef unsigned char SME_BYTE;
+#if defined(_MSC_VER)
+typedef unsigned __int64 SME_UINT64;
+#else
+typedef unsigned long long SME_UINT64;
+#endif
 
 
 /*******************************************************************************************
@@ -107,6 +125,8 @@ typedef unsigned char SME_BYTE;
 #define SMESTR_ERR_FAIL_TO_SET_TIMER		"Error. Failed to set a timer. "
 #define SMESTR_ERR_FAIL_TO_EVAL_COND		"Error. Failed to evalate a destination state in the conditional pseudo state. "
 #define SMESTR_ERR_DEACTIVATE_NON_LEAF_APP  "Error. Try to de-acitvate an application exisiting one of its child application is still active."
+#define SMESTR_ERR_FAIL_TO_CREATE_REGION_PROCESS	"Error. Failed to create a region process. A region of SME_RUN_MODE_SEPARATE_PROCESS needs the plugins of SmeSetRegionProcessProc() and SmeSetExtMsgPoolProc()."
+#define SMESTR_ERR_APP_IN_PARALLEL_REGION	"Error. A region of SME_RUN_MODE_PARALLEL can not activate or de-activate an application, nor enter an orthogonal state."
 #define SMESTR_ERR							"Error!"
 
 #define SMESTR_FIELD_APP			"APPLICATION"
@@ -119,7 +139,7 @@ typedef unsigned char SME_BYTE;
 #define SMESTR_FIELD_EVENT_DATA		"EVENT DATA"
 #define SMESTR_FIELD_EVENT_DATA_PTR_FMT		"P(%-8p,%-4u)    "
 #define SMESTR_FIELD_EVENT_DATA_INT_FMT		"I(%-4u,%-4u)        "
-#define SMESTR_FIELD_TIME			"TIME(ms)"
+#define SMESTR_FIELD_TIME			"TIME(us)"
 #define SMESTR_FIELD_REASON		"REASON"
 
 #define SMESTR_EVENT_TIMEOUT        "Timeout"
@@ -54,6 +54,7 @@
 	#include <unistd.h>
 	#include <pthread.h>
 	#include <signal.h>
+	#include <sched.h>
 	#include <sys/time.h>
 	#include <stdio.h>
 	#include <stdlib.h>
@@ -105,6 +106,11 @@ XTHREADID XGetCurrentThreadId(void);
 BOOL  XIsThreadRunning(XTHREADHANDLE thread_handle);
 int XWaitForThread(XTHREADHANDLE thread_handle);
 int XSetThreadPriority(XTHREADHANDLE thread_handle, int nPriority);
+// Bind the calling thread to the processors in nCpuMask, bit n for processor n.
+int XSetThreadAffinity(unsigned long nCpuMask);
+// Bind the calling thread to the processors of a NUMA node, and prefer the memory of the node for its new pages.
+int XSetThreadNumaNode(int nNumaNode);
+// Both do nothing and return 0 under NO_THREAD_SUPPORT, where the embedder creates the threads and places them itself.
 
 BOOL XCreateProcess(const char* pProgramPath,int* ppid);
 void XKillProcess(int pid);
@@ -113,6 +119,9 @@ BOOL XIsProcessRunning(int pid);
 
 void XSleep(unsigned int milliseconds);
 int XGetTick(void);
+// A monotonic clock in nano-seconds, which is not affected by changes of the system time.
+// With SME_CLOCK_TSC, it is read by the calibrated time stamp counter on x86. XGetTick() is the same clock in milli-seconds.
+SME_UINT64 XGetTickNs(void);
 
 /* #define STR_TIME_FMT		"%m/%d/%y %H:%M:%S" 
 Note: You may change order of the %m/%d/%y for the month/day/year. Do not change the flags m d y H M S.*/
@@ -147,7 +156,54 @@ int XWaitForEvent(XEVENT *pEvent, XMUTEX *pMutex, XIS_CODITION_OK_T pIsCondition
 int XSignalEvent(XEVENT *pEvent, XMUTEX *pMutex, XTHREAD_SAFE_ACTION_T pAction, void *pActionParam);
 int XDestroyEvent(XEVENT *pEvent);
 
+// The wait strategy of XWaitForEventEx: busy-poll pIsPending for nSpinNs nano-seconds, yield the processor nYieldNum times, 
+// and then block on the event. pIsPending is called with pCondParam without the mutex, so it reads the shared state lock-free. 
+// Once it returns TRUE, the mutex is taken to check pIsConditionOK and take the actions as XWaitForEvent does. 
+// A NULL pIsPending blocks at once. Between two polls, the processor is relaxed by 1, 2, 4 ... up to nMaxPause pause instructions.
+// All zero stands for blocking at once, the same as XWaitForEvent. Spinning is supported on Linux only.
+// The whole wait lasts no longer than nTimeOut milli-seconds, and XWAIT_TIMEOUT is returned on time-out. XINFINITE waits forever.
+// It is built under NO_THREAD_SUPPORT as well, on the mutex and the event from the embedder's XCreateMutex() and XCreateEvent().
+typedef struct XWAIT_STRATEGY_T_TAG
+{
+	unsigned int nSpinNs;
+	unsigned int nYieldNum;
+	unsigned int nMaxPause;
+} XWAIT_STRATEGY_T;
+
+int XWaitForEventEx(XEVENT *pEvent, XMUTEX *pMutex, XIS_CODITION_OK_T pIsConditionOK, void *pCondParam,
+				  XTHREAD_SAFE_ACTION_T pAction, void *pActionParam, const XWAIT_STRATEGY_T *pStrategy, 
+				  XIS_CODITION_OK_T pIsPending, unsigned int nTimeOut);
+
+// Relax the processor in a busy-wait loop.
+#if defined(SME_WIN32)
+	#define XCpuRelax() YieldProcessor()
+#elif defined(__i386__) || defined(__x86_64__)
+	#define XCpuRelax() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+	#define XCpuRelax() __asm__ __volatile__("yield")
+#else
+	#define XCpuRelax() 
+#endif
+
+// Memory ordering for int-sized data shared between threads without a mutex.
+#if defined SME_LINUX
+	#define XAtomicLoadAcquire(_p)		__atomic_load_n((_p), __ATOMIC_ACQUIRE)
+	#define XAtomicStoreRelease(_p,_v)	__atomic_store_n((_p), (_v), __ATOMIC_RELEASE)
+	#define XMemoryBarrier()			__atomic_thread_fence(__ATOMIC_SEQ_CST)
+	#define XAtomicFetchAdd(_p,_v)		__atomic_fetch_add((_p), (_v), __ATOMIC_RELAXED)
+#elif defined SME_WIN32
+	#define XAtomicLoadAcquire(_p)		(*(volatile unsigned int*)(_p))
+	#define XAtomicStoreRelease(_p,_v)	(*(volatile unsigned int*)(_p) = (_v))
+	#define XMemoryBarrier()			MemoryBarrier()
+	#define XAtomicFetchAdd(_p,_v)		InterlockedExchangeAdd((volatile LONG*)(_p), (_v))
+#endif
+
 // Thread Local Storage
+#if defined(__GNUC__)
+	#define XTHREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+	#define XTHREAD_LOCAL __declspec(thread)
+#endif
 int XTlsAlloc();
 BOOL XSetThreadContext(SME_THREAD_CONTEXT_PT p);
 SME_THREAD_CONTEXT_PT XGetThreadContext();
@@ -176,9 +232,18 @@ The return value of the function is an ID to the new timer. An application can p
 
 SmeSetTimer or SmeSetEventTimer function returns 0 if the function fails.
 
-NOTE: The nTimeOut parameter for regular timers should be less than 0x80000000. Other values are reserved for the state built-in timers.
+A timer is periodic by default. A one-shot timer, whose nTimeOut is SME_ONE_SHOT_TIMEOUT_VAL(nElapse), expires once and is freed, 
+so that killing it afterwards fails harmlessly. The timers here, the high resolution timers and the per-thread timers support it, 
+and take the elapse by SME_GET_TIMEOUT_VAL(). The state built-in timers are one-shot only after SmeSetOneShotStateTimers(TRUE).
+
+NOTE: The nTimeOut parameter for regular timers should be less than 0x40000000, or SME_ONE_SHOT_TIMEOUT_VAL() of such a value. 
+Other values are reserved for the state built-in timers.
 */
 
+#define SME_ONE_SHOT_TIMEOUT_VAL(_Elapse)  (0x40000000  | _Elapse)
+#define SME_IS_ONE_SHOT_TIMEOUT_VAL(_Data)  (_Data & 0x40000000)
+#define SME_GET_TIMEOUT_VAL(_Data) (_Data & 0x3FFFFFFF)
+
 #define SME_STATE_BUILT_IN_TIMEOUT_VAL(_Elapse)  (0x80000000  | _Elapse)
 #define SME_GET_STATE_BUILT_IN_TIMEOUT_VAL(_Data) (_Data & 0x7FFFFFFF)
 #define SME_IS_STATE_BUILT_IN_TIMEOUT_VAL(_Data)  (_Data & 0x80000000)
@@ -193,6 +258,10 @@ BOOL XKillTimer(unsigned int nSequenceNum);
 ******************************************************************************************/
 void* XEmptyMemAlloc(int nSize);
 void XMemFree(void* p);
+// Allocate zeroed memory on a NUMA node, or by XEmptyMemAlloc() if nNumaNode is SME_NUMA_NODE_ANY. 
+// Free it by XNumaMemFree() with the same size and node.
+void* XNumaMemAlloc(int nSize, int nNumaNode);
+void XNumaMemFree(void* p, int nSize, int nNumaNode);
 
 
 #ifdef __cplusplus
@@ -124,7 +124,7 @@ void SmeTurnOffLogField(int nField);
 void SmeTurnOnAllLogFields();
 void SmeTurnOffAllLogFields();
 void SmeEnableStateTracking(BOOL bStateTree, BOOL bOutputWin);
-BOOL SmeStateTrack(SME_EVENT_T *pEvent, SME_APP_T *pDestApp, SME_STATE_T* pOldState, SME_REASON_FOR_HANDLE_T nReason, int nTime);
+BOOL SmeStateTrack(SME_EVENT_T *pEvent, SME_APP_T *pDestApp, SME_STATE_T* pOldState, SME_REASON_FOR_HANDLE_T nReason, SME_UINT64 nTimeNs);
 BOOL SmeCatchCurrentStates(BOOL bWithStatePath);
 BOOL SmeMakeTempRoot(SME_APP_T *pApp, SME_STATE_T *pTempRoot);
 
@@ -0,0 +1,73 @@
+/* ==============================================================================================================================
+ * This notice must be untouched at all times.
+ *
+ * Copyright  IntelliWizard Inc. 
+ * All rights reserved.
+ * LICENSE: LGPL. 
+ * Redistributions of source code modifications must send back to the Intelliwizard Project and republish them. 
+ * Web: http://www.intelliwizard.com
+ * eMail: info@intelliwizard.com
+ * We provide technical supports for UML StateWizard users. The StateWizard users do NOT have to pay for technical supports 
+ * from the Intelliwizard team. We accept donation, but it is not mandatory.
+ * ==============================================================================================================================*/
+// Executor.h
+#ifndef _SME_EXECUTOR_H_
+#define _SME_EXECUTOR_H_
+
+#include "sme.h"
+#include "sme_cross_platform.h"
+
+#ifdef __cplusplus   
+extern "C" {
+#endif
+
+/* The executor runs many applications on a pool of worker threads, instead of binding each application to the 
+thread context which activates it. Each application added to an executor gets a mailbox. Posting an external event to 
+the application, by SmePostThreadExtIntEvent()/SmePostThreadExtPtrEvent() from any thread or by a built-in timer, 
+appends it to the mailbox, and an application with mail is put on the run queue of a worker. A worker takes one 
+application at a time from its own run queue, or steals one from a busy worker when its own run queue is empty. It handles 
+the events of the application to completion, up to SME_EXECUTOR_BATCH_SIZE events at a turn, so that the events of 
+an application are handled one after another in posting order, and never by two workers at once.
+
+The internal events posted by an application go to the application itself. The per-thread timers are not available 
+to the applications of an executor, since the workers do not run SmeRun(); use XSetTimer() or the high resolution timer.
+
+The executor runs on the mutexes and the events of the cross-platform layer, on Win32 and Linux alike. On Linux the 
+workers are pthreads, so the executor runs even if the layer is built with NO_THREAD_SUPPORT, where the embedder 
+provides the mutex and event functions to link it. On Win32 the workers are started by XCreateThread(), which starts 
+no thread with NO_THREAD_SUPPORT, so XCreateExecutor() returns NULL. 
+	pExecutor = XCreateExecutor(0);
+	XExecutorAddApp(pExecutor, &SME_GET_APP_VAR(Session1));
+	...
+	XExecutorRemoveApp(&SME_GET_APP_VAR(Session1));
+	XDestroyExecutor(pExecutor);
+*/
+typedef struct tagXEXECUTOR_T XEXECUTOR_T;
+
+// Create an executor with nWorkerNum worker threads, or a worker for each online processor if nWorkerNum is 0.
+XEXECUTOR_T* XCreateExecutor(int nWorkerNum);
+// Stop the workers, free the mailboxes and restore the plugin of SmeSetAppExtEventProc(). The applications should be removed before.
+int XDestroyExecutor(XEXECUTOR_T *pExecutor);
+
+// Activate an application at the executor. It returns FALSE if the application runs at an executor already.
+BOOL XExecutorAddApp(XEXECUTOR_T *pExecutor, SME_APP_T *pApp);
+// Deactivate an application after its pending events. The events posted afterwards are dropped.
+BOOL XExecutorRemoveApp(SME_APP_T *pApp);
+
+// The plugin for SmeSetAppExtEventProc(), which XCreateExecutor() installs and XDestroyExecutor() uninstalls.
+int XPostAppExtEvent(SME_APP_T *pDestApp, const SME_EXT_EVENT_DESC *pEvent);
+
+/* Fork the events to the regions of SME_RUN_MODE_PARALLEL on the workers of an executor, by installing XExecutorForkJoin() 
+for SmeSetForkJoinProc(), or NULL to uninstall it. The workers take the tasks along with the ready applications, and the 
+forking thread runs the tasks which no worker has taken yet, so it may fork from a worker as well.
+	pExecutor = XCreateExecutor(0);
+	XSetForkJoinExecutor(pExecutor);
+*/
+void XSetForkJoinExecutor(XEXECUTOR_T *pExecutor);
+void XExecutorForkJoin(SME_FORK_TASK_PROC_T pfnTask, void *pParam, int nTaskNum);
+
+#ifdef __cplusplus
+}
+#endif 
+
+#endif
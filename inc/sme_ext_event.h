@@ -24,13 +24,17 @@ enum {SME_TIMER_TYPE_CALLBACK, SME_TIMER_TYPE_EVENT};
 
 BOOL XInitMsgBuf();
 BOOL XFreeMsgBuf();
+BOOL XSetExtEventWaitStrategy(SME_THREAD_CONTEXT_T* pThreadContext, unsigned int nSpinNs, unsigned int nYieldNum, unsigned int nMaxPause);
+BOOL XSetExtEventPriorityQuota(SME_THREAD_CONTEXT_T* pThreadContext, SME_EVENT_PRIORITY_T nPriority, unsigned int nQuota);
 
 int XPostThreadExtIntEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, int Param1, int Param2, 
 						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory);
 int XPostThreadExtPtrEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, void *pData, int nDataSize, 
 						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory);
+int XPostThreadExtEventBatch(SME_THREAD_CONTEXT_T* pDestThreadContext, const SME_EXT_EVENT_DESC *pEvents, int nNum);
 
 BOOL XGetExtEvent(SME_EVENT_T *pEvent);
+int XGetExtEventTimeout(SME_EVENT_T *pEvent, unsigned int nTimeOut);
 BOOL XDelExtEvent(SME_EVENT_T *pEvent);
 
 #ifdef __cplusplus
@@ -0,0 +1,49 @@
+/* ==============================================================================================================================
+ * This notice must be untouched at all times.
+ *
+ * Copyright  IntelliWizard Inc. 
+ * All rights reserved.
+ * LICENSE: LGPL. 
+ * Redistributions of source code modifications must send back to the Intelliwizard Project and republish them. 
+ * Web: http://www.intelliwizard.com
+ * eMail: info@intelliwizard.com
+ * We provide technical supports for UML StateWizard users. The StateWizard users do NOT have to pay for technical supports 
+ * from the Intelliwizard team. We accept donation, but it is not mandatory.
+ * ==============================================================================================================================*/
+// HrTimer.h
+#ifndef _HR_TIMER_H_
+#define _HR_TIMER_H_
+
+#include "sme.h"
+#include "sme_cross_platform.h"
+
+#ifdef __cplusplus   
+extern "C" {
+#endif
+
+/* The high-resolution built-in timer on Linux. Timers expire at absolute CLOCK_MONOTONIC deadlines. The timers due 
+within a quarter of a second are kept in a min-heap, and the others in a hierarchical timing wheel, where setting and 
+killing a timer is O(1). A timer thread sleeps on a timerfd armed to the earliest deadline. Time-out events are posted 
+the same way as the XSetTimer() timers. Install it for the state built-in timers by:
+	XInitHrTimer();
+	SmeSetTimerProc(XSetHrEventTimer, XKillHrTimer);
+	SmeSetTimerRearmProc(XRearmHrTimer);
+	SmeSetKillTimersProc(XKillHrTimers);
+While the virtual clock is on, the functions set and kill the per-thread timers of the calling thread instead, 
+at a milli-second resolution. */
+int XInitHrTimer();
+int XDestroyHrTimer();
+
+unsigned int XSetHrTimer(SME_APP_T *pDestApp, unsigned int nTimeOut, SME_TIMER_PROC_T pfnTimerFunc);
+unsigned int XSetHrTimerUs(SME_APP_T *pDestApp, unsigned int nTimeOutUs, SME_TIMER_PROC_T pfnTimerFunc);
+unsigned int XSetHrEventTimer(SME_APP_T *pDestApp, unsigned int nTimeOut);
+unsigned int XGetHrTimerRemain(unsigned int nSequenceNum);
+unsigned int XRearmHrTimer(unsigned int nSequenceNum, unsigned int nTimeOut);
+BOOL XKillHrTimer(unsigned int nSequenceNum);
+int XKillHrTimers(const unsigned int *pSequenceNums, int nNum);
+
+#ifdef __cplusplus
+}
+#endif 
+
+#endif
@@ -0,0 +1,88 @@
+/* ==============================================================================================================================
+ * This notice must be untouched at all times.
+ *
+ * Copyright  IntelliWizard Inc. 
+ * All rights reserved.
+ * LICENSE: LGPL. 
+ * Redistributions of source code modifications must send back to the Intelliwizard Project and republish them. 
+ * Web: http://www.intelliwizard.com
+ * eMail: info@intelliwizard.com
+ * We provide technical supports for UML StateWizard users. The StateWizard users do NOT have to pay for technical supports 
+ * from the Intelliwizard team. We accept donation, but it is not mandatory.
+ * ==============================================================================================================================*/
+// Shard.h
+#ifndef _SME_SHARD_H_
+#define _SME_SHARD_H_
+
+#include "sme.h"
+#include "sme_cross_platform.h"
+
+#ifdef __cplusplus   
+extern "C" {
+#endif
+
+/* The shards on Linux spread many applications, such as sessions, over N threads. Each shard is a thread running 
+SmeThreadLoop() with its own thread context. An application is added with a key, such as a session ID, which the route 
+function maps to a shard, and it is activated at that shard. The events posted to a key go through the external event 
+path of the shard thread, so the events of a key are handled one after another in posting order. The external event 
+operations should be installed by SmeSetExtEventOprProc() before the shards are created.
+
+The route function hashes the key by default. It is called once per key when the application is added, so a route 
+function which picks the shard by the statistics of XGetShardStat(), e.g. the one with the least applications, 
+rebalances the new keys, while the added keys stay where they are.
+
+A shard thread adds and removes the applications in its event come hook. A hook which an application installs at a 
+shard thread should call the one which SmeSetOnEventComeHook() returns.
+	pShards = XCreateShards(0);
+	XShardAddApp(pShards, nSessionId, pSessionApp);
+	XPostToKey(pShards, nSessionId, EVT_DATA, 0, 0, SME_EVENT_CAT_OTHER);
+	...
+	XShardRemoveApp(pShards, nSessionId);
+	XDestroyShards(pShards);
+*/
+typedef struct tagXSHARDS_T XSHARDS_T;
+
+/* Return the shard of a new key, from 0 to nShardNum-1. */
+typedef int (*XSHARD_ROUTE_PROC_T)(XSHARDS_T *pShards, unsigned long nKey, int nShardNum, void *pParam);
+
+typedef struct tagXSHARD_STAT_T
+{
+	int nAppNum; /* The applications at the shard. */
+	unsigned long nPostedNum; /* The events posted to the keys of the shard. */
+	unsigned long nPostFailedNum; /* The events to the keys of the shard which the posting plugin failed to post. */
+	unsigned long nHandledNum; /* The external events taken by the shard thread. nPostedNum-nHandledNum is about its backlog. */
+} XSHARD_STAT_T;
+
+// Start nShardNum shard threads, or a shard for each online processor if nShardNum is 0. It returns NULL if a shard 
+// thread can not be started, or can not set up its external event buffer.
+XSHARDS_T* XCreateShards(int nShardNum);
+// Stop the shard threads after their pending events. The applications should be removed before.
+int XDestroyShards(XSHARDS_T *pShards);
+
+// Set the route function of the new keys, or NULL for the default hash. It may be set any time.
+void XSetShardRouteProc(XSHARDS_T *pShards, XSHARD_ROUTE_PROC_T pfnRoute, void *pParam);
+// The default route function.
+int XHashShardKey(XSHARDS_T *pShards, unsigned long nKey, int nShardNum, void *pParam);
+
+// Place an application on a shard by its key, and activate it there. It returns FALSE if the key is added already, 
+// or the external event pool of the shard is full.
+BOOL XShardAddApp(XSHARDS_T *pShards, unsigned long nKey, SME_APP_T *pApp);
+// Deactivate the application of a key after its pending events. The events posted to the key afterwards fail. 
+// It returns FALSE if the key is not added, or the external event pool of the shard is full, and the key stays.
+BOOL XShardRemoveApp(XSHARDS_T *pShards, unsigned long nKey);
+// Return the shard of a key, or -1 if the key is not added.
+int XGetKeyShard(XSHARDS_T *pShards, unsigned long nKey);
+
+// Post an external event to the application of a key. It returns 0 on success.
+int XPostToKey(XSHARDS_T *pShards, unsigned long nKey, int nMsgID, int nParam1, int nParam2, unsigned char nCategory);
+int XPostPtrToKey(XSHARDS_T *pShards, unsigned long nKey, int nMsgID, void *pData, int nDataSize, unsigned char nCategory);
+
+int XGetShardNum(XSHARDS_T *pShards);
+BOOL XGetShardStat(XSHARDS_T *pShards, int nShard, XSHARD_STAT_T *pStat);
+SME_THREAD_CONTEXT_T* XGetShardThreadContext(XSHARDS_T *pShards, int nShard);
+
+#ifdef __cplusplus
+}
+#endif 
+
+#endif
@@ -0,0 +1,51 @@
+/* ==============================================================================================================================
+ * This notice must be untouched at all times.
+ *
+ * Copyright  IntelliWizard Inc. 
+ * All rights reserved.
+ * LICENSE: LGPL. 
+ * Redistributions of source code modifications must send back to the Intelliwizard Project and republish them. 
+ * Web: http://www.intelliwizard.com
+ * eMail: info@intelliwizard.com
+ * We provide technical supports for UML StateWizard users. The StateWizard users do NOT have to pay for technical supports 
+ * from the Intelliwizard team. We accept donation, but it is not mandatory.
+ * ==============================================================================================================================*/
+// ShmEvent.h
+#ifndef _SHM_EVENT_H_
+#define _SHM_EVENT_H_
+
+#include "sme.h"
+
+#ifdef __cplusplus   
+extern "C" {
+#endif
+
+/* The external event transport in shared memory for the regions running at SME_RUN_MODE_SEPARATE_PROCESS mode.
+Install it by:
+	SmeSetExtEventOprProc(XShmGetExtEvent, XShmDelExtEvent, XShmPostThreadExtIntEvent, XShmPostThreadExtPtrEvent, 
+		XShmInitMsgBuf, XShmFreeMsgBuf);
+	SmeSetExtEventBatchProc(XShmPostThreadExtEventBatch);
+	SmeSetExtMsgPoolProc(XShmCreateMsgPool, XShmDestroyMsgPool);
+	SmeSetRegionProcessProc(XShmForkRegionProcess, XShmWaitForRegionProcess);
+*/
+BOOL XShmInitMsgBuf();
+BOOL XShmFreeMsgBuf();
+BOOL XShmCreateMsgPool(SME_THREAD_CONTEXT_T* pThreadContext);
+BOOL XShmDestroyMsgPool(SME_THREAD_CONTEXT_T* pThreadContext);
+int XShmForkRegionProcess(void);
+int XShmWaitForRegionProcess(int nPid);
+
+int XShmPostThreadExtIntEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, int Param1, int Param2, 
+						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory);
+int XShmPostThreadExtPtrEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, void *pData, int nDataSize, 
+						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory);
+int XShmPostThreadExtEventBatch(SME_THREAD_CONTEXT_T* pDestThreadContext, const SME_EXT_EVENT_DESC *pEvents, int nNum);
+
+BOOL XShmGetExtEvent(SME_EVENT_T *pEvent);
+BOOL XShmDelExtEvent(SME_EVENT_T *pEvent);
+
+#ifdef __cplusplus
+}
+#endif 
+
+#endif
@@ -0,0 +1,57 @@
+/* ==============================================================================================================================
+ * This notice must be untouched at all times.
+ *
+ * Copyright  IntelliWizard Inc. 
+ * All rights reserved.
+ * LICENSE: LGPL. 
+ * Redistributions of source code modifications must send back to the Intelliwizard Project and republish them. 
+ * Web: http://www.intelliwizard.com
+ * eMail: info@intelliwizard.com
+ * We provide technical supports for UML StateWizard users. The StateWizard users do NOT have to pay for technical supports 
+ * from the Intelliwizard team. We accept donation, but it is not mandatory.
+ * ==============================================================================================================================*/
+// UdsEvent.h
+#ifndef _UDS_EVENT_H_
+#define _UDS_EVENT_H_
+
+#include "sme.h"
+
+#ifdef __cplusplus   
+extern "C" {
+#endif
+
+/* The external event transport over AF_UNIX SOCK_SEQPACKET sockets between processes on one host.
+Install it by:
+	SmeSetExtEventOprProc(XUdsGetExtEvent, XUdsDelExtEvent, XUdsPostThreadExtIntEvent, XUdsPostThreadExtPtrEvent, 
+		XUdsInitMsgBuf, XUdsFreeMsgBuf);
+	SmeSetExtEventBatchProc(XUdsPostThreadExtEventBatch);
+
+A thread receives events from other processes after XUdsListen() at its thread. Another process posts events to it 
+through a proxy thread context connected by XUdsConnect(). The pDestApp of an event to another process is passed as 
+an opaque token, which is meaningful to the receiving process only. Use NULL to dispatch the event to all applications.
+An event whose token is not an active application of the receiving thread is dropped, and so are call back timer events.
+*/
+BOOL XUdsInitMsgBuf();
+BOOL XUdsFreeMsgBuf();
+BOOL XUdsListen(const char *sPath);
+BOOL XUdsConnect(SME_THREAD_CONTEXT_T* pProxyThreadContext, const char *sPath);
+BOOL XUdsDisconnect(SME_THREAD_CONTEXT_T* pProxyThreadContext);
+
+/* While a thread context is corked, the events posted to it are coalesced and sent by one system call 
+when SME_UDS_BATCH_SIZE events are pending or it is uncorked. */
+BOOL XUdsCork(SME_THREAD_CONTEXT_T* pDestThreadContext, BOOL bCork);
+
+int XUdsPostThreadExtIntEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, int Param1, int Param2, 
+						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory);
+int XUdsPostThreadExtPtrEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, void *pData, int nDataSize, 
+						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory);
+int XUdsPostThreadExtEventBatch(SME_THREAD_CONTEXT_T* pDestThreadContext, const SME_EXT_EVENT_DESC *pEvents, int nNum);
+
+BOOL XUdsGetExtEvent(SME_EVENT_T *pEvent);
+BOOL XUdsDelExtEvent(SME_EVENT_T *pEvent);
+
+#ifdef __cplusplus
+}
+#endif 
+
+#endif
@@ -51,20 +51,38 @@
 static SME_MEM_ALLOC_PROC_T g_fnMAllocProc = NULL;
 static SME_MEM_FREE_PROC_T g_fnMFreeProc = NULL;
 
-static SME_SET_THREAD_CONTEXT_PROC g_pfnSetThreadContext=NULL;
-SME_GET_THREAD_CONTEXT_PROC g_pfnGetThreadContext=NULL;
+static SME_SET_THREAD_CONTEXT_PROC g_pfnSetThreadContext=XSetThreadContext;
+SME_GET_THREAD_CONTEXT_PROC g_pfnGetThreadContext=XGetThreadContext;
 
 static SME_GET_EXT_EVENT_PROC_T  g_pfnGetExtEvent=NULL;
 static SME_DEL_EXT_EVENT_PROC_T  g_pfnDelExtEvent=NULL;
 static SME_POST_THREAD_EXT_INT_EVENT_PROC_T g_pfnPostThreadExtIntEvent=NULL;
 static SME_POST_THREAD_EXT_PTR_EVENT_PROC_T g_pfnPostThreadExtPtrEvent=NULL;
+static SME_POST_APP_EXT_EVENT_PROC_T g_pfnPostAppExtEvent=NULL;
+static SME_FORK_JOIN_PROC_T g_pfnForkJoin=NULL;
 static SME_INIT_THREAD_EXT_MSG_BUF_PROC_T g_pfnInitThreadExtMsgBuf=NULL;
 static SME_FREE_THREAD_EXT_MSG_BUF_PROC_T g_pfnFreeThreadExtMsgBuf=NULL;
+static SME_POST_THREAD_EXT_EVENT_BATCH_PROC_T g_pfnPostThreadExtEventBatch=NULL;
+static SME_CREATE_EXT_MSG_POOL_PROC_T g_pfnCreateExtMsgPool=NULL;
+static SME_DESTROY_EXT_MSG_POOL_PROC_T g_pfnDestroyExtMsgPool=NULL;
+static SME_FORK_REGION_PROCESS_PROC_T g_pfnForkRegionProcess=NULL;
+static SME_WAIT_REGION_PROCESS_PROC_T g_pfnWaitRegionProcess=NULL;
 
 static SME_EVENT_HANDLER_T g_pfnEventFilter = NULL;
 
 static SME_STATE_TIMER_PROC_T g_pfnStateTimer = NULL;
 static SME_KILL_TIMER_PROC_T g_pfnKillTimerProc = NULL;
+static SME_REARM_TIMER_PROC_T g_pfnRearmTimerProc = NULL;
+static SME_KILL_TIMERS_PROC_T g_pfnKillTimersProc = NULL;
+static SME_GET_EXT_EVENT_TIMEOUT_PROC_T g_pfnGetExtEventTimeout = NULL;
+
+static int g_nRegionPoolSize = 0;
+static unsigned int g_nRegionExitTimeOut = XINFINITE;
+
+static BOOL g_bOneShotStateTimers = FALSE;
+
+static BOOL g_bVirtualClock = FALSE;
+static SME_UINT64 g_nVirtualClockStartNs = 0;
 
 BOOL DispatchInternalEvents(SME_THREAD_CONTEXT_PT pThreadContext);
 BOOL DispatchEventToApps(SME_THREAD_CONTEXT_PT pThreadContext,SME_EVENT_T *pEvent);
@@ -417,17 +435,381 @@ BOOL SmeDestroyApp(SME_APP_T *pApp)
 		return FALSE;
 }
 
+/* An orthogonal state exit. The region threads signal the exit event as they stop. If the parent thread does not wait 
+for them to complete, the exit is freed after the last of them is reaped. */
+typedef struct SME_REGIONS_EXIT_T_TAG
+{
+	SME_APP_T *pApp; /* The application to get SME_EVENT_REGIONS_EXITED. */
+	int nPendingNum; /* The number of the region threads which have not been reaped. */
+	XMUTEX Mutex; /* Guards nStoppedNum. */
+	XEVENT StoppedEvent; /* Created by the parent thread, which waits on it for the region threads to stop. */
+	int nWaitNum; /* The number of the region threads to wait for. */
+	int nStoppedNum; /* The number of them which have stopped. */
+	BOOL bStopped; /* The parent thread has seen all of them stopped. */
+} SME_REGIONS_EXIT_T;
+
 typedef struct SME_REGION_THREAD_CONTEXT_T_TAG
 {
 	SME_THREAD_CONTEXT_T ThreadContext;
 	XTHREADHANDLE ThreadHandle;
+	int nProcessID; /* The region process, or 0 if the region runs at a thread. */
 	const char* sRegionName;
 	int nNum;
 	SME_STATE_T *pRegionRoot;
 	SME_APP_T *pOrthoApp; /* The common dummy application for all regions. */
+	unsigned long nCpuMask;
+	int nNumaNode; /* The node this context is allocated on. */
+	BOOL bPooled; /* The region thread parks on exit instead of ending. */
+	int nThreadState; /* Written by the region thread and read by the parent thread. */
+	XMUTEX StateMutex; /* Guards the state changes of the region thread. */
+	XEVENT StateEvent; /* Created by the parent thread, which waits on it for the region thread to change its state. */
+	SME_REGIONS_EXIT_T *pExit; /* Set if the parent thread waits for the region thread to stop at an exit. */
+	SME_THREAD_CONTEXT_T *pParentThreadContext; /* Set if the region thread sends SME_EVENT_REGION_ENDED to it when it stops. */
 	struct SME_REGION_THREAD_CONTEXT_T_TAG *pNext;
 } SME_REGION_THREAD_CONTEXT_T;
 
+enum
+{
+	SME_REGION_STARTING=0, /* The region thread does not have its external event buffer yet. */
+	SME_REGION_RUNNING,
+	SME_REGION_PARKED, /* The region thread waits for SME_EVENT_START_REGION. */
+	SME_REGION_ENDED /* The region thread does not access the context any more. */
+};
+
+static void FreeRegionThreadPool(SME_THREAD_CONTEXT_PT pThreadContext);
+
+/* A state change of a region thread, which is signaled to the parent thread. */
+typedef struct SME_REGION_THREAD_STATE_T_TAG
+{
+	SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext;
+	int nState;
+	BOOL bLeft; /* The parent thread has seen the region thread leave nState. */
+	SME_REGIONS_EXIT_T *pExit; /* The exit which waits for the region thread to stop. */
+	SME_THREAD_CONTEXT_T *pParentThreadContext;
+} SME_REGION_THREAD_STATE_T;
+
+static int OnRegionThreadStateSet(void *pParam)
+{
+	SME_REGION_THREAD_STATE_T *pState = (SME_REGION_THREAD_STATE_T*)pParam;
+	XAtomicStoreRelease(&(pState->pRegionThreadContext->nThreadState), pState->nState);
+	/* The exit is taken along with the state change, so that it is attached either before the region thread stops, 
+	or not at all. */
+	pState->pExit = pState->pRegionThreadContext->pExit;
+	pState->pParentThreadContext = pState->pRegionThreadContext->pParentThreadContext;
+	return 0;
+}
+
+/* Set the state of the calling region thread, and signal it to the parent thread. */
+static void SetRegionThreadState(SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext, int nState, SME_REGION_THREAD_STATE_T *pState)
+{
+	memset(pState, 0, sizeof(SME_REGION_THREAD_STATE_T));
+	pState->pRegionThreadContext = pRegionThreadContext;
+	pState->nState = nState;
+	XSignalEvent(&(pRegionThreadContext->StateEvent), &(pRegionThreadContext->StateMutex), OnRegionThreadStateSet, pState);
+}
+
+static BOOL IsRegionThreadStateLeft(void *pParam)
+{
+	SME_REGION_THREAD_STATE_T *pState = (SME_REGION_THREAD_STATE_T*)pParam;
+	return pState->nState != pState->pRegionThreadContext->nThreadState;
+}
+
+static int OnRegionThreadStateLeft(void *pParam)
+{
+	((SME_REGION_THREAD_STATE_T*)pParam)->bLeft = IsRegionThreadStateLeft(pParam);
+	return 0;
+}
+
+static int OnRegionExitThreadStopped(void *pParam)
+{
+	((SME_REGIONS_EXIT_T*)pParam)->nStoppedNum++;
+	return 0;
+}
+
+/* Set the stopped state of a region thread, signal the exit which waits for it, and notify the parent thread if it does 
+not wait for the region thread. The region thread does not access the context afterwards, unless it is restarted. */
+static void SetRegionThreadStopped(SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext, int nState)
+{
+	SME_REGION_THREAD_STATE_T State;
+
+	SetRegionThreadState(pRegionThreadContext, nState, &State);
+	if (State.pExit)
+		XSignalEvent(&(State.pExit->StoppedEvent), &(State.pExit->Mutex), OnRegionExitThreadStopped, State.pExit);
+	if (State.pParentThreadContext)
+		(*g_pfnPostThreadExtPtrEvent)(State.pParentThreadContext, SME_EVENT_REGION_ENDED, &pRegionThreadContext, 
+			sizeof(pRegionThreadContext), NULL, 0, SME_EVENT_CAT_OTHER);
+}
+
+static int OnRegionExitAttached(void *pParam)
+{
+	SME_REGION_THREAD_STATE_T *pState = (SME_REGION_THREAD_STATE_T*)pParam;
+	SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext = pState->pRegionThreadContext;
+
+	if (pRegionThreadContext->nThreadState >= SME_REGION_PARKED)
+	{
+		pState->pExit = NULL;
+		return 0;
+	}
+	pRegionThreadContext->pExit = pState->pExit;
+	pRegionThreadContext->pParentThreadContext = pState->pParentThreadContext;
+	return 0;
+}
+
+/* Attach an exit to a region thread under the mutex of its context. Return FALSE if the region thread has stopped, 
+so that it does not signal the exit. */
+static BOOL AttachRegionExit(SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext, SME_REGIONS_EXIT_T *pExit, 
+							 SME_THREAD_CONTEXT_T *pParentThreadContext)
+{
+	SME_REGION_THREAD_STATE_T State;
+
+	memset(&State, 0, sizeof(State));
+	State.pRegionThreadContext = pRegionThreadContext;
+	State.pExit = pExit;
+	State.pParentThreadContext = pParentThreadContext;
+	XSignalEvent(&(pRegionThreadContext->StateEvent), &(pRegionThreadContext->StateMutex), OnRegionExitAttached, &State);
+	return NULL!=State.pExit;
+}
+
+static BOOL IsRegionExitStopped(void *pParam)
+{
+	SME_REGIONS_EXIT_T *pExit = (SME_REGIONS_EXIT_T*)pParam;
+	return pExit->nStoppedNum >= pExit->nWaitNum;
+}
+
+static int OnRegionExitChecked(void *pParam)
+{
+	((SME_REGIONS_EXIT_T*)pParam)->bStopped = IsRegionExitStopped(pParam);
+	return 0;
+}
+
+/* Wait on the exit event for the attached region threads to stop, for nTimeOut milliseconds at most. */
+static void WaitRegionExit(SME_REGIONS_EXIT_T *pExit, unsigned int nTimeOut)
+{
+	unsigned int nStartTick = XGetTick();
+	unsigned int nElapsed;
+
+	pExit->bStopped = (0==pExit->nWaitNum);
+	while (!pExit->bStopped)
+	{
+		nElapsed = (unsigned int)(XGetTick()-nStartTick);
+		if (XINFINITE != nTimeOut && nElapsed >= nTimeOut)
+			break;
+		XWaitForEventEx(&(pExit->StoppedEvent), &(pExit->Mutex), IsRegionExitStopped, pExit, OnRegionExitChecked, pExit, 
+			NULL, NULL, (XINFINITE == nTimeOut) ? XINFINITE : nTimeOut-nElapsed);
+	}
+}
+
+/* Wait for a parked region thread to be restarted. Return FALSE if it is requested to end. The events left from the 
+previous run are dropped. */
+static BOOL WaitRegionStart()
+{
+	SME_EVENT_T ExtEvent;
+
+	while ((*g_pfnGetExtEvent)(&ExtEvent))
+	{
+		BOOL bStart = (SME_EVENT_START_REGION == ExtEvent.nEventID);
+		if (g_pfnDelExtEvent)
+		{
+			(*g_pfnDelExtEvent)(&ExtEvent);
+			SmeDeleteEvent(&ExtEvent);
+		}
+		if (bStart)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* Run the regions of a pooled region thread one after another. The thread context and the external event buffer are 
+initialized once, and the thread parks between the runs. */
+static void PooledRegionThreadLoop(SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext)
+{
+	SME_THREAD_CONTEXT_T *pThreadContext = &(pRegionThreadContext->ThreadContext);
+	SME_APP_T* pRegionApp;
+	void *pExtEventPool;
+
+	SME_REGION_THREAD_STATE_T State;
+
+	SmeInitEngine(pThreadContext);
+	(*g_pfnInitThreadExtMsgBuf)();
+	SetRegionThreadState(pRegionThreadContext, SME_REGION_RUNNING, &State);
+	do
+	{
+		pRegionApp = SmeCreateApp(pRegionThreadContext->sRegionName,pRegionThreadContext->nNum,pRegionThreadContext->pRegionRoot); 
+		SmeActivateApp(pRegionApp, NULL);
+		SmeRun();
+		SmeDestroyApp(pRegionApp);
+
+		/* Reset the thread context but keep the external event buffer. */
+		FreeRegionThreadPool(pThreadContext);
+		pExtEventPool = pThreadContext->pExtEventPool;
+		SmeInitEngine(pThreadContext);
+		pThreadContext->pExtEventPool = pExtEventPool;
+		SetRegionThreadStopped(pRegionThreadContext, SME_REGION_PARKED);
+	} while (WaitRegionStart());
+
+	(*g_pfnFreeThreadExtMsgBuf)();
+	XFreeThreadContext(pThreadContext);
+	SetRegionThreadStopped(pRegionThreadContext, SME_REGION_ENDED);
+}
+
+/* Wait for a region thread to leave the given state. The new state is seen under the mutex of the context, so the parent 
+thread may free the context as soon as the region thread has ended. */
+static void WaitRegionThreadState(SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext, int nState)
+{
+	SME_REGION_THREAD_STATE_T State;
+
+	State.pRegionThreadContext = pRegionThreadContext;
+	State.nState = nState;
+	State.bLeft = FALSE;
+	while (!State.bLeft)
+		XWaitForEvent(&(pRegionThreadContext->StateEvent), &(pRegionThreadContext->StateMutex), 
+			IsRegionThreadStateLeft, &State, OnRegionThreadStateLeft, &State);
+}
+
+/* Free the context of an ended region thread. */
+static void FreeRegionThreadContext(SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext)
+{
+	XCLOSE_HANDLE(pRegionThreadContext->ThreadHandle);
+	XDestroyMutex(&(pRegionThreadContext->StateMutex));
+	XDestroyEvent(&(pRegionThreadContext->StateEvent));
+	XNumaMemFree(pRegionThreadContext, sizeof(SME_REGION_THREAD_CONTEXT_T), pRegionThreadContext->nNumaNode);
+}
+
+/* End a parked region thread and free its context. */
+static void EndRegionThread(SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext)
+{
+	XAtomicStoreRelease(&(pRegionThreadContext->nThreadState), SME_REGION_RUNNING);
+	(*g_pfnPostThreadExtIntEvent)(&(pRegionThreadContext->ThreadContext), SME_EVENT_EXIT_LOOP, 0, 0, NULL,0,
+		SME_EVENT_CAT_WITH_PRIORITY(SME_EVENT_CAT_OTHER, SME_EVENT_PRIORITY_URGENT));
+	WaitRegionThreadState(pRegionThreadContext, SME_REGION_RUNNING);
+	FreeRegionThreadContext(pRegionThreadContext);
+}
+
+/* Park a stopped region thread at the pool of the calling thread, or end it if the pool is full. */
+static void ParkRegionThread(SME_THREAD_CONTEXT_PT pThreadContext, SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext)
+{
+	SME_REGION_THREAD_CONTEXT_T *p = (SME_REGION_THREAD_CONTEXT_T *)(pThreadContext->pRegionPool);
+	int nNum=0;
+
+	for (; p; p=p->pNext)
+		nNum++;
+	if (nNum >= g_nRegionPoolSize)
+	{
+		EndRegionThread(pRegionThreadContext);
+		return;
+	}
+	pRegionThreadContext->pOrthoApp = NULL;
+	pRegionThreadContext->pNext = (SME_REGION_THREAD_CONTEXT_T *)(pThreadContext->pRegionPool);
+	pThreadContext->pRegionPool = pRegionThreadContext;
+}
+
+/* Take a parked region thread with the given placement from the pool of the calling thread. */
+static SME_REGION_THREAD_CONTEXT_T* TakeParkedRegionThread(SME_THREAD_CONTEXT_PT pThreadContext, const SME_REGION_CONTEXT_T *pRegion)
+{
+	SME_REGION_THREAD_CONTEXT_T **pp = (SME_REGION_THREAD_CONTEXT_T **)&(pThreadContext->pRegionPool);
+
+	for (; *pp; pp=&((*pp)->pNext))
+	{
+		SME_REGION_THREAD_CONTEXT_T *p = *pp;
+		if (p->nCpuMask==pRegion->nCpuMask && p->nNumaNode==pRegion->nNumaNode)
+		{
+			*pp = p->pNext;
+			p->pNext = NULL;
+			return p;
+		}
+	}
+	return NULL;
+}
+
+static void FreeRegionThreadPool(SME_THREAD_CONTEXT_PT pThreadContext)
+{
+	SME_REGION_THREAD_CONTEXT_T *p;
+
+	while (NULL != (p = (SME_REGION_THREAD_CONTEXT_T *)(pThreadContext->pRegionPool)))
+	{
+		pThreadContext->pRegionPool = p->pNext;
+		EndRegionThread(p);
+	}
+}
+
+/* Free a stopped region thread, or park it at the pool of the calling thread. */
+static void ReapRegionThread(SME_THREAD_CONTEXT_PT pThreadContext, SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext)
+{
+	pRegionThreadContext->pExit = NULL;
+	pRegionThreadContext->pParentThreadContext = NULL;
+	if (pRegionThreadContext->bPooled && SME_REGION_PARKED == XAtomicLoadAcquire(&(pRegionThreadContext->nThreadState)))
+	{
+		ParkRegionThread(pThreadContext, pRegionThreadContext);
+		return;
+	}
+	FreeRegionThreadContext(pRegionThreadContext);
+}
+
+static void DestroyRegionsExit(SME_REGIONS_EXIT_T *pExit)
+{
+	XDestroyMutex(&(pExit->Mutex));
+	XDestroyEvent(&(pExit->StoppedEvent));
+}
+
+static void PostRegionsExited(SME_REGIONS_EXIT_T *pExit)
+{
+	SmePostEvent(SmeCreateIntEvent(SME_EVENT_REGIONS_EXITED, 0, 0, SME_EVENT_CAT_OTHER, pExit->pApp));
+	DestroyRegionsExit(pExit);
+	XMemFree(pExit);
+}
+
+/* Reap the region thread of SME_EVENT_REGION_ENDED. After the last region thread of an orthogonal state exit is reaped, 
+SME_EVENT_REGIONS_EXITED is posted to the application. */
+static void OnRegionEnded(SME_THREAD_CONTEXT_PT pThreadContext, SME_EVENT_T *pEvent)
+{
+	SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext;
+	SME_REGIONS_EXIT_T *pExit;
+
+	if (SME_EVENT_DATA_FORMAT_PTR != pEvent->nDataFormat || sizeof(pRegionThreadContext) != (unsigned int)pEvent->Data.Ptr.nSize)
+		return;
+	memcpy(&pRegionThreadContext, pEvent->Data.Ptr.pData, sizeof(pRegionThreadContext));
+	pExit = pRegionThreadContext->pExit;
+	ReapRegionThread(pThreadContext, pRegionThreadContext);
+	if (pExit && 0 == --pExit->nPendingNum)
+		PostRegionsExited(pExit);
+}
+
+void SmeSetRegionThreadPoolSize(int nMaxIdle)
+{
+	g_nRegionPoolSize = (nMaxIdle>0) ? nMaxIdle : 0;
+}
+
+void SmeSetRegionExitTimeout(unsigned int nTimeOut)
+{
+	g_nRegionExitTimeOut = nTimeOut;
+}
+
+void SmeFreeRegionThreadPool()
+{
+	SME_THREAD_CONTEXT_PT pThreadContext=NULL;
+	if (g_pfnGetThreadContext)
+		pThreadContext = (*g_pfnGetThreadContext)();
+	if (pThreadContext)
+		FreeRegionThreadPool(pThreadContext);
+}
+
+/* Place the calling region thread or process before it allocates anything. */
+static void PlaceRegionThread(SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext)
+{
+	if (SME_NUMA_NODE_ANY != pRegionThreadContext->nNumaNode)
+		XSetThreadNumaNode(pRegionThreadContext->nNumaNode);
+	if (pRegionThreadContext->nCpuMask)
+		XSetThreadAffinity(pRegionThreadContext->nCpuMask);
+}
+
+/* Called once the external event buffer of a region thread is initialized. */
+static int OnRegionThreadStarted(void *pParam)
+{
+	SME_REGION_THREAD_STATE_T State;
+	SetRegionThreadState((SME_REGION_THREAD_CONTEXT_T*)pParam, SME_REGION_RUNNING, &State);
+	return 0;
+}
+
 #ifdef SME_WIN32
 	static unsigned __stdcall RegionThreadProc(void *Param)
 #else
@@ -440,9 +822,16 @@ typedef struct SME_REGION_THREAD_CONTEXT_T_TAG
 	if (NULL==pRegionThreadContext)
 		return 0;
 
+	PlaceRegionThread(pRegionThreadContext);
+	if (pRegionThreadContext->bPooled)
+	{
+		PooledRegionThreadLoop(pRegionThreadContext);
+		return 0;
+	}
 	pRegionApp = SmeCreateApp(pRegionThreadContext->sRegionName,pRegionThreadContext->nNum,pRegionThreadContext->pRegionRoot); 
-	SmeThreadLoop(&(pRegionThreadContext->ThreadContext), pRegionApp, NULL, NULL);
+	SmeThreadLoop(&(pRegionThreadContext->ThreadContext), pRegionApp, OnRegionThreadStarted, pRegionThreadContext);
 	SmeDestroyApp(pRegionApp);
+	SetRegionThreadStopped(pRegionThreadContext, SME_REGION_ENDED);
 	return 0;
 }
 
@@ -468,6 +857,54 @@ void SmeThreadLoop(SME_THREAD_CONTEXT_T* pThreadContext, SME_APP_T *pApp, SME_IN
 }
 
 
+/* Run a region at the forked process. The external event pool is created by the parent before fork. */
+static void RegionProcessProc(SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext)
+{
+	SME_THREAD_CONTEXT_T *pThreadContext = &(pRegionThreadContext->ThreadContext);
+	void *pExtEventPool = pThreadContext->pExtEventPool;
+	SME_APP_T* pRegionApp=NULL;
+
+	/* The forked process is a copy of the parent thread, including its thread local storage. */
+	XFreeThreadContext(XGetThreadContext());
+
+	PlaceRegionThread(pRegionThreadContext);
+	SmeInitEngine(pThreadContext);
+	pThreadContext->pExtEventPool = pExtEventPool;
+
+	pRegionApp = SmeCreateApp(pRegionThreadContext->sRegionName,pRegionThreadContext->nNum,pRegionThreadContext->pRegionRoot); 
+	SmeActivateApp(pRegionApp, NULL);
+	SmeRun();
+
+	/* Do not run the exit handlers of the parent process. */
+	_exit(0);
+}
+
+/* Fork a region process. Return FALSE if no process plugin is installed, or the external event transport 
+can not create an event pool for it. */
+static BOOL CreateRegionProcess(SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext)
+{
+	int nPid=0;
+
+	if (NULL==g_pfnForkRegionProcess || NULL==g_pfnWaitRegionProcess)
+		return FALSE;
+	if (NULL==g_pfnCreateExtMsgPool || !(*g_pfnCreateExtMsgPool)(&(pRegionThreadContext->ThreadContext)))
+		return FALSE;
+
+	nPid = (*g_pfnForkRegionProcess)();
+	if (nPid<0)
+	{
+		if (g_pfnDestroyExtMsgPool)
+			(*g_pfnDestroyExtMsgPool)(&(pRegionThreadContext->ThreadContext));
+		return FALSE;
+	}
+
+	if (0==nPid)
+		RegionProcessProc(pRegionThreadContext); /* Never return. */
+
+	pRegionThreadContext->nProcessID = nPid;
+	return TRUE;
+}
+
 /* Enter the orthogonal state */
 static BOOL EnterOrthoState(SME_STATE_T *pOrthoState, SME_APP_T *pApp)
 {
@@ -483,6 +920,13 @@ static BOOL EnterOrthoState(SME_STATE_T *pOrthoState, SME_APP_T *pApp)
 	if (pCompOrthoState->nStateType != SME_STYPE_ORTHO_COMP)
 		return FALSE;
 
+	/* The regions of a parallel region would be linked to the application list of its task only. */
+	if (pApp->bForkJoin)
+	{
+		SME_ASSERT_MSG(!pApp->bForkJoin, SMESTR_ERR_APP_IN_PARALLEL_REGION);
+		return FALSE;
+	}
+
 	pRegion = (SME_REGION_CONTEXT_T*)(pCompOrthoState->EventTable);
 
 	if (NULL==pRegion)
@@ -506,6 +950,7 @@ static BOOL EnterOrthoState(SME_STATE_T *pOrthoState, SME_APP_T *pApp)
 	pRegionThreadContext1->sRegionName = pOrthoState->sStateName;
 	pRegionThreadContext1->nNum = 1;
 	pRegionThreadContext1->pRegionRoot = NULL;
+	pRegionThreadContext1->nNumaNode = SME_NUMA_NODE_ANY;
 	pRegionThreadContext1->pNext =NULL;
 	pApp->pRegionThreadContextList = pRegionThreadContext1; /* The fist item in the list. */
 
@@ -517,28 +962,73 @@ static BOOL EnterOrthoState(SME_STATE_T *pOrthoState, SME_APP_T *pApp)
 			switch (pRegion->nRunningMode)
 			{
 			case SME_RUN_MODE_PARENT_THREAD:
+			case SME_RUN_MODE_PARALLEL:
 				{
 					SME_APP_T* pRegionApp = SmeCreateApp(pRegion->sRegionName,(pRegion->nInstanceNum>1)?i:SME_REGIONID_DUMMY,pRegion->pRoot); 
+					if (pRegionApp)
+						pRegionApp->bForkJoin = (SME_RUN_MODE_PARALLEL==pRegion->nRunningMode);
 					SmeActivateApp(pRegionApp,pOrthoApp);
 				}
 				break;
 			case SME_RUN_MODE_SEPARATE_THREAD:
+			case SME_RUN_MODE_SEPARATE_PROCESS:
 				{
-					SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext = (SME_REGION_THREAD_CONTEXT_T *)XEmptyMemAlloc(sizeof(SME_REGION_THREAD_CONTEXT_T));
+					SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext = NULL;
+					if (SME_RUN_MODE_SEPARATE_THREAD==pRegion->nRunningMode)
+						pRegionThreadContext = TakeParkedRegionThread(XGetThreadContext(), pRegion);
+					if (pRegionThreadContext)
+					{
+						/* Restart a parked region thread. */
+						pRegionThreadContext->pRegionRoot = pRegion->pRoot;
+						pRegionThreadContext->sRegionName = pRegion->sRegionName;
+						pRegionThreadContext->nNum = (pRegion->nInstanceNum>1)?i:-1;
+						pRegionThreadContext->pOrthoApp = pOrthoApp;
+						pRegionThreadContext->nThreadState = SME_REGION_RUNNING;
+						pRegionThreadContext->pNext = pRegionThreadContext1->pNext;
+						pRegionThreadContext1->pNext = pRegionThreadContext;
+						/* Urgent, so that it is not overtaken by SME_EVENT_EXIT_LOOP of an immediate exit. */
+						(*g_pfnPostThreadExtIntEvent)(&(pRegionThreadContext->ThreadContext), SME_EVENT_START_REGION, 0, 0, NULL,0,
+							SME_EVENT_CAT_WITH_PRIORITY(SME_EVENT_CAT_OTHER, SME_EVENT_PRIORITY_URGENT));
+						XSetThreadPriority(pRegionThreadContext->ThreadHandle,pRegion->nPriority);
+						break;
+					}
+					pRegionThreadContext = (SME_REGION_THREAD_CONTEXT_T *)XNumaMemAlloc(sizeof(SME_REGION_THREAD_CONTEXT_T), pRegion->nNumaNode);
 					if (!pRegionThreadContext)
 						return FALSE;
+					pRegionThreadContext->nCpuMask = pRegion->nCpuMask;
+					pRegionThreadContext->nNumaNode = pRegion->nNumaNode;
 					pRegionThreadContext->pRegionRoot = pRegion->pRoot;
 					pRegionThreadContext->sRegionName = pRegion->sRegionName;
 					pRegionThreadContext->nNum = (pRegion->nInstanceNum>1)?i:-1;
 					pRegionThreadContext->pOrthoApp = pOrthoApp;
 					pRegionThreadContext->pNext = pRegionThreadContext1->pNext;
 					pRegionThreadContext1->pNext = pRegionThreadContext; /* Insert to the list after the first item. */
-					XCreateThread(RegionThreadProc, pRegionThreadContext, &(pRegionThreadContext->ThreadHandle));
+					if (SME_RUN_MODE_SEPARATE_PROCESS==pRegion->nRunningMode)
+					{
+						BOOL bCreated = CreateRegionProcess(pRegionThreadContext);
+						SME_ASSERT_MSG(bCreated, SMESTR_ERR_FAIL_TO_CREATE_REGION_PROCESS);
+						if (bCreated)
+							break;
+						pRegionThreadContext1->pNext = pRegionThreadContext->pNext;
+						XNumaMemFree(pRegionThreadContext, sizeof(SME_REGION_THREAD_CONTEXT_T), pRegion->nNumaNode);
+						return FALSE;
+					}
+					pRegionThreadContext->bPooled = (g_nRegionPoolSize>0);
+					XCreateMutex(&(pRegionThreadContext->StateMutex));
+					XCreateEvent(&(pRegionThreadContext->StateEvent));
+					if (0!=XCreateThread(RegionThreadProc, pRegionThreadContext, &(pRegionThreadContext->ThreadHandle))
+						|| 0==pRegionThreadContext->ThreadHandle)
+					{
+						/* No region thread runs, so the exit does not wait for it. */
+						pRegionThreadContext->bPooled = FALSE;
+						pRegionThreadContext->nThreadState = SME_REGION_ENDED;
+						break;
+					}
 					XSetThreadPriority(pRegionThreadContext->ThreadHandle,pRegion->nPriority);
+					/* The events posted to a region thread are not dropped once it is entered. */
+					WaitRegionThreadState(pRegionThreadContext, SME_REGION_STARTING);
 				}
 				break;
-			case SME_RUN_MODE_SEPARATE_PROCESS:
-				break;
 			}
 		} 
 		pRegion++; 
@@ -554,6 +1044,8 @@ static int ExitOrthoState(SME_APP_T *pApp)
 	SME_APP_T *p = pThreadContext->pActAppHdr;
 	SME_REGION_THREAD_CONTEXT_T *pRegionThreadContext1;
 	SME_REGION_THREAD_CONTEXT_T *pChildThreadContext=NULL;
+	SME_REGIONS_EXIT_T *pExit=NULL;
+	SME_REGIONS_EXIT_T LocalExit;
 
 	if (pApp)
 		pRegionThreadContext1 = (SME_REGION_THREAD_CONTEXT_T *)(pApp->pRegionThreadContextList);
@@ -586,28 +1078,73 @@ static int ExitOrthoState(SME_APP_T *pApp)
 	if (pRegionThreadContext1 && pRegionThreadContext1->pNext)
 	{
 		SME_REGION_THREAD_CONTEXT_T *pNextChild=NULL;
+		BOOL bBounded = (XINFINITE != g_nRegionExitTimeOut);
 
-		 /* Post SME_EVENT_EXIT_LOOP event to all region threads.*/
+		/* A bounded exit outlives this call until the last pending region thread is reaped. An unbounded one, or a bounded 
+		one without memory, waits for all region threads to stop, so it lives at the stack. */
+		if (bBounded)
+			pExit = (SME_REGIONS_EXIT_T *)XEmptyMemAlloc(sizeof(SME_REGIONS_EXIT_T));
+		if (NULL==pExit)
+		{
+			bBounded = FALSE;
+			memset(&LocalExit, 0, sizeof(LocalExit));
+			pExit = &LocalExit;
+		}
+		pExit->pApp = pApp;
+		XCreateMutex(&(pExit->Mutex));
+		XCreateEvent(&(pExit->StoppedEvent));
+
+		 /* Post SME_EVENT_EXIT_LOOP event to all region threads and processes.*/
 		 pChildThreadContext = pRegionThreadContext1->pNext;
 		 while (pChildThreadContext)
 		 {
-			(*g_pfnPostThreadExtIntEvent)(&(pChildThreadContext->ThreadContext), SME_EVENT_EXIT_LOOP, 0, 0, NULL,0,SME_EVENT_CAT_OTHER);
+			/* A region thread which has not stopped signals the exit as it stops, and acknowledges a bounded exit 
+			with SME_EVENT_REGION_ENDED. */
+			if (0==pChildThreadContext->nProcessID 
+				&& AttachRegionExit(pChildThreadContext, pExit, bBounded ? SME_OWNER_THREAD_CONTEXT(pThreadContext) : NULL))
+			{
+				pExit->nWaitNum++;
+				if (bBounded)
+					pExit->nPendingNum++;
+			}
+			(*g_pfnPostThreadExtIntEvent)(&(pChildThreadContext->ThreadContext), SME_EVENT_EXIT_LOOP, 0, 0, NULL,0,
+				SME_EVENT_CAT_WITH_PRIORITY(SME_EVENT_CAT_OTHER, SME_EVENT_PRIORITY_URGENT));
 			pChildThreadContext = pChildThreadContext->pNext;
 		 }
 
-		 /* Wait for all region threads to exit.*/
+		 /* Wait for all region threads to stop, for a bounded time only if the exit is bounded. */
+		 WaitRegionExit(pExit, bBounded ? g_nRegionExitTimeOut : XINFINITE);
+
+		 /* Wait for all region processes to exit, and reap the region threads which do not acknowledge the exit. */
 		 pChildThreadContext = pRegionThreadContext1->pNext;
 		 while (pChildThreadContext)
 		 {
-			XWaitForThread(pChildThreadContext->ThreadHandle);
-			XCLOSE_HANDLE(pChildThreadContext->ThreadHandle);
-
 			pNextChild = pChildThreadContext->pNext;
-			XMemFree(pChildThreadContext);
+			if (pChildThreadContext->nProcessID)
+			{
+				(*g_pfnWaitRegionProcess)(pChildThreadContext->nProcessID);
+				if (g_pfnDestroyExtMsgPool)
+					(*g_pfnDestroyExtMsgPool)(&(pChildThreadContext->ThreadContext));
+				XNumaMemFree(pChildThreadContext, sizeof(SME_REGION_THREAD_CONTEXT_T), pChildThreadContext->nNumaNode);
+			} else if (NULL==pChildThreadContext->pParentThreadContext)
+			{
+				/* The region thread has stopped. Otherwise it is reaped on its SME_EVENT_REGION_ENDED. */
+				ReapRegionThread(pThreadContext, pChildThreadContext);
+			}
 			pChildThreadContext = pNextChild;
 		 }
+
+		 if (!bBounded)
+		 {
+			DestroyRegionsExit(pExit);
+			pExit = NULL;
+		 }
 	}
 
+	/* No region thread is pending, so notify the application at once. */
+	if (pExit && 0==pExit->nPendingNum)
+		PostRegionsExited(pExit);
+
 	XMemFree(pRegionThreadContext1);
 	pApp->pRegionThreadContextList = NULL;
 
@@ -707,6 +1244,13 @@ BOOL SmeActivateApp(SME_APP_T *pNewApp, SME_APP_T *pParentApp)
 
 	if(!pNewApp || (SME_IS_ACTIVATED(pNewApp) && pNewApp->pRoot !=NULL)) return FALSE;
 
+	/* A region task of SME_RUN_MODE_PARALLEL runs with its region as the only active application. */
+	if (pThreadContext->pForkParent)
+	{
+		SME_ASSERT_MSG(NULL==pThreadContext->pForkParent, SMESTR_ERR_APP_IN_PARALLEL_REGION);
+		return FALSE;
+	}
+
 	pNewApp->pParent = pParentApp;
     /* Push the new application to active application stack. */
 	pNewApp->pNext=pThreadContext->pActAppHdr;
@@ -757,6 +1301,12 @@ BOOL SmeDeactivateApp(SME_APP_T *pApp)
 
 	if (!pApp || (!SME_IS_ACTIVATED(pApp) && pApp->pRoot !=NULL)) return FALSE;
 
+	if (pThreadContext->pForkParent)
+	{
+		SME_ASSERT_MSG(NULL==pThreadContext->pForkParent, SMESTR_ERR_APP_IN_PARALLEL_REGION);
+		return FALSE;
+	}
+
 	/* Locate the application in the active application stack.*/
 	p=pThreadContext->pActAppHdr;
 	pPre=NULL;
@@ -1115,6 +1665,28 @@ static BOOL IsExplicitEntryAvailable(/* IN */SME_STATE_T *pState, SME_EVENT_T *p
 	return FALSE;
 }
 
+/* Kill the state timers below the current leaf state, which the state exits kept for re-arming or for a batch kill. */
+static void KillIdleStateTimers(SME_APP_T *pApp)
+{
+	unsigned int Timers[SME_MAX_STATE_TREE_DEPTH];
+	int nNum=0;
+	int i;
+
+	for (i=pApp->nStateNum; i<SME_MAX_STATE_TREE_DEPTH; i++)
+	{
+		if (0!=pApp->StateTimers[i])
+		{
+			if (g_pfnKillTimersProc)
+				Timers[nNum++] = pApp->StateTimers[i];
+			else
+				g_pfnKillTimerProc(pApp->StateTimers[i]);
+			pApp->StateTimers[i] = 0;
+		}
+	}
+	if (nNum>0)
+		g_pfnKillTimersProc(Timers, nNum);
+}
+
 /*******************************************************************************************
 * DESCRIPTION: Dispatch the incoming event to an application if it is specified, otherwise
 *  dispatch to all active applications until it is consumed.  
@@ -1149,7 +1721,7 @@ BOOL SmeDispatchEvent(SME_EVENT_T *pEvent, SME_APP_T *pApp)
 	SME_THREAD_CONTEXT_PT pThreadContext=NULL;
 	
 	#if SME_DEBUG
-	int nBeginTick=XGetTick();
+	SME_UINT64 nBeginTime=SmeClockNowNs();
 	#endif
 
 	if (g_pfnGetThreadContext)
@@ -1224,8 +1796,10 @@ BOOL SmeDispatchEvent(SME_EVENT_T *pEvent, SME_APP_T *pApp)
 				SME_EVENT_HANDLER_T pEvtHdl;
 				pState = OldStateStack[i];
 
-				/* Stop state built-in timer. */
-				if (0!=pApp->StateTimers[pApp->nStateNum-1])
+				/* Stop state built-in timer. If timers can be re-armed, keep it for the state entered at the same depth, 
+				and kill it after the transition if no state takes it. If timers can be killed in a batch, kill it 
+				with the other exited state timers after the state exits. */
+				if (0!=pApp->StateTimers[pApp->nStateNum-1] && NULL==g_pfnRearmTimerProc && NULL==g_pfnKillTimersProc)
 				{
 					g_pfnKillTimerProc(pApp->StateTimers[pApp->nStateNum-1]);
 					pApp->StateTimers[pApp->nStateNum-1] =0; /* Clear the state timer. */
@@ -1248,6 +1822,9 @@ BOOL SmeDispatchEvent(SME_EVENT_T *pEvent, SME_APP_T *pApp)
 				CallHandler(pEvtHdl,pApp,pEvent);
 
 			};
+
+			if (NULL==g_pfnRearmTimerProc && NULL!=g_pfnKillTimersProc)
+				KillIdleStateTimers(pApp);
 		}; /* end of non internal transition.*/
 
 		/*******************************************************************************************
@@ -1258,7 +1835,7 @@ BOOL SmeDispatchEvent(SME_EVENT_T *pEvent, SME_APP_T *pApp)
 		pHandler= NULL;
 
 		if (pNewState == SME_INTERNAL_TRAN)
-			SME_STATE_TRACK(pEvent, pApp, pOldState, SME_REASON_INTERNAL_TRAN, XGetTick() - nBeginTick);
+			SME_STATE_TRACK(pEvent, pApp, pOldState, SME_REASON_INTERNAL_TRAN, SmeClockNowNs() - nBeginTime);
 		else
 		{
 			SME_STATE_T *pExplicitNextState=NULL;
@@ -1294,6 +1871,10 @@ BOOL SmeDispatchEvent(SME_EVENT_T *pEvent, SME_APP_T *pApp)
 
 	SME_ASSERT_MSG(nRepeatTime<SME_MAX_PSEUDO_TRAN_NUM, SMESTR_ERR_A_LOOP_PSEUDO_STATE_TRAN);
 
+	/* Kill the state timers kept for re-arming, which the new states do not take. */
+	if (g_pfnRearmTimerProc)
+		KillIdleStateTimers(pApp);
+
 	/*******************************************************************************************
 	 Call event handle hook function if given event handler is available and no matter whether handler is empty or not.
 	 */
@@ -1315,7 +1896,7 @@ TRIGGERS:
 static SME_STATE_T* TransitToState(SME_APP_T *pApp, SME_STATE_T *pOldState, SME_STATE_T *pNewState, SME_EVENT_T *pEvent,
 								   SME_STATE_T *pExplicitNextState, /* IN/OUT */ int* pTranReason)
 {
-	int nBeginTick=XGetTick();
+	SME_UINT64 nBeginTime=SmeClockNowNs();
 	SME_STATE_T *pNextState=NULL;
 	
 	if (SME_INTERNAL_TRAN == pNewState)
@@ -1332,8 +1913,8 @@ static SME_STATE_T* TransitToState(SME_APP_T *pApp, SME_STATE_T *pOldState, SME_
 		int i=0;
 
 		pApp->pAppState = pNewState; 
-		SME_STATE_TRACK(pEvent, pApp, pOldState, *pTranReason, XGetTick() - nBeginTick);
-		nBeginTick = XGetTick();
+		SME_STATE_TRACK(pEvent, pApp, pOldState, *pTranReason, SmeClockNowNs() - nBeginTime);
+		nBeginTime = SmeClockNowNs();
 		*pTranReason = SME_REASON_COND;
 
 		/* There should be no built-in state timer in pseudo states. Do not increase nStateNum when enters a pseudo state. */
@@ -1361,8 +1942,8 @@ static SME_STATE_T* TransitToState(SME_APP_T *pApp, SME_STATE_T *pOldState, SME_
 		SME_EVENT_TABLE_T *pStateEventTable = pNewState->EventTable;
 
 		pApp->pAppState = pNewState; 
-		SME_STATE_TRACK(pEvent, pApp, pOldState, *pTranReason, XGetTick() - nBeginTick);
-		nBeginTick = XGetTick();
+		SME_STATE_TRACK(pEvent, pApp, pOldState, *pTranReason, SmeClockNowNs() - nBeginTime);
+		nBeginTime = SmeClockNowNs();
 		*pTranReason = SME_REASON_JOIN;
 
 		/* There should be no built-in state timer in pseudo states. Do not increase nStateNum when enters a pseudo state. */
@@ -1397,12 +1978,22 @@ static SME_STATE_T* TransitToState(SME_APP_T *pApp, SME_STATE_T *pOldState, SME_
 		pApp->pAppState = pNewState;
 		GetStateInfo(pNewState, &pChildState, &pfnDefSubStateAction, &nStateTimeOut, &pfnStateTimeoutAction, &pTimeOutDestState);
 
-		/* Start the state built-in timer. */
+		/* Start the state built-in timer. Re-arm the timer kept at this depth by the state exit if any. */
 		if (nStateTimeOut!=-1)
 		{
-			/* Set a state built-in timer. */
-			pApp->StateTimers[pApp->nStateNum] = g_pfnStateTimer(pApp,SME_STATE_BUILT_IN_TIMEOUT_VAL(nStateTimeOut)); 
+			unsigned int nTimer = pApp->StateTimers[pApp->nStateNum];
+			unsigned int nTimeOut = g_bOneShotStateTimers ? SME_STATE_BUILT_IN_TIMEOUT_VAL(SME_ONE_SHOT_TIMEOUT_VAL(nStateTimeOut)) 
+				: SME_STATE_BUILT_IN_TIMEOUT_VAL(nStateTimeOut);
+			if (0!=nTimer)
+				nTimer = g_pfnRearmTimerProc(nTimer, nTimeOut);
+			if (0==nTimer)
+				nTimer = g_pfnStateTimer(pApp, nTimeOut);
+			pApp->StateTimers[pApp->nStateNum] = nTimer;
 			SME_ASSERT_MSG(0!=pApp->StateTimers[pApp->nStateNum], SMESTR_ERR_FAIL_TO_SET_TIMER);
+		} else if (0!=pApp->StateTimers[pApp->nStateNum])
+		{
+			g_pfnKillTimerProc(pApp->StateTimers[pApp->nStateNum]);
+			pApp->StateTimers[pApp->nStateNum] = 0;
 		}
 		pApp->nStateNum++;
 
@@ -1415,7 +2006,7 @@ static SME_STATE_T* TransitToState(SME_APP_T *pApp, SME_STATE_T *pOldState, SME_
 				EnterOrthoState(pNewState,pApp);
 		}
 
-		SME_STATE_TRACK(pEvent, pApp, pOldState, *pTranReason, XGetTick() - nBeginTick);
+		SME_STATE_TRACK(pEvent, pApp, pOldState, *pTranReason, SmeClockNowNs() - nBeginTime);
 		*pTranReason = SME_REASON_ACTIVATED;
 
 		if (NULL==pExplicitNextState)
@@ -1472,78 +2063,690 @@ void SmeSetExtEventOprProc(SME_GET_EXT_EVENT_PROC_T fnGetExtEvent,
 }
 
 /*******************************************************************************************
-* DESCRIPTION:  This API function is the state machine engine event handling loop function. 
-*  It will never exit. 
-* INPUT:  
-* OUTPUT: None.
-* NOTE: 
-
-Engine has to check internal event first, because SmeActivateApp() may trigger some internal events.
+* DESCRIPTION:  This API function installs the optional function to post a batch of external events 
+*   to a thread at once, e.g. XPostThreadExtEventBatch() for the built-in external event pool.
+* NOTE: It should match the functions installed by SmeSetExtEventOprProc(). If it is NULL, 
+*   SmePostThreadExtEventBatch() posts the batch event by event.
+*******************************************************************************************/
+void SmeSetExtEventBatchProc(SME_POST_THREAD_EXT_EVENT_BATCH_PROC_T fnPostThreadExtEventBatch)
+{
+	g_pfnPostThreadExtEventBatch = fnPostThreadExtEventBatch;
+}
 
-Case:
-	SmeActivateApp(&SME_GET_APP_VAR(Player1),NULL);
-	SmeRun();
-  
+/*******************************************************************************************
+* DESCRIPTION:  This API function reads the engine clock, which is monotonic and in nano-seconds.
+*   It times the state handling, the per-thread timers and the trace lines.
 *******************************************************************************************/
-void SmeRun()
+SME_UINT64 SmeClockNowNs(void)
 {
-	SME_EVENT_T ExtEvent;
-	SME_EVENT_T *pEvent=NULL;
-	SME_APP_T *pApp;
-	
 	SME_THREAD_CONTEXT_PT pThreadContext=NULL;
-	if (g_pfnGetThreadContext)
-		pThreadContext = (*g_pfnGetThreadContext)();
-	if (!pThreadContext) return;
-
-	if (!g_pfnGetExtEvent) return;
 
-	pApp = pThreadContext->pActAppHdr;
-
-	while (TRUE)
+	if (g_bVirtualClock)
 	{
-		/* Check the internal event pool firstly. */
-		pEvent = GetEventFromQueue();
-		if (pEvent == NULL)
-		{
-			/* Wait for an external event. */
-			if (FALSE == (*g_pfnGetExtEvent)(&ExtEvent)) 
-				return; // Exit the thread.
-
-			pEvent = &ExtEvent;
-			pEvent->nOrigin = SME_EVENT_ORIGIN_EXTERNAL;
+		/* A region task of SME_RUN_MODE_PARALLEL reads the clock of the forking thread. */
+		if (g_pfnGetThreadContext)
+			pThreadContext = SME_OWNER_THREAD_CONTEXT((*g_pfnGetThreadContext)());
+		return g_nVirtualClockStartNs + (pThreadContext ? pThreadContext->nVirtualClockNs : 0);
+	}
+	return XGetTickNs();
+}
 
-			/* Call hook function on an external event coming. */
-			if (pThreadContext->fnOnEventComeHook)
-				(*pThreadContext->fnOnEventComeHook)(SME_EVENT_ORIGIN_EXTERNAL, pEvent);
-		}else
+/*******************************************************************************************
+* DESCRIPTION:  This API function switches the engine clock between the real monotonic clock 
+*   and the virtual clocks of the threads, which start at nNowNs and move only by SmeAdvanceTime().
+* NOTE: Switch it before any thread runs, because the deadlines of the timers are on the clock.
+*******************************************************************************************/
+void SmeSetVirtualClock(BOOL bVirtual, SME_UINT64 nNowNs)
+{
+	g_bVirtualClock = bVirtual;
+	g_nVirtualClockStartNs = nNowNs;
+}
+
+BOOL SmeIsVirtualClock(void)
+{
+	return g_bVirtualClock;
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function installs the function to get an external event with a time-out,
+*   which SmeRun() calls to wait no longer than the next per-thread timer expires.
+* NOTE: Without it, SmeSetThreadTimer() fails unless the virtual clock is on.
+*******************************************************************************************/
+void SmeSetExtEventTimeoutProc(SME_GET_EXT_EVENT_TIMEOUT_PROC_T fnGetExtEventTimeout)
+{
+	g_pfnGetExtEventTimeout = fnGetExtEventTimeout;
+}
+
+/*******************************************************************************************
+Per-thread timers.
+
+The timers of a thread live in a slot table at its thread context, and the armed ones are 
+ordered by deadline in a binary min-heap of slot indexes. A handle is the slot index with 
+a generation count of the slot in the upper bits, so a stale handle never kills a reused slot.
+*******************************************************************************************/
+#define SME_THREAD_TIMER_SLOT_MASK	((1U<<SME_TIMER_SLOT_BITS)-1)
+#define SME_THREAD_TIMER_GEN_MASK	((1U<<(32-SME_TIMER_SLOT_BITS))-1)
+#define SME_THREAD_TIMER_INIT_NUM	16
+
+typedef struct SME_THREAD_TIMER_T_TAG
+{
+	SME_UINT64 nDeadline; /* In nano-seconds of SmeClockNowNs(). */
+	unsigned int nTimeOut;
+	unsigned int nHandle; /* 0 for a free slot. */
+	unsigned int nGeneration;
+	int nHeapIdx; /* The position in the heap, or the next free slot if it is free. */
+	SME_APP_T *pDestApp;
+} SME_THREAD_TIMER_T;
+
+typedef struct SME_THREAD_TIMERS_T_TAG
+{
+	SME_THREAD_TIMER_T *pSlots;
+	int *pHeap;
+	int nSlotNum;
+	int nHeapNum;
+	int nFreeSlot; /* -1 if no free slot. */
+} SME_THREAD_TIMERS_T;
+
+/* Lock the per-thread timers of the thread context which owns them, and return it. The region tasks of 
+SME_RUN_MODE_PARALLEL share the timers of the forking thread at the same time, so they take turns by a ticket lock. */
+static SME_THREAD_CONTEXT_PT LockThreadTimers(void)
+{
+	SME_THREAD_CONTEXT_PT pThreadContext=NULL;
+	SME_THREAD_CONTEXT_PT pOwner;
+	unsigned int nTicket;
+
+	if (g_pfnGetThreadContext)
+		pThreadContext = (*g_pfnGetThreadContext)();
+	if (NULL==pThreadContext || NULL==pThreadContext->pForkParent)
+		return pThreadContext;
+
+	pOwner = pThreadContext->pForkParent;
+	nTicket = XAtomicFetchAdd(&(pOwner->nForkTicket), 1);
+	while (XAtomicLoadAcquire(&(pOwner->nForkServing)) != nTicket)
+		XCpuRelax();
+	return pOwner;
+}
+
+static void UnlockThreadTimers(SME_THREAD_CONTEXT_PT pOwner)
+{
+	SME_THREAD_CONTEXT_PT pThreadContext=NULL;
+
+	if (g_pfnGetThreadContext)
+		pThreadContext = (*g_pfnGetThreadContext)();
+	if (pThreadContext && pThreadContext->pForkParent)
+		XAtomicStoreRelease(&(pOwner->nForkServing), pOwner->nForkServing+1);
+}
+
+static SME_THREAD_TIMERS_T* GetThreadTimers(SME_THREAD_CONTEXT_PT pThreadContext, BOOL bCreate)
+{
+	SME_THREAD_TIMERS_T *pTimers;
+
+	if (!pThreadContext) return NULL;
+
+	pTimers = (SME_THREAD_TIMERS_T*)pThreadContext->pTimers;
+	if (NULL==pTimers && bCreate)
+	{
+		pTimers = (SME_THREAD_TIMERS_T*)XEmptyMemAlloc(sizeof(SME_THREAD_TIMERS_T));
+		if (NULL==pTimers) return NULL;
+		pTimers->nFreeSlot = -1;
+		pThreadContext->pTimers = pTimers;
+	}
+	return pTimers;
+}
+
+static void FreeThreadTimers(SME_THREAD_CONTEXT_PT pThreadContext)
+{
+	SME_THREAD_TIMERS_T *pTimers = (SME_THREAD_TIMERS_T*)pThreadContext->pTimers;
+	if (NULL==pTimers) return;
+	XMemFree(pTimers->pSlots);
+	XMemFree(pTimers->pHeap);
+	XMemFree(pTimers);
+	pThreadContext->pTimers = NULL;
+}
+
+/* Double the slot table and the heap. Return FALSE if out of memory or handles. */
+static BOOL GrowThreadTimers(SME_THREAD_TIMERS_T *pTimers)
+{
+	int nNum = pTimers->nSlotNum ? pTimers->nSlotNum*2 : SME_THREAD_TIMER_INIT_NUM;
+	SME_THREAD_TIMER_T *pSlots;
+	int *pHeap;
+	int i;
+
+	if ((unsigned int)nNum > SME_THREAD_TIMER_SLOT_MASK+1)
+		nNum = SME_THREAD_TIMER_SLOT_MASK+1;
+	if (nNum <= pTimers->nSlotNum)
+		return FALSE;
+
+	pSlots = (SME_THREAD_TIMER_T*)XEmptyMemAlloc(nNum*sizeof(SME_THREAD_TIMER_T));
+	pHeap = (int*)XEmptyMemAlloc(nNum*sizeof(int));
+	if (NULL==pSlots || NULL==pHeap)
+	{
+		XMemFree(pSlots);
+		XMemFree(pHeap);
+		return FALSE;
+	}
+	if (pTimers->nSlotNum)
+	{
+		memcpy(pSlots, pTimers->pSlots, pTimers->nSlotNum*sizeof(SME_THREAD_TIMER_T));
+		memcpy(pHeap, pTimers->pHeap, pTimers->nHeapNum*sizeof(int));
+		XMemFree(pTimers->pSlots);
+		XMemFree(pTimers->pHeap);
+	}
+	for (i=nNum-1; i>=pTimers->nSlotNum; i--)
+	{
+		pSlots[i].nHeapIdx = pTimers->nFreeSlot;
+		pTimers->nFreeSlot = i;
+	}
+	pTimers->pSlots = pSlots;
+	pTimers->pHeap = pHeap;
+	pTimers->nSlotNum = nNum;
+	return TRUE;
+}
+
+static void PlaceThreadTimer(SME_THREAD_TIMERS_T *pTimers, int nIdx, int nSlot)
+{
+	pTimers->pHeap[nIdx] = nSlot;
+	pTimers->pSlots[nSlot].nHeapIdx = nIdx;
+}
+
+/* Move the timer at the heap position nIdx up or down to restore the heap order. */
+static void FixThreadTimerHeap(SME_THREAD_TIMERS_T *pTimers, int nIdx)
+{
+	int nSlot = pTimers->pHeap[nIdx];
+	SME_UINT64 nDeadline = pTimers->pSlots[nSlot].nDeadline;
+	int nParent, nChild;
+
+	while (nIdx > 0)
+	{
+		nParent = (nIdx-1)/2;
+		if (pTimers->pSlots[pTimers->pHeap[nParent]].nDeadline <= nDeadline)
+			break;
+		PlaceThreadTimer(pTimers, nIdx, pTimers->pHeap[nParent]);
+		nIdx = nParent;
+	}
+	while ((nChild = nIdx*2+1) < pTimers->nHeapNum)
+	{
+		if (nChild+1 < pTimers->nHeapNum 
+			&& pTimers->pSlots[pTimers->pHeap[nChild+1]].nDeadline < pTimers->pSlots[pTimers->pHeap[nChild]].nDeadline)
+			nChild++;
+		if (nDeadline <= pTimers->pSlots[pTimers->pHeap[nChild]].nDeadline)
+			break;
+		PlaceThreadTimer(pTimers, nIdx, pTimers->pHeap[nChild]);
+		nIdx = nChild;
+	}
+	PlaceThreadTimer(pTimers, nIdx, nSlot);
+}
+
+static SME_THREAD_TIMER_T* GetThreadTimer(SME_THREAD_TIMERS_T *pTimers, unsigned int nHandle)
+{
+	unsigned int nSlot = nHandle & SME_THREAD_TIMER_SLOT_MASK;
+	if (NULL==pTimers || 0==nHandle || nSlot >= (unsigned int)pTimers->nSlotNum 
+		|| pTimers->pSlots[nSlot].nHandle != nHandle)
+		return NULL;
+	return &(pTimers->pSlots[nSlot]);
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function sets a per-thread timer of the calling thread, which posts 
+*   SME_EVENT_TIMER, or SME_EVENT_STATE_TIMER for a state built-in time-out value, to pDestApp 
+*   every nTimeOut milli-seconds.
+* OUTPUT: The timer handle, which is also the nSequenceNum of the time-out events. 0 on failure.
+* NOTE: It fails if neither SmeSetExtEventTimeoutProc() nor the virtual clock is set, because 
+*   SmeRun() would block for an external event with no deadline and the timer would not expire.
+*******************************************************************************************/
+static unsigned int SetThreadTimer(SME_THREAD_CONTEXT_PT pThreadContext, SME_APP_T *pDestApp, unsigned int nTimeOut)
+{
+	SME_THREAD_TIMERS_T *pTimers;
+	SME_THREAD_TIMER_T *pTimer;
+	unsigned int nGen;
+	int nSlot;
+
+	pTimers = GetThreadTimers(pThreadContext, TRUE);
+	if (NULL==pTimers) return 0;
+	if (-1==pTimers->nFreeSlot && !GrowThreadTimers(pTimers))
+		return 0;
+
+	nSlot = pTimers->nFreeSlot;
+	pTimer = &(pTimers->pSlots[nSlot]);
+	pTimers->nFreeSlot = pTimer->nHeapIdx;
+
+	nGen = (pTimer->nGeneration + 1) & SME_THREAD_TIMER_GEN_MASK;
+	if (0==nGen)
+		nGen = 1;
+	pTimer->nGeneration = nGen;
+	pTimer->nHandle = (nGen << SME_TIMER_SLOT_BITS) | (unsigned int)nSlot;
+	pTimer->nTimeOut = nTimeOut;
+	pTimer->pDestApp = pDestApp;
+	pTimer->nDeadline = SME_TIMER_SLACK_ROUND_UP(SmeClockNowNs() + (SME_UINT64)SME_GET_TIMEOUT_VAL(nTimeOut) * 1000000, 
+		(SME_UINT64)SME_GET_TIMER_SLACK(pDestApp) * 1000000);
+
+	PlaceThreadTimer(pTimers, pTimers->nHeapNum++, nSlot);
+	FixThreadTimerHeap(pTimers, pTimer->nHeapIdx);
+	return pTimer->nHandle;
+}
+
+unsigned int SmeSetThreadTimer(SME_APP_T *pDestApp, unsigned int nTimeOut)
+{
+	SME_THREAD_CONTEXT_PT pThreadContext;
+	unsigned int nHandle;
+
+	if (NULL==g_pfnGetExtEventTimeout && !g_bVirtualClock)
+		return 0;
+
+	pThreadContext = LockThreadTimers();
+	nHandle = SetThreadTimer(pThreadContext, pDestApp, nTimeOut);
+	UnlockThreadTimers(pThreadContext);
+	return nHandle;
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function kills a per-thread timer of the calling thread.
+* OUTPUT: TRUE if the timer is killed.
+*******************************************************************************************/
+static void FreeThreadTimer(SME_THREAD_TIMERS_T *pTimers, SME_THREAD_TIMER_T *pTimer)
+{
+	int nIdx, nSlot;
+
+	nIdx = pTimer->nHeapIdx;
+	nSlot = pTimers->pHeap[nIdx];
+	if (nIdx != --pTimers->nHeapNum)
+	{
+		PlaceThreadTimer(pTimers, nIdx, pTimers->pHeap[pTimers->nHeapNum]);
+		FixThreadTimerHeap(pTimers, nIdx);
+	}
+
+	pTimer->nHandle = 0;
+	pTimer->nHeapIdx = pTimers->nFreeSlot;
+	pTimers->nFreeSlot = nSlot;
+}
+
+int SmeKillThreadTimer(unsigned int nHandle)
+{
+	SME_THREAD_CONTEXT_PT pThreadContext = LockThreadTimers();
+	SME_THREAD_TIMERS_T *pTimers = GetThreadTimers(pThreadContext, FALSE);
+	SME_THREAD_TIMER_T *pTimer = GetThreadTimer(pTimers, nHandle);
+
+	if (pTimer)
+		FreeThreadTimer(pTimers, pTimer);
+	UnlockThreadTimers(pThreadContext);
+	return NULL!=pTimer;
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function re-arms a per-thread timer of the calling thread with a new 
+*   time-out value. The timer gets a new handle, so that a time-out event, which has expired but 
+*   not been dispatched yet, does not match it.
+* OUTPUT: The new handle, or 0 if the timer does not exist.
+*******************************************************************************************/
+static unsigned int RearmThreadTimer(SME_THREAD_TIMERS_T *pTimers, unsigned int nHandle, unsigned int nTimeOut)
+{
+	SME_THREAD_TIMER_T *pTimer = GetThreadTimer(pTimers, nHandle);
+	unsigned int nGen;
+
+	if (NULL==pTimer) return 0;
+
+	nGen = (pTimer->nGeneration + 1) & SME_THREAD_TIMER_GEN_MASK;
+	if (0==nGen)
+		nGen = 1;
+	pTimer->nGeneration = nGen;
+	pTimer->nHandle = (nGen << SME_TIMER_SLOT_BITS) | (nHandle & SME_THREAD_TIMER_SLOT_MASK);
+	pTimer->nTimeOut = nTimeOut;
+	pTimer->nDeadline = SME_TIMER_SLACK_ROUND_UP(SmeClockNowNs() + (SME_UINT64)SME_GET_TIMEOUT_VAL(nTimeOut) * 1000000, 
+		(SME_UINT64)SME_GET_TIMER_SLACK(pTimer->pDestApp) * 1000000);
+	FixThreadTimerHeap(pTimers, pTimer->nHeapIdx);
+	return pTimer->nHandle;
+}
+
+unsigned int SmeRearmThreadTimer(unsigned int nHandle, unsigned int nTimeOut)
+{
+	SME_THREAD_CONTEXT_PT pThreadContext = LockThreadTimers();
+	unsigned int nNewHandle = RearmThreadTimer(GetThreadTimers(pThreadContext, FALSE), nHandle, nTimeOut);
+
+	UnlockThreadTimers(pThreadContext);
+	return nNewHandle;
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function gets the remaining milli-seconds of a per-thread timer 
+*   of the calling thread, or 0 if the handle is invalid.
+*******************************************************************************************/
+unsigned int SmeGetThreadTimerRemain(unsigned int nHandle)
+{
+	SME_THREAD_CONTEXT_PT pThreadContext = LockThreadTimers();
+	SME_THREAD_TIMER_T *pTimer = GetThreadTimer(GetThreadTimers(pThreadContext, FALSE), nHandle);
+	SME_UINT64 nNow = SmeClockNowNs();
+	unsigned int nRemain = 0;
+
+	if (pTimer && pTimer->nDeadline > nNow)
+		nRemain = (unsigned int)((pTimer->nDeadline - nNow + 999999) / 1000000);
+	UnlockThreadTimers(pThreadContext);
+	return nRemain;
+}
+
+/* Translate the earliest expired per-thread timer into a time-out event, and restart it. 
+If none expires, return FALSE and the milli-seconds to the next expiry in *pnWait, XINFINITE if no timer is armed. */
+static BOOL GetThreadTimerEvent(SME_THREAD_CONTEXT_PT pThreadContext, SME_EVENT_T *pEvent, unsigned int *pnWait)
+{
+	SME_THREAD_TIMERS_T *pTimers = (SME_THREAD_TIMERS_T*)pThreadContext->pTimers;
+	SME_THREAD_TIMER_T *pTimer;
+	SME_UINT64 nNow, nPeriod, nWait;
+
+	*pnWait = XINFINITE;
+	if (NULL==pTimers || 0==pTimers->nHeapNum)
+		return FALSE;
+
+	pTimer = &(pTimers->pSlots[pTimers->pHeap[0]]);
+	nNow = SmeClockNowNs();
+	if (pTimer->nDeadline > nNow)
+	{
+		if (g_bVirtualClock)
+			return FALSE; /* Only SmeAdvanceTime() moves the virtual clock to the deadline. */
+		nWait = (pTimer->nDeadline - nNow + 999999) / 1000000;
+		*pnWait = (nWait < XINFINITE) ? (unsigned int)nWait : XINFINITE-1;
+		return FALSE;
+	}
+
+	memset(pEvent, 0, sizeof(SME_EVENT_T));
+	pEvent->nEventID = SME_IS_STATE_BUILT_IN_TIMEOUT_VAL(pTimer->nTimeOut) ? SME_EVENT_STATE_TIMER : SME_EVENT_TIMER;
+	pEvent->nSequenceNum = pTimer->nHandle;
+	pEvent->pDestApp = pTimer->pDestApp;
+	pEvent->nDataFormat = SME_EVENT_DATA_FORMAT_INT;
+	pEvent->nCategory = SME_EVENT_CAT_OTHER;
+	pEvent->bIsConsumed = FALSE;
+
+	if (SME_IS_ONE_SHOT_TIMEOUT_VAL(pTimer->nTimeOut))
+	{
+		FreeThreadTimer(pTimers, pTimer);
+		return TRUE;
+	}
+
+	/* Restart the timer from its deadline. Do not catch up on the missed periods. */
+	nPeriod = (SME_UINT64)SME_GET_TIMEOUT_VAL(pTimer->nTimeOut) * 1000000;
+	if (0==nPeriod)
+		nPeriod = 1000000;
+	pTimer->nDeadline += nPeriod;
+	if (pTimer->nDeadline <= nNow)
+		pTimer->nDeadline = nNow + nPeriod;
+	pTimer->nDeadline = SME_TIMER_SLACK_ROUND_UP(pTimer->nDeadline, (SME_UINT64)SME_GET_TIMER_SLACK(pTimer->pDestApp) * 1000000);
+	FixThreadTimerHeap(pTimers, 0);
+	return TRUE;
+}
+
+/* Dispatch an event, and then all internal events in the queue. The internal events are freed, but pExtEvent is not. */
+static void DispatchEventAndQueue(SME_THREAD_CONTEXT_PT pThreadContext, SME_EVENT_T *pEvent, SME_EVENT_T *pExtEvent)
+{
+	do { 
+		DispatchEventToApps(pThreadContext, pEvent);
+
+		/* Free internal event. Free external event later. */
+		if (pEvent != pExtEvent)
+			SmeDeleteEvent(pEvent);
+
+		/* Get an event from event queue if available. */
+		pEvent = GetEventFromQueue();
+		if (pEvent != NULL)
 		{
 			/* Call hook function on an internal event coming. */
 			if (pThreadContext->fnOnEventComeHook)
 				(*pThreadContext->fnOnEventComeHook)(SME_EVENT_ORIGIN_INTERNAL, pEvent);
 		}
+		else 
+		{
+			/* The internal event queue is empty. */
+			break;
+		}
+	} while (TRUE); /* Get all events from the internal event pool. */
+}
+
+/* Dispatch an event to an application as the only active application of the thread, and then the internal events 
+which it triggers. The internal events queued at the thread before are kept aside until it returns. */
+static void DispatchEventToAppAlone(SME_THREAD_CONTEXT_PT pThreadContext, SME_EVENT_T *pEvent, SME_APP_T *pApp)
+{
+	SME_APP_T *pActAppHdr = pThreadContext->pActAppHdr;
+	SME_APP_T *pFocusedApp = pThreadContext->pFocusedApp;
+	SME_APP_T *pNext = pApp->pNext;
+	SME_EVENT_T *pEventQueueFront = pThreadContext->pEventQueueFront;
+	SME_EVENT_T *pEventQueueRear = pThreadContext->pEventQueueRear;
+
+	pThreadContext->pActAppHdr = pApp;
+	pThreadContext->pFocusedApp = pApp;
+	pThreadContext->pEventQueueFront = pThreadContext->pEventQueueRear = NULL;
+	pApp->pNext = NULL;
+
+	DispatchEventAndQueue(pThreadContext, pEvent, pEvent);
+
+	pApp->pNext = pNext;
+	pThreadContext->pActAppHdr = pActAppHdr;
+	pThreadContext->pFocusedApp = pFocusedApp;
+	pThreadContext->pEventQueueFront = pEventQueueFront;
+	pThreadContext->pEventQueueRear = pEventQueueRear;
+}
+
+/* The event forked to a region of SME_RUN_MODE_PARALLEL. */
+typedef struct SME_REGION_TASK_T_TAG
+{
+	SME_APP_T *pApp;
+	SME_THREAD_CONTEXT_PT pForkParent; /* The thread context which owns the timers of the task. */
+	SME_EVENT_T Event; /* A copy of the event, which shares the pointer data. */
+} SME_REGION_TASK_T;
+
+static void RunRegionTask(void *pParam, int nIndex)
+{
+	SME_REGION_TASK_T *pTask = (SME_REGION_TASK_T *)pParam + nIndex;
+	SME_THREAD_CONTEXT_PT pThreadContext=NULL;
+	SME_THREAD_CONTEXT_PT pForkParent;
+
+	if (g_pfnGetThreadContext)
+		pThreadContext = (*g_pfnGetThreadContext)();
+	if (NULL==pThreadContext)
+		return;
+
+	/* The task sets its timers at the forking thread, which serves them after the join, wherever the task runs. */
+	pForkParent = pThreadContext->pForkParent;
+	pThreadContext->pForkParent = pTask->pForkParent;
+	DispatchEventToAppAlone(pThreadContext, &(pTask->Event), pTask->pApp);
+	pThreadContext->pForkParent = pForkParent;
+}
+
+/* Fork an event to the parallel regions from pApp on, which have the same parent, and join them. Return the application 
+after them. All the regions get the event, even if one of them consumes it, and it is consumed if a region consumes it. */
+static SME_APP_T* ForkJoinRegions(SME_THREAD_CONTEXT_PT pThreadContext, SME_EVENT_T *pEvent, SME_APP_T *pApp)
+{
+	SME_REGION_TASK_T Tasks[SME_MAX_PARALLEL_REGIONS];
+	SME_APP_T *pParent = pApp->pParent;
+	int nNum=0, i;
+
+	for (; pApp && pApp->bForkJoin && pApp->pParent==pParent && nNum<SME_MAX_PARALLEL_REGIONS; pApp=pApp->pNext)
+	{
+		Tasks[nNum].pApp = pApp;
+		Tasks[nNum].pForkParent = SME_OWNER_THREAD_CONTEXT(pThreadContext);
+		memcpy(&(Tasks[nNum].Event), pEvent, sizeof(SME_EVENT_T));
+		nNum++;
+	}
+
+	if (g_pfnForkJoin && nNum>1)
+		(*g_pfnForkJoin)(RunRegionTask, Tasks, nNum);
+	else
+		for (i=0; i<nNum; i++)
+			RunRegionTask(Tasks, i);
+
+	for (i=0; i<nNum; i++)
+		if (Tasks[i].Event.bIsConsumed)
+			pEvent->bIsConsumed = TRUE;
+	return pApp;
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function dispatches an external event to an application at the calling thread, 
+*   and then the internal events which it triggers. The application is the only active application 
+*   of the thread during the call, so that the internal events without a destination go to it.
+* INPUT: pEvent: The event, which the caller frees. pApp: An activated application.
+* OUTPUT: FALSE if the calling thread has no thread context.
+* NOTE: An executor runs an application, which is not linked to any thread context, this way.
+*******************************************************************************************/
+BOOL SmeDispatchAppEvent(SME_EVENT_T *pEvent, SME_APP_T *pApp)
+{
+	SME_THREAD_CONTEXT_PT pThreadContext=NULL;
 
-		do { 
-			DispatchEventToApps(pThreadContext, pEvent);
+	if (g_pfnGetThreadContext)
+		pThreadContext = (*g_pfnGetThreadContext)();
+	if (!pThreadContext || !pEvent || !pApp) return FALSE;
+
+	pEvent->nOrigin = SME_EVENT_ORIGIN_EXTERNAL;
+	if (pThreadContext->fnOnEventComeHook)
+		(*pThreadContext->fnOnEventComeHook)(SME_EVENT_ORIGIN_EXTERNAL, pEvent);
+	DispatchEventToAppAlone(pThreadContext, pEvent, pApp);
+	return TRUE;
+}
+
+/* Advance the virtual clock of the calling thread by nNs nano-seconds, and dispatch the time-out events of its per-thread 
+timers, which expire in the interval, in deadline order. At each dispatch, the clock reads the deadline of the timer. */
+static void AdvanceThreadClock(SME_THREAD_CONTEXT_PT pThreadContext, SME_UINT64 nNs)
+{
+	SME_THREAD_TIMERS_T *pTimers;
+	SME_EVENT_T TimerEvent;
+	SME_UINT64 nTarget, nDeadline;
+	unsigned int nWait;
+
+	nTarget = pThreadContext->nVirtualClockNs + nNs;
+	while (TRUE)
+	{
+		pTimers = (SME_THREAD_TIMERS_T*)pThreadContext->pTimers;
+		if (NULL==pTimers || 0==pTimers->nHeapNum)
+			break;
+		nDeadline = pTimers->pSlots[pTimers->pHeap[0]].nDeadline - g_nVirtualClockStartNs;
+		if (nDeadline > nTarget)
+			break;
+		if (nDeadline > pThreadContext->nVirtualClockNs)
+			pThreadContext->nVirtualClockNs = nDeadline;
+		if (!GetThreadTimerEvent(pThreadContext, &TimerEvent, &nWait))
+			break;
+
+		TimerEvent.nOrigin = SME_EVENT_ORIGIN_EXTERNAL;
+		if (pThreadContext->fnOnEventComeHook)
+			(*pThreadContext->fnOnEventComeHook)(SME_EVENT_ORIGIN_EXTERNAL, &TimerEvent);
+		DispatchEventAndQueue(pThreadContext, &TimerEvent, &TimerEvent);
+		SmeDeleteEvent(&TimerEvent);
+	}
+	if (nTarget > pThreadContext->nVirtualClockNs)
+		pThreadContext->nVirtualClockNs = nTarget;
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function advances the virtual clock of a thread by nNs nano-seconds, and dispatches 
+*   the time-out events of its per-thread timers, which expire in the interval, in deadline order. 
+* INPUT: pThreadContext: The thread context of the calling thread, or of another thread, which advances its 
+*   clock at SmeRun() on SME_EVENT_ADVANCE_TIME.
+* OUTPUT: FALSE if the virtual clock is off, the calling thread runs a region task of SME_RUN_MODE_PARALLEL, 
+*   or the event to another thread is dropped.
+*******************************************************************************************/
+BOOL SmeAdvanceTime(SME_THREAD_CONTEXT_T *pThreadContext, SME_UINT64 nNs)
+{
+	if (!g_bVirtualClock || NULL==pThreadContext || NULL==g_pfnGetThreadContext || pThreadContext->pForkParent)
+		return FALSE;
+
+	if (pThreadContext == (*g_pfnGetThreadContext)())
+	{
+		AdvanceThreadClock(pThreadContext, nNs);
+		return TRUE;
+	}
+	return 0==SmePostThreadExtIntEvent(pThreadContext, SME_EVENT_ADVANCE_TIME, (int)(unsigned int)nNs, (int)(unsigned int)(nNs>>32), 
+		NULL, 0, SME_EVENT_CAT_OTHER);
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function is the state machine engine event handling loop function. 
+*  It will never exit. 
+* INPUT:  
+* OUTPUT: None.
+* NOTE: 
+
+Engine has to check internal event first, because SmeActivateApp() may trigger some internal events.
+
+Case:
+	SmeActivateApp(&SME_GET_APP_VAR(Player1),NULL);
+	SmeRun();
+  
+*******************************************************************************************/
+void SmeRun()
+{
+	SME_EVENT_T ExtEvent;
+	SME_EVENT_T *pEvent=NULL;
+	SME_APP_T *pApp;
+	unsigned int nTimeOut;
+	int nRet;
+	
+	SME_THREAD_CONTEXT_PT pThreadContext=NULL;
+	if (g_pfnGetThreadContext)
+		pThreadContext = (*g_pfnGetThreadContext)();
+	if (!pThreadContext) return;
 
-			/* Free internal event. Free external event later. */
-			if (pEvent != &ExtEvent)
-				SmeDeleteEvent(pEvent);
+	if (!g_pfnGetExtEvent) return;
 
-			/* Get an event from event queue if available. */
-			pEvent = GetEventFromQueue();
-			if (pEvent != NULL)
+	pApp = pThreadContext->pActAppHdr;
+
+	while (TRUE)
+	{
+		/* Check the internal event pool firstly. */
+		pEvent = GetEventFromQueue();
+		if (pEvent == NULL)
+		{
+			/* Dispatch an expired per-thread timer, or wait for an external event until the next one expires. */
+			if (!GetThreadTimerEvent(pThreadContext, &ExtEvent, &nTimeOut))
 			{
-				/* Call hook function on an internal event coming. */
-				if (pThreadContext->fnOnEventComeHook)
-					(*pThreadContext->fnOnEventComeHook)(SME_EVENT_ORIGIN_INTERNAL, pEvent);
+				if (XINFINITE != nTimeOut && g_pfnGetExtEventTimeout)
+					nRet = (*g_pfnGetExtEventTimeout)(&ExtEvent, nTimeOut);
+				else
+					nRet = (*g_pfnGetExtEvent)(&ExtEvent) ? SME_EXT_EVENT_GOT : SME_EXT_EVENT_EXIT;
+
+				if (SME_EXT_EVENT_EXIT == nRet)
+				{
+					FreeThreadTimers(pThreadContext);
+					return; // Exit the thread.
+				}
+				if (SME_EXT_EVENT_TIMEOUT == nRet)
+					continue;
 			}
-			else 
+
+			/* Another thread advances the virtual clock of this thread. */
+			if (SME_EVENT_ADVANCE_TIME == ExtEvent.nEventID)
 			{
-				/* The internal event queue is empty. */
-				break;
+				AdvanceThreadClock(pThreadContext, 
+					(SME_UINT64)ExtEvent.Data.Int.nParam1 | ((SME_UINT64)ExtEvent.Data.Int.nParam2 << 32));
+				if (g_pfnDelExtEvent)
+				{
+					(*g_pfnDelExtEvent)(&ExtEvent);
+					SmeDeleteEvent(&ExtEvent); 
+				}
+				continue;
 			}
-		} while (TRUE); /* Get all events from the internal event pool. */
+
+			/* A region thread of an orthogonal state exit has stopped. */
+			if (SME_EVENT_REGION_ENDED == ExtEvent.nEventID)
+			{
+				OnRegionEnded(pThreadContext, &ExtEvent);
+				if (g_pfnDelExtEvent)
+				{
+					(*g_pfnDelExtEvent)(&ExtEvent);
+					SmeDeleteEvent(&ExtEvent); 
+				}
+				continue;
+			}
+
+			pEvent = &ExtEvent;
+			pEvent->nOrigin = SME_EVENT_ORIGIN_EXTERNAL;
+
+			/* Call hook function on an external event coming. */
+			if (pThreadContext->fnOnEventComeHook)
+				(*pThreadContext->fnOnEventComeHook)(SME_EVENT_ORIGIN_EXTERNAL, pEvent);
+		}else
+		{
+			/* Call hook function on an internal event coming. */
+			if (pThreadContext->fnOnEventComeHook)
+				(*pThreadContext->fnOnEventComeHook)(SME_EVENT_ORIGIN_INTERNAL, pEvent);
+		}
+
+		DispatchEventAndQueue(pThreadContext, pEvent, &ExtEvent);
 
 		/* Free external event if necessary. */
 		if (g_pfnDelExtEvent)
@@ -1617,6 +2820,14 @@ BOOL DispatchEventToApps(SME_THREAD_CONTEXT_PT pThreadContext,SME_EVENT_T *pEven
 		pApp = pThreadContext->pActAppHdr;
 		while (pApp != NULL) 
 		{
+			/* A parallel region which is the only active application runs its own task. */
+			if (pApp->bForkJoin && (pApp!=pThreadContext->pActAppHdr || pApp->pNext))
+			{
+				pApp = ForkJoinRegions(pThreadContext, pEvent, pApp);
+				if (pEvent->bIsConsumed) 
+					break;
+				continue;
+			}
 			SmeDispatchEvent(pEvent, pApp);
 			if (pEvent->bIsConsumed) 
 				break;
@@ -1725,24 +2936,63 @@ BOOL SmeMFreeRelease(void * pUserData)
 *	      pGetThreadContext: 	Thread context getting function pointer.	 
 * OUTPUT: None.
 * NOTE: 
-*   
+*   By default, XSetThreadContext() and XGetThreadContext() keep the thread context in a thread-local 
+*   variable. NULL restores the default.
 *******************************************************************************************/
 void SmeSetTlsProc(SME_SET_THREAD_CONTEXT_PROC pfnSetThreadContext, SME_GET_THREAD_CONTEXT_PROC pfnGetThreadContext)
 {
-	g_pfnSetThreadContext = pfnSetThreadContext;
-	g_pfnGetThreadContext = pfnGetThreadContext;
+	g_pfnSetThreadContext = pfnSetThreadContext ? pfnSetThreadContext : XSetThreadContext;
+	g_pfnGetThreadContext = pfnGetThreadContext ? pfnGetThreadContext : XGetThreadContext;
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function sets the plugin to create and destroy the external event pool 
+*   of a region process, which runs at SME_RUN_MODE_SEPARATE_PROCESS mode.
+* NOTE: 
+*   The pool should be accessible from both the parent and the forked process, for example in shared memory.
+*******************************************************************************************/
+void SmeSetExtMsgPoolProc(SME_CREATE_EXT_MSG_POOL_PROC_T fnCreateExtMsgPool, SME_DESTROY_EXT_MSG_POOL_PROC_T fnDestroyExtMsgPool)
+{
+	g_pfnCreateExtMsgPool = fnCreateExtMsgPool;
+	g_pfnDestroyExtMsgPool = fnDestroyExtMsgPool;
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function sets the plugin to fork a region process, which runs at 
+*   SME_RUN_MODE_SEPARATE_PROCESS mode, and to wait for it to exit, e.g. XShmForkRegionProcess() 
+*   and XShmWaitForRegionProcess() on Linux.
+* NOTE: 
+*   Without it, such regions run at independent threads.
+*******************************************************************************************/
+void SmeSetRegionProcessProc(SME_FORK_REGION_PROCESS_PROC_T fnForkRegionProcess, SME_WAIT_REGION_PROCESS_PROC_T fnWaitRegionProcess)
+{
+	g_pfnForkRegionProcess = fnForkRegionProcess;
+	g_pfnWaitRegionProcess = fnWaitRegionProcess;
 }
 
 /*******************************************************************************************
 * DESCRIPTION:  This API function uses the appropriate plugin to send INT events
-*   
+*   It returns the result of the plugin, which is not 0 if the event is dropped.
 *******************************************************************************************/
 int SmePostThreadExtIntEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, int Param1, int Param2, 
 						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory)
 {
+	if (pDestApp && pDestApp->pMailbox && g_pfnPostAppExtEvent)
+	{
+		SME_EXT_EVENT_DESC Event;
+		Event.nMsgID = nMsgID;
+		Event.nDataFormat = SME_EVENT_DATA_FORMAT_INT;
+		Event.nCategory = nCategory;
+		Event.Data.Int.nParam1 = Param1;
+		Event.Data.Int.nParam2 = Param2;
+		Event.pDestApp = pDestApp;
+		Event.nSequenceNum = nSequenceNum;
+		return (*g_pfnPostAppExtEvent)(pDestApp, &Event);
+	}
+
     if (g_pfnPostThreadExtIntEvent)
     {
-        (*g_pfnPostThreadExtIntEvent)(pDestThreadContext, nMsgID, Param1, Param2, 
+        return (*g_pfnPostThreadExtIntEvent)(pDestThreadContext, nMsgID, Param1, Param2, 
                                       pDestApp, nSequenceNum, nCategory);
     }
     return 0;
@@ -1750,19 +3000,131 @@ int SmePostThreadExtIntEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgI
 
 /*******************************************************************************************
 * DESCRIPTION:  This API function uses the appropriate plugin to send PTR events
-*   
+*   It returns the result of the plugin, which is not 0 if the event is dropped.
 *******************************************************************************************/
 int SmePostThreadExtPtrEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, void *pData, int nDataSize, 
 						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory)
 {
+	if (pDestApp && pDestApp->pMailbox && g_pfnPostAppExtEvent)
+	{
+		SME_EXT_EVENT_DESC Event;
+		Event.nMsgID = nMsgID;
+		Event.nDataFormat = SME_EVENT_DATA_FORMAT_PTR;
+		Event.nCategory = nCategory;
+		Event.Data.Ptr.pData = pData;
+		Event.Data.Ptr.nSize = nDataSize;
+		Event.pDestApp = pDestApp;
+		Event.nSequenceNum = nSequenceNum;
+		return (*g_pfnPostAppExtEvent)(pDestApp, &Event);
+	}
+
     if (g_pfnPostThreadExtPtrEvent)
     {
-        (*g_pfnPostThreadExtPtrEvent)(pDestThreadContext, nMsgID, pData, nDataSize, 
+        return (*g_pfnPostThreadExtPtrEvent)(pDestThreadContext, nMsgID, pData, nDataSize, 
                                       pDestApp, nSequenceNum, nCategory);
     }
     return 0;
 }
 
+/*******************************************************************************************
+* DESCRIPTION:  This API function uses the appropriate plugin to send INT events of a given priority.
+*   
+*******************************************************************************************/
+int SmePostThreadExtIntEventEx(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, int Param1, int Param2, 
+						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory, SME_EVENT_PRIORITY_T nPriority)
+{
+	if (nPriority >= SME_EVENT_PRIORITY_NUM)
+		return -1;
+	return SmePostThreadExtIntEvent(pDestThreadContext, nMsgID, Param1, Param2, pDestApp, nSequenceNum, 
+		SME_EVENT_CAT_WITH_PRIORITY(nCategory, nPriority));
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function uses the appropriate plugin to send PTR events of a given priority.
+*   
+*******************************************************************************************/
+int SmePostThreadExtPtrEventEx(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, void *pData, int nDataSize, 
+						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory, SME_EVENT_PRIORITY_T nPriority)
+{
+	if (nPriority >= SME_EVENT_PRIORITY_NUM)
+		return -1;
+	return SmePostThreadExtPtrEvent(pDestThreadContext, nMsgID, pData, nDataSize, pDestApp, nSequenceNum, 
+		SME_EVENT_CAT_WITH_PRIORITY(nCategory, nPriority));
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This function posts an event of a batch by the appropriate plugin.
+* OUTPUT: 0, or -1 if the event is dropped.
+*******************************************************************************************/
+static int SmePostThreadExtEventDesc(SME_THREAD_CONTEXT_T* pDestThreadContext, const SME_EXT_EVENT_DESC *pEvent)
+{
+	if (SME_EVENT_DATA_FORMAT_PTR == pEvent->nDataFormat)
+		return SmePostThreadExtPtrEvent(pDestThreadContext, pEvent->nMsgID, pEvent->Data.Ptr.pData, pEvent->Data.Ptr.nSize,
+			pEvent->pDestApp, pEvent->nSequenceNum, pEvent->nCategory);
+	return SmePostThreadExtIntEvent(pDestThreadContext, pEvent->nMsgID, pEvent->Data.Int.nParam1, pEvent->Data.Int.nParam2,
+		pEvent->pDestApp, pEvent->nSequenceNum, pEvent->nCategory);
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function uses the appropriate plugin to send a batch of events to 
+*   a thread. The batch plugin appends all of them at once, otherwise they are posted one by one.
+*   The events to the applications with a mailbox are posted to their mailboxes one by one, and 
+*   each run of the other events between them is appended by the batch plugin, in posting order.
+* OUTPUT: 0, or -1 if any event is dropped.
+*******************************************************************************************/
+int SmePostThreadExtEventBatch(SME_THREAD_CONTEXT_T* pDestThreadContext, const SME_EXT_EVENT_DESC *pEvents, int nNum)
+{
+	int i, nRunStart;
+	int nRet = 0;
+
+	if (NULL==pEvents || nNum<=0)
+		return -1;
+
+	if (NULL==g_pfnPostThreadExtEventBatch)
+	{
+		for (i=0; i<nNum; i++)
+			if (0!=SmePostThreadExtEventDesc(pDestThreadContext, &pEvents[i]))
+				nRet = -1;
+		return nRet;
+	}
+
+	nRunStart = 0;
+	for (i=0; i<=nNum; i++)
+	{
+		if (i<nNum && !(pEvents[i].pDestApp && pEvents[i].pDestApp->pMailbox && g_pfnPostAppExtEvent))
+			continue;
+		/* Flush the run of the events to the threads before an event to a mailbox, or at the end. */
+		if (i>nRunStart && 0!=(*g_pfnPostThreadExtEventBatch)(pDestThreadContext, &pEvents[nRunStart], i-nRunStart))
+			nRet = -1;
+		if (i<nNum && 0!=SmePostThreadExtEventDesc(pDestThreadContext, &pEvents[i]))
+			nRet = -1;
+		nRunStart = i+1;
+	}
+	return nRet;
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function sets the plugin to post external events to the mailboxes of 
+*   the applications, which an executor runs. The events to the other applications are posted 
+*   to their threads as before.
+* Return: Value of previous plugin, which can be restored afterwards.
+*******************************************************************************************/
+SME_POST_APP_EXT_EVENT_PROC_T SmeSetAppExtEventProc(SME_POST_APP_EXT_EVENT_PROC_T fnPostAppExtEvent)
+{
+	SME_POST_APP_EXT_EVENT_PROC_T p = g_pfnPostAppExtEvent;
+	g_pfnPostAppExtEvent = fnPostAppExtEvent;
+	return p;
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function sets the plugin to fork an event to the regions of 
+*   SME_RUN_MODE_PARALLEL, and join them. NULL to dispatch it to them one after another.
+*******************************************************************************************/
+void SmeSetForkJoinProc(SME_FORK_JOIN_PROC_T pfnForkJoin)
+{
+	g_pfnForkJoin = pfnForkJoin;
+}
+
 /*******************************************************************************************
 * DESCRIPTION:  This API function sets the SME event filter.
 * INPUT: pfnEventFilter: Pointer to event filter function
@@ -1791,3 +3153,50 @@ void SmeSetTimerProc(SME_STATE_TIMER_PROC_T pfnTimerProc,
     g_pfnKillTimerProc = pfnKillTimerProc;
 }
 
+/*******************************************************************************************
+* DESCRIPTION:  This API function sets the optional function to re-arm a timer of the timer functions
+*   set by SmeSetTimerProc(). 
+* NOTE: When a transition exits a state with a built-in timer and enters a state with a built-in timer 
+*   at the same depth, for example on a self transition, the engine re-arms the timer instead of killing 
+*   it and setting a new one. NULL turns it off.
+*******************************************************************************************/
+void SmeSetTimerRearmProc(SME_REARM_TIMER_PROC_T pfnRearmTimerProc)
+{
+	g_pfnRearmTimerProc = pfnRearmTimerProc;
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function sets the optional function to kill several timers of the timer functions
+*   set by SmeSetTimerProc() at once. 
+* NOTE: When a transition exits several states with built-in timers, the engine kills their timers 
+*   by a single call, e.g. XKillHrTimers() takes the timer lock once instead of once per state. NULL turns it off.
+*******************************************************************************************/
+void SmeSetKillTimersProc(SME_KILL_TIMERS_PROC_T pfnKillTimersProc)
+{
+	g_pfnKillTimersProc = pfnKillTimersProc;
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function sets the state built-in timers one-shot, or periodic by default.
+* NOTE: Turn it on only if the timer functions set by SmeSetTimerProc() honour SME_ONE_SHOT_TIMEOUT_VAL(), 
+*   as the built-in, the high resolution and the per-thread timers do.
+*******************************************************************************************/
+void SmeSetOneShotStateTimers(BOOL bOneShot)
+{
+	g_bOneShotStateTimers = bOneShot;
+}
+
+/*******************************************************************************************
+* DESCRIPTION:  This API function sets the default timer slack of an application.
+* INPUT: pApp: The application; 
+*        nSlack: The milli-seconds the timers of the application may expire late. 0 for none.
+* NOTE: Timers, which are set for the application afterwards, expire at a multiple of the slack,
+*   so that the timers of the same slack within a window expire together in a single wakeup.
+*******************************************************************************************/
+BOOL SmeSetTimerSlack(SME_APP_T *pApp, unsigned int nSlack)
+{
+	if (NULL==pApp) return FALSE;
+	pApp->nTimerSlack = nSlack;
+	return TRUE;
+}
+
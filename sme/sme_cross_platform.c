@@ -43,13 +43,16 @@
 #include "sme_cross_platform.h"
 #include "sme_ext_event.h"
 
+#ifdef SME_LINUX
+	#include <sys/mman.h>
+	#include <sys/syscall.h>
+
+	/* The memory policy of the set_mempolicy() and mbind() system calls, which are called directly without libnuma. */
+	#define XMPOL_PREFERRED	1
+#endif
+
 #define NO_TIMER_SUPPORT
 #define NO_THREAD_SUPPORT
-#ifdef NO_THREAD_SUPPORT
-    #define GET_THREAD_ID getpid()
-#else /* NO_THREAD_SUPPORT */
-    #define GET_THREAD_ID pthread_self()
-#endif /* NO_THREAD_SUPPORT */
 
 
 #ifdef XSetTimer 
@@ -220,6 +223,90 @@ int XSetThreadPriority(XTHREADHANDLE thread_handle, int nPriority)
 #endif /* NO_THREAD_SUPPORT */
 }
 
+int XSetThreadAffinity(unsigned long nCpuMask)
+{
+#ifdef NO_THREAD_SUPPORT
+	/* The embedder's threads are placed by the embedder. */
+	SME_UNUSED_INT_PARAM(nCpuMask);
+    return 0;
+#else /* NO_THREAD_SUPPORT */
+#ifdef SME_WIN32
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)nCpuMask)? 0: GetLastError();
+#else // SME_LINUX
+	cpu_set_t CpuSet;
+	unsigned int i;
+
+	if (0==nCpuMask)
+		return -1;
+
+	CPU_ZERO(&CpuSet);
+	for (i=0; i<sizeof(nCpuMask)*8; i++)
+		if (nCpuMask & (1UL<<i))
+			CPU_SET(i, &CpuSet);
+	return pthread_setaffinity_np(pthread_self(), sizeof(CpuSet), &CpuSet);
+#endif // SME_LINUX
+#endif /* NO_THREAD_SUPPORT */
+}
+
+int XSetThreadNumaNode(int nNumaNode)
+{
+#ifdef NO_THREAD_SUPPORT
+	SME_UNUSED_INT_PARAM(nNumaNode);
+    return 0;
+#else /* NO_THREAD_SUPPORT */
+#ifdef SME_WIN32
+	/* The memory of a thread is allocated on the node of its processor by default. */
+	ULONGLONG nCpuMask=0;
+	if (nNumaNode<0 || !GetNumaNodeProcessorMask((UCHAR)nNumaNode, &nCpuMask) || 0==nCpuMask)
+		return -1;
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)nCpuMask)? 0: GetLastError();
+#else // SME_LINUX
+	/* The processors of a node are listed as ranges in sysfs, such as "0-7,16-23". */
+	char sPath[64];
+	char sCpuList[256];
+	char *p;
+	cpu_set_t CpuSet;
+	unsigned long nNodeMask;
+	FILE *f;
+	int nRet;
+
+	if (nNumaNode<0 || nNumaNode>=(int)sizeof(nNodeMask)*8)
+		return -1;
+
+	snprintf(sPath, sizeof(sPath), "/sys/devices/system/node/node%d/cpulist", nNumaNode);
+	f = fopen(sPath, "r");
+	if (NULL==f)
+		return -1;
+	p = fgets(sCpuList, sizeof(sCpuList), f);
+	fclose(f);
+	if (NULL==p)
+		return -1;
+
+	CPU_ZERO(&CpuSet);
+	while (*p>='0' && *p<='9')
+	{
+		int nFirst = (int)strtol(p, &p, 10);
+		int nLast = nFirst;
+		if ('-'==*p)
+			nLast = (int)strtol(p+1, &p, 10);
+		for (; nFirst<=nLast && nFirst<CPU_SETSIZE; nFirst++)
+			CPU_SET(nFirst, &CpuSet);
+		if (','==*p)
+			p++;
+	}
+	if (0==CPU_COUNT(&CpuSet))
+		return -1;
+
+	nRet = pthread_setaffinity_np(pthread_self(), sizeof(CpuSet), &CpuSet);
+	if (0!=nRet)
+		return nRet;
+
+	nNodeMask = 1UL<<nNumaNode;
+	return (0==syscall(SYS_set_mempolicy, XMPOL_PREFERRED, &nNodeMask, sizeof(nNodeMask)*8+1))? 0: errno;
+#endif // SME_LINUX
+#endif /* NO_THREAD_SUPPORT */
+}
+
 #ifndef NO_THREAD_SUPPORT
 int XGetThreadPriority(XTHREADHANDLE thread_handle, int *pPriority)
 {
@@ -416,19 +503,58 @@ void XSleep(unsigned int milliseconds)
 
 int XGetTick(void)
 {
-#ifdef NO_THREAD_SUPPORT
-    return 0;
-#else /* NO_THREAD_SUPPORT */
+	return (int)(XGetTickNs() / 1000000);
+}
+
+static SME_UINT64 XGetMonotonicNs(void)
+{
 #ifdef SME_WIN32
-  return (int)GetTickCount();
+	LARGE_INTEGER Freq, Count;
+	QueryPerformanceFrequency(&Freq);
+	QueryPerformanceCounter(&Count);
+	return (SME_UINT64)(Count.QuadPart / Freq.QuadPart) * 1000000000 
+		+ (SME_UINT64)(Count.QuadPart % Freq.QuadPart) * 1000000000 / Freq.QuadPart;
 #else
-  struct timeval val;
-  gettimeofday(&val, NULL);
-  return (val.tv_sec *1000 + val.tv_usec / 1000);
+	struct timespec Now;
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (SME_UINT64)Now.tv_sec * 1000000000 + Now.tv_nsec;
 #endif
-#endif /* NO_THREAD_SUPPORT */
 }
 
+#if SME_CLOCK_TSC && (defined(__i386__) || defined(__x86_64__))
+/* The time stamp counter is calibrated against the monotonic clock over the first XTSC_CALIBRATION_NS nano-seconds. 
+Until then, the monotonic clock is read. */
+#define XTSC_CALIBRATION_NS	10000000
+static SME_UINT64 g_nTscBase = 0;
+static SME_UINT64 g_nTscNsBase = 0;
+static volatile double g_fNsPerTsc = 0;
+
+SME_UINT64 XGetTickNs(void)
+{
+	SME_UINT64 nNow, nTsc;
+
+	if (g_fNsPerTsc > 0)
+		return g_nTscNsBase + (SME_UINT64)((double)(__builtin_ia32_rdtsc() - g_nTscBase) * g_fNsPerTsc);
+
+	nNow = XGetMonotonicNs();
+	nTsc = __builtin_ia32_rdtsc();
+	if (0 == g_nTscBase)
+	{
+		g_nTscNsBase = nNow;
+		g_nTscBase = nTsc;
+	} else if (nNow - g_nTscNsBase >= XTSC_CALIBRATION_NS && nTsc > g_nTscBase)
+	{
+		g_fNsPerTsc = (double)(nNow - g_nTscNsBase) / (double)(nTsc - g_nTscBase);
+	}
+	return nNow;
+}
+#else
+SME_UINT64 XGetTickNs(void)
+{
+	return XGetMonotonicNs();
+}
+#endif
+
 char* XGetTimeStr(time_t nTime, char *szBuf, int nLen, const char* szFmt)
 {
 	const struct tm *pTime =localtime(&nTime);
@@ -564,7 +690,7 @@ int XMutexUnlock(XMUTEX *mutex_ptr)
     }
 }
 
-int XMutexDestroy(XMUTEX  *mutex_ptr)
+int XDestroyMutex(XMUTEX  *mutex_ptr)
 {
     int  ret_code = 0; 
 
@@ -698,7 +824,143 @@ int XWaitForEvent(XEVENT *pEvent, XMUTEX *pMutex, XIS_CODITION_OK_T pIsCondition
 		return rc;
 #endif
 }
+#endif /* NO_THREAD_SUPPORT */
+
+// The timed and the spinning waits below are built without the thread support of this file as well. They work on the 
+// mutex and the event created by XCreateMutex() and XCreateEvent(), the embedder's ones under NO_THREAD_SUPPORT, 
+// so they call the native APIs on XMUTEX and XEVENT directly instead of XMutexLock() and XMutexUnlock().
+
+// Wait for an event signaled until XGetMonotonicNs() reaches nDeadline nano-seconds, and then take some thread-safe actions.
+static int XWaitForEventUntil(XEVENT *pEvent, XMUTEX *pMutex, XIS_CODITION_OK_T pIsConditionOK, void *pCondParam,
+				  XTHREAD_SAFE_ACTION_T pAction, void *pActionParam, SME_UINT64 nDeadline)
+{
+#ifdef SME_WIN32
+	MSG WinMsg;
+	SME_UINT64 nNow;
+
+	if (pEvent==NULL || pMutex==NULL || pIsConditionOK==NULL)
+		return -1;
+
+	while (TRUE)
+	{
+		while (PeekMessage(&WinMsg, NULL, 0, 0, PM_REMOVE))
+		{
+			if (WinMsg.message == WM_QUIT)
+				return 0;
+			if (WinMsg.message == WM_EXT_EVENT_ID)
+			{
+				if (pAction)
+				{
+					WaitForSingleObject(*pMutex, INFINITE);
+					(*pAction)(pActionParam);
+					ReleaseMutex(*pMutex);
+				}
+				return 0;
+			}
+			DispatchMessage(&WinMsg);
+		}
+
+		nNow = XGetMonotonicNs();
+		if (nNow >= nDeadline)
+			return XWAIT_TIMEOUT;
+		MsgWaitForMultipleObjects(0, NULL, FALSE, (DWORD)((nDeadline - nNow + 999999) / 1000000), QS_ALLINPUT);
+	}
+#else
+	struct timespec Until;
+	int rc=0;
+
+	if (pEvent==NULL || pMutex==NULL || pIsConditionOK==NULL)
+		return -1;
+
+#if defined(__GLIBC__) && defined(_GNU_SOURCE) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 30))
+	Until.tv_sec = (time_t)(nDeadline / 1000000000);
+	Until.tv_nsec = (long)(nDeadline % 1000000000);
+#else
+	{
+		// The event is on the default real-time clock. Convert the monotonic deadline to it.
+		SME_UINT64 nNow = XGetMonotonicNs();
+		SME_UINT64 nReal;
+		struct timespec Now;
+		clock_gettime(CLOCK_REALTIME, &Now);
+		nReal = (SME_UINT64)Now.tv_sec * 1000000000 + Now.tv_nsec + (nDeadline > nNow ? nDeadline - nNow : 0);
+		Until.tv_sec = (time_t)(nReal / 1000000000);
+		Until.tv_nsec = (long)(nReal % 1000000000);
+	}
+#endif
+
+	pthread_mutex_lock(pMutex);
+
+	if (!(*pIsConditionOK)(pCondParam))
+	{
+#if defined(__GLIBC__) && defined(_GNU_SOURCE) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 30))
+		rc = pthread_cond_clockwait(pEvent, pMutex, CLOCK_MONOTONIC, &Until);
+#else
+		rc = pthread_cond_timedwait(pEvent, pMutex, &Until);
+#endif
+	}
+
+	if (0 == rc)
+	{
+		if (pAction)
+			(*pAction)(pActionParam);
+	}
+
+	pthread_mutex_unlock(pMutex);
+	return rc;
+#endif
+}
+
+// Busy-poll and yield on pIsPending according to the wait strategy, and then take the mutex to check the condition, 
+// blocking on the event if it is not met.
+int XWaitForEventEx(XEVENT *pEvent, XMUTEX *pMutex, XIS_CODITION_OK_T pIsConditionOK, void *pCondParam,
+				  XTHREAD_SAFE_ACTION_T pAction, void *pActionParam, const XWAIT_STRATEGY_T *pStrategy, 
+				  XIS_CODITION_OK_T pIsPending, unsigned int nTimeOut)
+{
+	SME_UINT64 nDeadline = 0;
+
+	if (XINFINITE != nTimeOut)
+		nDeadline = XGetMonotonicNs() + (SME_UINT64)nTimeOut * 1000000;
+
+#ifdef SME_LINUX
+	if (pStrategy && pIsPending && (pStrategy->nSpinNs || pStrategy->nYieldNum))
+	{
+		unsigned int i, nPause = 1;
+		BOOL bPending = FALSE;
+		SME_UINT64 nSpinDeadline = XGetMonotonicNs() + pStrategy->nSpinNs;
+
+		if (XINFINITE != nTimeOut && nSpinDeadline > nDeadline)
+			nSpinDeadline = nDeadline;
+
+		while (pStrategy->nSpinNs)
+		{
+			bPending = (*pIsPending)(pCondParam);
+			if (bPending || XGetMonotonicNs() >= nSpinDeadline)
+				break;
+			if (pStrategy->nMaxPause)
+			{
+				for (i=0; i<nPause; i++)
+					XCpuRelax();
+				if (nPause < pStrategy->nMaxPause)
+					nPause <<= 1;
+			}
+		}
+
+		for (i=0; i<pStrategy->nYieldNum && !bPending; i++)
+		{
+			sched_yield();
+			bPending = (*pIsPending)(pCondParam);
+		}
+	}
+#else
+	SME_UNUSED_VOIDP_PARAM(pStrategy);
+	pIsPending = NULL; // Spinning is supported on Linux only.
+#endif
+	if (XINFINITE == nTimeOut)
+		return XWaitForEvent(pEvent, pMutex, pIsConditionOK, pCondParam, pAction, pActionParam);
+	return XWaitForEventUntil(pEvent, pMutex, pIsConditionOK, pCondParam, pAction, pActionParam, nDeadline);
+}
 
+#ifndef NO_THREAD_SUPPORT
 // Take some thread-safe actions before signal the event.
 int XSignalEvent(XEVENT *pEvent, XMUTEX *pMutex, XTHREAD_SAFE_ACTION_T pAction, void *pActionParam)
 {
@@ -742,26 +1004,32 @@ int XSignalEvent(XEVENT *pEvent, XMUTEX *pMutex, XTHREAD_SAFE_ACTION_T pAction,
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // Thread Local Storage.
-#ifdef SME_WIN32
+/* The thread context pointer is a compiler thread-local variable if XTHREAD_LOCAL is available, 
+so that it is read without a system call or a search, and there is no limit of the number of threads. 
+Otherwise it is kept in a TLS slot of the operating system. */
+#if defined(XTHREAD_LOCAL)
+	static XTHREAD_LOCAL SME_THREAD_CONTEXT_PT g_pThreadContext = NULL;
+#elif defined(SME_WIN32)
 	static unsigned long g_dwTlsIndex=0xFFFFFFFF;
 #else
-	typedef struct TLS_DATA_T_TAG
+	static pthread_key_t g_TlsKey;
+	static pthread_once_t g_TlsKeyOnce = PTHREAD_ONCE_INIT;
+	static void XCreateTlsKey(void)
 	{
-		pthread_t nPThreadID;
-		SME_THREAD_CONTEXT_PT pThreadContext;
-	} TLS_DATA_T;
-
-	#define SME_MAX_TLS_NUM  10
-	static TLS_DATA_T g_TlsData[SME_MAX_TLS_NUM];
+		pthread_key_create(&g_TlsKey, NULL);
+	}
 #endif
 
 
 int XTlsAlloc()
 { 
-#ifdef SME_WIN32
-	g_dwTlsIndex = TlsAlloc();
+#if defined(XTHREAD_LOCAL)
+	/* Nothing to allocate. */
+#elif defined(SME_WIN32)
+	if (0xFFFFFFFF == g_dwTlsIndex)
+		g_dwTlsIndex = TlsAlloc();
 #else
-	memset(g_TlsData,0,sizeof(g_TlsData));
+	pthread_once(&g_TlsKeyOnce, XCreateTlsKey);
 #endif
 	return 0;
 }
@@ -769,148 +1037,332 @@ int XTlsAlloc()
 /* Allocate thread local storage resource. */
 BOOL XSetThreadContext(SME_THREAD_CONTEXT_PT p)
 {
-#ifdef SME_WIN32
 	if (NULL==p)
 		return FALSE;
-
+#if defined(XTHREAD_LOCAL)
+	g_pThreadContext = p;
+	return TRUE;
+#elif defined(SME_WIN32)
 	if (0xFFFFFFFF != g_dwTlsIndex)
 		return TlsSetValue(g_dwTlsIndex, p);
 	else
 		return FALSE;
 #else
-	/* A version of get_thread_area() first appeared in Linux 2.5.32.
-	struct user_desc u_info;
-	memset(&u_info,0,sizeof(u_info));
-	u_info.entry_number =1;
-	u_info.base_addr = (void*)p;
-	return (0==set_thread_area (&u_info));
-	*/
-	int i=0;
-	if (NULL==p)
-		return FALSE;
-	for (i=0; i<SME_MAX_TLS_NUM; i++)
-	{
-		if (NULL==g_TlsData[i].pThreadContext)
-		{
-			g_TlsData[i].nPThreadID = GET_THREAD_ID;
-			g_TlsData[i].pThreadContext = p;
-			return TRUE;
-		}
-	}
-	return FALSE;
+	XTlsAlloc();
+	return (0==pthread_setspecific(g_TlsKey, p));
 #endif
 }
 
 SME_THREAD_CONTEXT_PT XGetThreadContext()
 {
-#ifdef SME_WIN32
+#if defined(XTHREAD_LOCAL)
+	return g_pThreadContext;
+#elif defined(SME_WIN32)
 	if (0xFFFFFFFF != g_dwTlsIndex)
 		return (SME_THREAD_CONTEXT_T*)TlsGetValue(g_dwTlsIndex);
 	else
 		return NULL;
 #else
-	/* A version of get_thread_area() first appeared in Linux 2.5.32.
-	struct user_desc u_info;
-	int nRet;
-	memset(&u_info,0,sizeof(u_info));
-	nRet = get_thread_info(&u_info);
-	if (0==nRet)
-		return u_info.base_addr;
-	else
-		return NULL;
-	*/
-	int i=0;
-	pthread_t nSelf = GET_THREAD_ID;
-	for (i=0; i<SME_MAX_TLS_NUM; i++)
-	{
-		if (nSelf==g_TlsData[i].nPThreadID)
-		{
-			return g_TlsData[i].pThreadContext;
-		}
-	}
-	return NULL;
+	XTlsAlloc();
+	return (SME_THREAD_CONTEXT_PT)pthread_getspecific(g_TlsKey);
 #endif
 }
 
-/* Free thread local storage resource. */
+/* Free thread local storage resource of the calling thread. */
 BOOL XFreeThreadContext(SME_THREAD_CONTEXT_PT p)
 {
-#ifdef SME_WIN32
-	return FALSE;
+	if (NULL==p || p!=XGetThreadContext())
+		return FALSE;
+#if defined(XTHREAD_LOCAL)
+	g_pThreadContext = NULL;
+	return TRUE;
+#elif defined(SME_WIN32)
+	return TlsSetValue(g_dwTlsIndex, NULL);
 #else
-	int i=0;
-	for (i=0; i<SME_MAX_TLS_NUM; i++)
-	{
-		if (p==g_TlsData[i].pThreadContext)
-		{
-			g_TlsData[i].pThreadContext=NULL;
-			return TRUE;
-		}
-	}
-	return FALSE;
+	return (0==pthread_setspecific(g_TlsKey, NULL));
 #endif
 }
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 /******************************************************************************************
 *  Built-in Timer
 ******************************************************************************************/
+/* NOTE: This tree defines NO_TIMER_SUPPORT and NO_THREAD_SUPPORT at the top of this file, so the built-in timer below, 
+including the timing wheel and the timer slot table, is dead code here. XSetTimer(), XKillTimer() and XGetTimerRemain() 
+map to the embedder's SME_SetTimer(), SME_RemoveTimer() and SME_GetRemainTime() instead. The built-in timer is built 
+only when both macros are removed, because its mutex and its pulse thread need the thread support of this file. 
+On Linux, the high-resolution timer in sme_hr_timer.c is built in this tree, with a timing wheel and slot-indexed handles 
+of its own, and SmeSetTimerProc() installs it for the state built-in timers. */
 #ifndef NO_TIMER_SUPPORT
 typedef struct tagXTIMER_T
 {
 	unsigned int nTimerID;
 	unsigned int nTimeOut; /* SME_IS_STATE_BUILT_IN_TIMEOUT_VAL can check whether a state timer or not. */
-	int nLeft;
+	unsigned int nExpire; /* The tick in milli-seconds the timer expires at. For Linux only. */
 	unsigned long nSequenceNum;
 	SME_TIMER_PROC_T pfnTimerFunc;
 	SME_APP_T *pDestApp;
 	SME_THREAD_CONTEXT_T *pDestThread;
-	struct tagXTIMER_T *pNext;
+	struct tagXTIMER_T **ppSlot; /* The timing wheel slot which the timer is linked in. For Linux only. */
+	struct tagXTIMER_T *pPrev;
+	struct tagXTIMER_T *pNext; /* The next timer in the slot, or in the free list. */
+	unsigned int nSlot; /* The index in the timer slot table. */
+	unsigned int nGeneration;
 } XTIMER_T;
 
-static XTIMER_T *g_pTimerList=NULL;
-static unsigned long g_nTimerSeqNum =1;
+/* Timers live in a slot table which grows by chunks and never shrinks. The sequence number of a timer, which is also its handle, 
+is the slot index with a generation count in the upper bits. A handle is looked up in O(1), and once a timer is killed, its 
+handle never matches the reused slot. The sequence number of a free slot is 0. */
+#define XTIMER_SLOT_MASK	((1U<<SME_TIMER_SLOT_BITS)-1)
+#define XTIMER_GEN_MASK		((1U<<(32-SME_TIMER_SLOT_BITS))-1)
+#define XTIMER_CHUNK_BITS	10
+#define XTIMER_CHUNK_SIZE	(1<<XTIMER_CHUNK_BITS)
+#define XTIMER_CHUNK_NUM	((XTIMER_SLOT_MASK>>XTIMER_CHUNK_BITS)+1)
+#define XTIMER_SLOT(_nSlot) (&(g_TimerChunks[(_nSlot)>>XTIMER_CHUNK_BITS][(_nSlot)&(XTIMER_CHUNK_SIZE-1)]))
+
+static XTIMER_T *g_TimerChunks[XTIMER_CHUNK_NUM];
+static unsigned int g_nTimerSlotNum = 0; /* The number of slots allocated. */
+static XTIMER_T *g_pFreeTimer = NULL;
 static XMUTEX g_TimerMutex;
 static BOOL g_bInitedTimer = FALSE;
 
+// Find the armed timer of a handle. Return NULL if the timer is killed.
+static XTIMER_T* XFindTimer(unsigned long nSequenceNum)
+{
+	unsigned int nSlot = (unsigned int)nSequenceNum & XTIMER_SLOT_MASK;
+	XTIMER_T *pTimerData;
+
+	if (0==nSequenceNum || nSlot>=g_nTimerSlotNum)
+		return NULL;
+	pTimerData = XTIMER_SLOT(nSlot);
+	return (pTimerData->nSequenceNum == nSequenceNum) ? pTimerData : NULL;
+}
+
+// Give a timer a new handle by counting up the generation of its slot.
+static void XRenewTimerHandle(XTIMER_T *pTimerData)
+{
+	unsigned int nGen = (pTimerData->nGeneration + 1) & XTIMER_GEN_MASK;
+	if (0==nGen)
+		nGen = 1;
+	pTimerData->nGeneration = nGen;
+	pTimerData->nSequenceNum = (nGen << SME_TIMER_SLOT_BITS) | pTimerData->nSlot;
+}
+
+// Take a free timer slot, and give it a new handle.
+static XTIMER_T* XAllocTimer(void)
+{
+	XTIMER_T *pTimerData;
+	unsigned int i;
+
+	if (NULL==g_pFreeTimer)
+	{
+		XTIMER_T *pChunk;
+		if ((g_nTimerSlotNum>>XTIMER_CHUNK_BITS) >= XTIMER_CHUNK_NUM)
+			return NULL;
+		pChunk = (XTIMER_T*)calloc(XTIMER_CHUNK_SIZE, sizeof(XTIMER_T));
+		if (NULL==pChunk)
+			return NULL;
+		g_TimerChunks[g_nTimerSlotNum>>XTIMER_CHUNK_BITS] = pChunk;
+		for (i=XTIMER_CHUNK_SIZE; i>0; i--)
+		{
+			pChunk[i-1].nSlot = g_nTimerSlotNum + i-1;
+			pChunk[i-1].pNext = g_pFreeTimer;
+			g_pFreeTimer = &(pChunk[i-1]);
+		}
+		g_nTimerSlotNum += XTIMER_CHUNK_SIZE;
+	}
+
+	pTimerData = g_pFreeTimer;
+	g_pFreeTimer = pTimerData->pNext;
+
+	XRenewTimerHandle(pTimerData);
+	pTimerData->ppSlot = NULL;
+	pTimerData->pPrev = pTimerData->pNext = NULL;
+	return pTimerData;
+}
+
+static void XFreeTimer(XTIMER_T *pTimerData)
+{
+	pTimerData->nSequenceNum = 0;
+	pTimerData->pNext = g_pFreeTimer;
+	g_pFreeTimer = pTimerData;
+}
+
+// Post the time-out event of an expired timer, or invoke its call back function.
+static void XFireTimer(XTIMER_T *pTimerData)
+{
+	if (pTimerData->pfnTimerFunc)
+	{
+		// Invoke the call back function.
+		(*(pTimerData->pfnTimerFunc))(pTimerData->pDestApp, pTimerData->nSequenceNum);
+	} else
+	{
+		// Create an external timer event and post it .
+		SmePostThreadExtIntEvent(pTimerData->pDestThread, 
+			SME_IS_STATE_BUILT_IN_TIMEOUT_VAL(pTimerData->nTimeOut) ? SME_EVENT_STATE_TIMER : SME_EVENT_TIMER, 
+			SME_TIMER_TYPE_EVENT,
+			0, 
+			pTimerData->pDestApp,
+			pTimerData->nSequenceNum,
+			SME_EVENT_CAT_OTHER);
+	}
+}
 
 #ifdef SME_WIN32
 
 // The running thread of this function is as same as the running thread of the XSetTimer() namely application thread.
 void CALLBACK WinTimerProc(HWND hwnd, UINT uMsg, UINT_PTR nTimerID, DWORD dwTime)
 {
-	XTIMER_T *pTimerData = g_pTimerList;
+	XTIMER_T TimerData;
+	XTIMER_T *pTimerData = NULL;
+	unsigned int i;
 
 	//printf("WinTimerProc\n");
 
-	while (pTimerData)
+	XMutexLock(&g_TimerMutex);
+	for (i=0; i<g_nTimerSlotNum && NULL==pTimerData; i++)
 	{
-		if (pTimerData->nTimerID == nTimerID)
+		pTimerData = XTIMER_SLOT(i);
+		if (0==pTimerData->nSequenceNum || pTimerData->nTimerID != nTimerID)
+			pTimerData = NULL;
+	}
+	if (pTimerData)
+	{
+		memcpy(&TimerData, pTimerData, sizeof(XTIMER_T));
+		if (SME_IS_ONE_SHOT_TIMEOUT_VAL(pTimerData->nTimeOut))
 		{
-			if (pTimerData->pfnTimerFunc)
-			{
-				// Invoke the call back function.
-				(*(pTimerData->pfnTimerFunc))(pTimerData->pDestApp, pTimerData->nSequenceNum);
-			} else
-			{
-				// Create an external timer event and post it .
-				SmePostThreadExtIntEvent(pTimerData->pDestThread, 
-					SME_IS_STATE_BUILT_IN_TIMEOUT_VAL(pTimerData->nTimeOut) ? SME_EVENT_STATE_TIMER : SME_EVENT_TIMER, 
-					pTimerData->nSequenceNum,
-					SME_GET_STATE_BUILT_IN_TIMEOUT_VAL(pTimerData->nTimeOut),
-					pTimerData->pDestApp,
-					pTimerData->nSequenceNum,
-					SME_EVENT_CAT_OTHER
-					);
-			}
-			return;
+			KillTimer(NULL, pTimerData->nTimerID);
+			XFreeTimer(pTimerData);
 		}
-		pTimerData = pTimerData->pNext;
 	}
+	XMutexUnlock(&g_TimerMutex);
+
+	if (pTimerData)
+		XFireTimer(&TimerData);
 }
 	
 #else // SME_WIN32
 
-#define LINUX_BASIC_TIMER_INT   100 // 0.1 sec.
+#define LINUX_BASIC_TIMER_INT   1 // The pulse interval in milli-seconds.
+#define LINUX_TIMER_EXPIRE_BATCH  64 // The number of expired timers taken at a time under the timer mutex.
+
+/* Hierarchical timing wheel with a milli-second tick. The root level has a slot for each of the next 256 ticks. Each upper level 
+has 64 slots, and a slot covers a whole round of the level below. When a level wraps, the next slot of the level above is cascaded 
+down, so that setting, killing and expiring a timer are O(1) no matter how many timers are armed. */
+#define XWHEEL_ROOT_BITS	8
+#define XWHEEL_ROOT_SIZE	(1<<XWHEEL_ROOT_BITS)
+#define XWHEEL_ROOT_MASK	(XWHEEL_ROOT_SIZE-1)
+#define XWHEEL_BITS			6
+#define XWHEEL_SIZE			(1<<XWHEEL_BITS)
+#define XWHEEL_MASK			(XWHEEL_SIZE-1)
+#define XWHEEL_LEVELS		4 /* The number of levels above the root. 8+4*6 bits cover the 32-bit tick. */
+#define XWHEEL_INDEX(_nTick,_nLevel) (((_nTick) >> (XWHEEL_ROOT_BITS + (_nLevel)*XWHEEL_BITS)) & XWHEEL_MASK)
+
+static XTIMER_T *g_WheelRoot[XWHEEL_ROOT_SIZE];
+static XTIMER_T *g_Wheel[XWHEEL_LEVELS][XWHEEL_SIZE];
+static XTIMER_T *g_pWheelDue = NULL; /* The timers which expire at the tick being processed. */
+static unsigned int g_nWheelTick = 0; /* The next tick to process. */
+
+static unsigned int XGetTimerTick(void)
+{
+	return (unsigned int)(XGetTickNs() / 1000000);
+}
+
+static void XLinkTimer(XTIMER_T **ppSlot, XTIMER_T *pTimerData)
+{
+	pTimerData->ppSlot = ppSlot;
+	pTimerData->pPrev = NULL;
+	pTimerData->pNext = *ppSlot;
+	if (*ppSlot)
+		(*ppSlot)->pPrev = pTimerData;
+	*ppSlot = pTimerData;
+}
+
+static void XUnlinkTimer(XTIMER_T *pTimerData)
+{
+	if (NULL==pTimerData->ppSlot)
+		return;
+	if (pTimerData->pPrev)
+		pTimerData->pPrev->pNext = pTimerData->pNext;
+	else
+		*(pTimerData->ppSlot) = pTimerData->pNext;
+	if (pTimerData->pNext)
+		pTimerData->pNext->pPrev = pTimerData->pPrev;
+	pTimerData->ppSlot = NULL;
+	pTimerData->pPrev = pTimerData->pNext = NULL;
+}
+
+static void XAddTimerToWheel(XTIMER_T *pTimerData)
+{
+	unsigned int nDelta = pTimerData->nExpire - g_nWheelTick;
+	int nLevel;
+
+	if ((int)nDelta < 0)
+	{
+		// Already due. Expire it at the next tick.
+		XLinkTimer(&(g_WheelRoot[g_nWheelTick & XWHEEL_ROOT_MASK]), pTimerData);
+		return;
+	}
+	if (nDelta < XWHEEL_ROOT_SIZE)
+	{
+		XLinkTimer(&(g_WheelRoot[pTimerData->nExpire & XWHEEL_ROOT_MASK]), pTimerData);
+		return;
+	}
+	for (nLevel=0; nLevel<XWHEEL_LEVELS-1; nLevel++)
+	{
+		if (nDelta < (1U << (XWHEEL_ROOT_BITS + (nLevel+1)*XWHEEL_BITS)))
+			break;
+	}
+	XLinkTimer(&(g_Wheel[nLevel][XWHEEL_INDEX(pTimerData->nExpire, nLevel)]), pTimerData);
+}
+
+// Move the timers in the current slot of a level down to the levels below. Return the slot index.
+static unsigned int XCascadeTimers(int nLevel)
+{
+	unsigned int nIdx = XWHEEL_INDEX(g_nWheelTick, nLevel);
+	XTIMER_T *pTimerData = g_Wheel[nLevel][nIdx];
+	XTIMER_T *pNext;
+
+	g_Wheel[nLevel][nIdx] = NULL;
+	while (pTimerData)
+	{
+		pNext = pTimerData->pNext;
+		pTimerData->ppSlot = NULL;
+		XAddTimerToWheel(pTimerData);
+		pTimerData = pNext;
+	}
+	return nIdx;
+}
+
+// Take the next timer which expires by the tick nNow off the wheel. Return NULL if none.
+static XTIMER_T* XPopExpiredTimer(unsigned int nNow)
+{
+	XTIMER_T *pTimerData;
+	unsigned int nIdx;
+	int nLevel;
+
+	while (NULL==g_pWheelDue)
+	{
+		if ((int)(nNow - g_nWheelTick) < 0)
+			return NULL;
+
+		nIdx = g_nWheelTick & XWHEEL_ROOT_MASK;
+		if (0==nIdx)
+		{
+			for (nLevel=0; nLevel<XWHEEL_LEVELS && 0==XCascadeTimers(nLevel); nLevel++)
+				;
+		}
+		g_nWheelTick++;
+
+		g_pWheelDue = g_WheelRoot[nIdx];
+		g_WheelRoot[nIdx] = NULL;
+		for (pTimerData=g_pWheelDue; pTimerData; pTimerData=pTimerData->pNext)
+			pTimerData->ppSlot = &g_pWheelDue;
+	}
+
+	pTimerData = g_pWheelDue;
+	XUnlinkTimer(pTimerData);
+	return pTimerData;
+}
 
 static volatile BOOL g_bExitPluseThread = FALSE;
 static XTHREADHANDLE g_PlusThreadHandle;
@@ -945,49 +1397,45 @@ signals by calling the function sigwait() with details of the signals it wishes
 //static void LinuxTimerProc(int sig) // For Linux ALARM signal solution.
 static void LinuxTimerProc()
 {
-
-	XTIMER_T *pTimerData = g_pTimerList;
+	XTIMER_T Expired[LINUX_TIMER_EXPIRE_BATCH];
+	XTIMER_T *pTimerData;
+	unsigned int nNow = XGetTimerTick();
+	unsigned int nPeriod;
+	int i, nNum;
 
 	//if (SIGALRM!=sig)
 	//	return;
 
-	while (pTimerData)
+	do 
 	{
-		if (pTimerData->nLeft <= LINUX_BASIC_TIMER_INT)
+		nNum = 0;
+		XMutexLock(&g_TimerMutex);
+		while (nNum<LINUX_TIMER_EXPIRE_BATCH && NULL!=(pTimerData=XPopExpiredTimer(nNow)))
 		{
-			// Time out
-			// printf("TimeOut\n");
-			if (pTimerData->pfnTimerFunc)
-			{
-#if 0
-				SmePostThreadExtIntEvent(pTimerData->pDestThread, 
-					SME_TIMER_TYPE_CALLBACK, 
-					(int)(pTimerData->pfnTimerFunc), 
-					pTimerData->pDestApp,
-					pTimerData->nSequenceNum,
-					SME_EVENT_CAT_OTHER);
-#endif
-                (*(pTimerData->pfnTimerFunc))(pTimerData->pDestApp, pTimerData->nSequenceNum);
+			memcpy(&(Expired[nNum++]), pTimerData, sizeof(XTIMER_T));
 
-			} else
+			if (SME_IS_ONE_SHOT_TIMEOUT_VAL(pTimerData->nTimeOut))
 			{
-				// Create an external timer event and post it .
-				// printf("Post TimeOut event\n");
-				SmePostThreadExtIntEvent(pTimerData->pDestThread, 
-					SME_IS_STATE_BUILT_IN_TIMEOUT_VAL(pTimerData->nTimeOut) ? SME_EVENT_STATE_TIMER : SME_EVENT_TIMER, 
-					SME_TIMER_TYPE_EVENT,
-					0, 
-					pTimerData->pDestApp,
-					pTimerData->nSequenceNum,
-					SME_EVENT_CAT_OTHER);
+				XFreeTimer(pTimerData);
+				continue;
 			}
-			pTimerData->nLeft = SME_GET_STATE_BUILT_IN_TIMEOUT_VAL(pTimerData->nTimeOut); // Restart timer
-			//return;
-		} else
-			pTimerData->nLeft -= LINUX_BASIC_TIMER_INT;
 
-		pTimerData = pTimerData->pNext;
-	}
+			// Restart timer
+			nPeriod = SME_GET_TIMEOUT_VAL(pTimerData->nTimeOut);
+			if (0==nPeriod)
+				nPeriod = 1;
+			pTimerData->nExpire += nPeriod;
+			if ((int)(pTimerData->nExpire - nNow) <= 0)
+				pTimerData->nExpire = nNow + nPeriod; // Do not catch up on the missed periods.
+			pTimerData->nExpire = SME_TIMER_SLACK_ROUND_UP(pTimerData->nExpire, SME_GET_TIMER_SLACK(pTimerData->pDestApp));
+			XAddTimerToWheel(pTimerData);
+		}
+		XMutexUnlock(&g_TimerMutex);
+
+		// Time out. The expired timers are handled out of the timer mutex, so that a call back function may set or kill timers.
+		for (i=0; i<nNum; i++)
+			XFireTimer(&(Expired[i]));
+	} while (LINUX_TIMER_EXPIRE_BATCH==nNum);
 
 	return;
 }
@@ -1093,6 +1541,7 @@ static int LinuxInitTimer()
 
 	g_bInitedTimer = TRUE;
 	g_bExitPluseThread = FALSE;
+	g_nWheelTick = XGetTimerTick();
 	// Create a thread to trigger external events.
 	return  XCreateThread(LinuxPulseProc, NULL, &g_PlusThreadHandle);
 
@@ -1133,42 +1582,52 @@ int XDestroyTimer()
 unsigned int XSetTimer(SME_APP_T *pDestApp, unsigned int nTimeOut, SME_TIMER_PROC_T pfnTimerFunc)
 {
 	XTIMER_T *pTimerData;
-	unsigned long nSeqNum = g_nTimerSeqNum++;
+	unsigned long nSeqNum;
 #ifdef SME_WIN32
 	UINT_PTR nTimerID;
 #endif
 
+	/* The per-thread timers keep the virtual clock. They do not call a callback function. */
+	if (SmeIsVirtualClock())
+		return pfnTimerFunc ? 0 : SmeSetThreadTimer(pDestApp, nTimeOut);
+
 	if (!g_bInitedTimer)
 		return 0;
 
 #ifdef SME_WIN32
-	nTimerID = SetTimer(NULL, 0, SME_GET_STATE_BUILT_IN_TIMEOUT_VAL(nTimeOut), (TIMERPROC)WinTimerProc); 
+	nTimerID = SetTimer(NULL, 0, SME_GET_TIMEOUT_VAL(nTimeOut), (TIMERPROC)WinTimerProc); 
 	if (nTimerID==0)
 		return 0;
+#endif
 
-    pTimerData = (XTIMER_T*)malloc(sizeof(XTIMER_T));
+	XMutexLock(&g_TimerMutex);
+	pTimerData = XAllocTimer();
 	if (!pTimerData)
+	{
+		XMutexUnlock(&g_TimerMutex);
+#ifdef SME_WIN32
+		KillTimer(NULL, nTimerID);
+#endif
 		return 0;
+	}
+	nSeqNum = pTimerData->nSequenceNum;
+
+#ifdef SME_WIN32
 	pTimerData->nTimerID = nTimerID;
-	pTimerData->nLeft = 0; // For Linux only
-		
 #else //SME_LINUX
-    pTimerData = (XTIMER_T*)malloc(sizeof(XTIMER_T));
-	if (!pTimerData)
-		return 0;
 	pTimerData->nTimerID = nSeqNum;
-	pTimerData->nLeft = SME_GET_STATE_BUILT_IN_TIMEOUT_VAL(nTimeOut); // For Linux only
+	pTimerData->nExpire = SME_TIMER_SLACK_ROUND_UP(XGetTimerTick() + SME_GET_TIMEOUT_VAL(nTimeOut), 
+		SME_GET_TIMER_SLACK(pDestApp)); // For Linux only
 #endif
 
 	pTimerData->pDestApp = pDestApp;
-	pTimerData->pDestThread = XGetThreadContext(); /* The time-out event destination thread is the current calling thread. */
+	pTimerData->pDestThread = SME_OWNER_THREAD_CONTEXT(XGetThreadContext()); /* The time-out event destination thread is the current calling thread. */
 	pTimerData->nTimeOut = nTimeOut; /* SME_IS_STATE_BUILT_IN_TIMEOUT_VAL can check whether a state timer or not. */
-	pTimerData->nSequenceNum = nSeqNum;
 	pTimerData->pfnTimerFunc = pfnTimerFunc;
 
-	XMutexLock(&g_TimerMutex);
-	pTimerData->pNext = g_pTimerList;
-	g_pTimerList = pTimerData;
+#ifndef SME_WIN32
+	XAddTimerToWheel(pTimerData);
+#endif
 	XMutexUnlock(&g_TimerMutex);
 
 	return nSeqNum;
@@ -1179,18 +1638,21 @@ unsigned int XGetTimerRemain(unsigned int nSequenceNum)
     XTIMER_T *pTimerData;
     int nLeft = -1;
 
+    if (SmeIsVirtualClock())
+        return SmeGetThreadTimerRemain(nSequenceNum);
+
     XMutexLock(&g_TimerMutex);
 
-    pTimerData = g_pTimerList;
-    
-    while(pTimerData != NULL)
+    pTimerData = XFindTimer(nSequenceNum);
+    if (pTimerData != NULL)
     {
-        if(pTimerData->nSequenceNum == nSequenceNum)
-        {
-            nLeft = pTimerData->nLeft;
-            break;
-        }
-        pTimerData = pTimerData->pNext;
+#ifdef SME_WIN32
+        nLeft = 0;
+#else
+        nLeft = (int)(pTimerData->nExpire - XGetTimerTick());
+        if (nLeft < 0)
+            nLeft = 0;
+#endif
     }
 
     XMutexUnlock(&g_TimerMutex);
@@ -1207,39 +1669,30 @@ unsigned int XSetEventTimer(SME_APP_T *pDestApp, unsigned  int nTimeOut)
 BOOL XKillTimer(unsigned int nSequenceNum)
 {
 	BOOL bRet=FALSE;
+	XTIMER_T *pTimerData;
 
-	XTIMER_T *pTimerData = g_pTimerList;
-	XTIMER_T *pPre = NULL;
+	if (SmeIsVirtualClock())
+		return SmeKillThreadTimer(nSequenceNum);
 
 	XMutexLock(&g_TimerMutex);
 
-	while (pTimerData)
+	pTimerData = XFindTimer(nSequenceNum);
+	if (pTimerData)
 	{
-		if (pTimerData->nSequenceNum == nSequenceNum)
-		{
 #ifdef SME_WIN32
-			bRet = KillTimer(NULL, pTimerData->nTimerID);
+		bRet = KillTimer(NULL, pTimerData->nTimerID);
+#else
+		XUnlinkTimer(pTimerData);
+		bRet = TRUE;
 #endif
-			// Remove the timer entity from the timer list.
-			if (pTimerData == g_pTimerList)
-			{
-				g_pTimerList =g_pTimerList->pNext;
-			} else
-			{
-				pPre->pNext = pTimerData->pNext;
-			}
-
-			free(pTimerData);
-			goto Last;
-		}
-		pPre = pTimerData;
-		pTimerData = pTimerData->pNext;
+		XFreeTimer(pTimerData);
 	}
 
-Last:	XMutexUnlock(&g_TimerMutex);
+	XMutexUnlock(&g_TimerMutex);
 
     return bRet;	
 }
+
 #endif /* NO_TIMER_SUPPORT */
 
 void* XEmptyMemAlloc(int nSize)
@@ -1253,3 +1706,44 @@ void XMemFree(void* p)
 {
 	free(p);
 }
+
+void* XNumaMemAlloc(int nSize, int nNumaNode)
+{
+	if (SME_NUMA_NODE_ANY==nNumaNode)
+		return XEmptyMemAlloc(nSize);
+#ifdef SME_WIN32
+	return VirtualAllocExNuma(GetCurrentProcess(), NULL, nSize, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE, (DWORD)nNumaNode);
+#else // SME_LINUX
+	{
+		/* The pages are placed on the node when they are touched first, after the policy is set on the mapping. */
+		unsigned long nNodeMask;
+		void *p;
+
+		if (nNumaNode<0 || nNumaNode>=(int)sizeof(nNodeMask)*8)
+			return NULL;
+		p = mmap(NULL, nSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (MAP_FAILED==p)
+			return NULL;
+		/* The memory is still usable on a kernel without NUMA support. */
+		nNodeMask = 1UL<<nNumaNode;
+		syscall(SYS_mbind, p, (unsigned long)nSize, XMPOL_PREFERRED, &nNodeMask, sizeof(nNodeMask)*8+1, 0);
+		return p;
+	}
+#endif // SME_LINUX
+}
+
+void XNumaMemFree(void* p, int nSize, int nNumaNode)
+{
+	if (NULL==p)
+		return;
+	if (SME_NUMA_NODE_ANY==nNumaNode)
+	{
+		XMemFree(p);
+		return;
+	}
+#ifdef SME_WIN32
+	VirtualFree(p, 0, MEM_RELEASE);
+#else // SME_LINUX
+	munmap(p, nSize);
+#endif // SME_LINUX
+}
@@ -633,7 +633,7 @@ If an application runs at multiple threads, please turn off this function.
 *******************************************************************************************/
 BOOL SmeStateTrack(SME_EVENT_T *pEvent, 
 			SME_APP_T *pDestApp,
-			SME_STATE_T* pOldState, SME_REASON_FOR_HANDLE_T nReason, int nTime) 			   
+			SME_STATE_T* pOldState, SME_REASON_FOR_HANDLE_T nReason, SME_UINT64 nTimeNs) 			   
 {
 	// Print state tracking in output window:
 	static BOOL bFirst = TRUE;
@@ -812,7 +812,7 @@ BOOL SmeStateTrack(SME_EVENT_T *pEvent,
 	}
 	if (g_FieldToLog & (1<<SME_LOG_FIELD_HANDLING_TIME))
 	{
-		snprintf(sTemp, SME_DIM(sTemp)-1, "%-10d", nTime);
+		snprintf(sTemp, SME_DIM(sTemp)-1, "%-10lu", (unsigned long)(nTimeNs / 1000));
 		strncat(sLog,sTemp,SME_DIM(sLog) - 1 - strlen(sLog));
 	}
 	if (g_FieldToLog & (1<<SME_LOG_FIELD_REASON))
@@ -1082,6 +1082,15 @@ BOOL SmeCatchCurrentStates()
 
 	return TRUE;
 }
+/* Append the engine clock in seconds and micro-seconds to a time stamp, which times the trace lines precisely. */
+static char* AppendClockStamp(char *sTimeStamp, int nLen)
+{
+	SME_UINT64 nNow = SmeClockNowNs();
+	int nUsed = strlen(sTimeStamp);
+	snprintf(sTimeStamp+nUsed, nLen-nUsed, " [%lu.%06lu]", (unsigned long)(nNow / 1000000000), (unsigned long)(nNow % 1000000000 / 1000));
+	return sTimeStamp;
+}
+
 /*******************************************************************************************
 * DESCRIPTION: Output debug string in ASCII in the default mode. Send it to Studio if running in, and 
   output the string to debug file. 
@@ -1116,12 +1125,13 @@ BOOL OutputDebugAsciiStr(const char* sDebugStr)
 	}
 #endif
 	{
-		char sTimeStamp[32];
+		char sTimeStamp[64];
 		FILE *f = fopen(SME_DEF_DBGLOG_FILE, "a+t");
 		if (NULL==f)
 			return FALSE;
 
 		XGetCurrentTimeStr(sTimeStamp, sizeof(sTimeStamp),SMESTR_TIME_STAMP_FMT);
+		AppendClockStamp(sTimeStamp, sizeof(sTimeStamp));
 		fputs(sTimeStamp,f);
 		fputs("\t",f);
 		fputs(sDebugStr,f);
@@ -1209,7 +1219,7 @@ BOOL OutputDebugUnicodeStr(const wchar_t* sDebugStr)
 #endif
 
 	{
-		char sTimeStamp[32];
+		char sTimeStamp[64];
 		FILE *f = fopen(SME_DEF_UNICODE_DBGLOG_FILE, "rb");
 		if (NULL==f)
 		{
@@ -1226,6 +1236,7 @@ BOOL OutputDebugUnicodeStr(const wchar_t* sDebugStr)
 		if( NULL!=f )
 		{
 			XGetCurrentTimeStr(sTimeStamp, sizeof(sTimeStamp),SMESTR_TIME_STAMP_FMT);
+			AppendClockStamp(sTimeStamp, sizeof(sTimeStamp));
 			WriteStrToUnicodeFile(sTimeStamp,f);
 			WriteStrToUnicodeFile("\t",f);
 			WriteUStrToUnicodeFile(sDebugStr,f);
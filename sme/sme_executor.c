@@ -0,0 +1,784 @@
+/* ==============================================================================================================================
+ * This notice must be untouched at all times.
+ *
+ * Copyright  IntelliWizard Inc. 
+ * All rights reserved.
+ * LICENSE: LGPL. 
+ * Redistributions of source code modifications must send back to the Intelliwizard Project and republish them. 
+ * Web: http://www.intelliwizard.com
+ * eMail: info@intelliwizard.com
+ * We provide technical supports for UML StateWizard users. The StateWizard users do NOT have to pay for technical supports 
+ * from the Intelliwizard team. We accept donation, but it is not mandatory.
+ * ==============================================================================================================================
+ Executor
+ Applications with a mailbox run on a pool of worker threads. A mailbox is in one of the states below, which is changed
+ under its mutex. Only a RUNNING mailbox is handled by a worker, and only an IDLE mailbox is put on a run queue when
+ mail comes, so that a mailbox is never on the run queues twice nor handled by two workers at once.
+
+ Each worker has its own run queue, a deque of ready mailboxes. A mailbox which gets ready at a worker goes to the tail of 
+ the queue of that worker, and a mailbox which gets ready at another thread goes to the workers in turn. A worker takes 
+ the mailboxes from the head of its own queue. When its queue is empty, it steals a mailbox from the tail of the queue of 
+ another worker, starting at a random one, so that a busy worker hands its pending applications over to the idle ones. 
+ A worker which finds nothing to steal sleeps on its own event until a mailbox gets ready.
+
+ A fork-join puts helper mailboxes on the run queues, which carry no mail. The forking thread and the workers which take 
+ the helpers claim the tasks by an atomic index, so the forking thread runs the tasks which no worker has claimed itself, 
+ and never waits for a helper which is still queued. The last one of the forking thread and the helpers frees the fork-join.
+
+ The executor runs on the thread functions of the cross-platform layer, but for the pthreads of the workers on Linux. On Win32 an event can be waited for only by the 
+ thread which creates it, so every event here is created by the thread which waits for it.
+*/
+
+#include "sme_executor.h"
+#include "sme_ext_event.h"
+#include <stdlib.h>
+
+enum
+{
+	XMAILBOX_IDLE=0, /* No mail. */
+	XMAILBOX_READY, /* On the run queue. */
+	XMAILBOX_RUNNING /* Handled by a worker. */
+};
+
+enum
+{
+	XMAIL_EVENT=0,
+	XMAIL_ACTIVATE,
+	XMAIL_DEACTIVATE
+};
+
+typedef struct tagXMAIL_T
+{
+	int nKind;
+	SME_EXT_EVENT_DESC Event; /* The pointer data is a copy, which is freed after the event is handled. */
+	struct tagXMAIL_T *pNext;
+} XMAIL_T;
+
+typedef struct tagXMAILBOX_T
+{
+	SME_APP_T *pApp;
+	struct tagXEXECUTOR_T *pExecutor;
+	XMUTEX Mutex;
+	XMAIL_T *pMailHead;
+	XMAIL_T *pMailTail;
+	int nState;
+	BOOL bClosed; /* The application is removed. No more mail is accepted. */
+	struct tagXMAILBOX_T *pPrevReady; /* The previous mailbox in the run queue. */
+	struct tagXMAILBOX_T *pNextReady; /* The next mailbox in the run queue. */
+	struct tagXMAILBOX_T *pNextMailbox; /* The next mailbox of the executor. */
+	struct tagXFORK_JOIN_T *pForkJoin; /* Set for a helper mailbox, which runs the tasks of a fork-join instead of mail. */
+} XMAILBOX_T;
+
+/* The mutex and the event which a forking thread waits on for its fork-joins. It is created at the first fork of the thread 
+and never freed, since a helper of the last fork-join may still release it after the thread exits. */
+typedef struct tagXFORK_JOIN_SYNC_T
+{
+	XMUTEX Mutex; /* Guards nDoneNum and nRefNum of the fork-joins of the thread. */
+	XEVENT Done;
+} XFORK_JOIN_SYNC_T;
+
+typedef struct tagXFORK_JOIN_T
+{
+	SME_FORK_TASK_PROC_T pfnTask;
+	void *pParam;
+	int nTaskNum;
+	int nNextTask; /* The next task to claim. */
+	XFORK_JOIN_SYNC_T *pSync; /* The sync of the forking thread. */
+	int nDoneNum; /* The number of the completed tasks. */
+	int nRefNum; /* The forking thread and the helpers which have not run. */
+	XMAILBOX_T *pHelpers;
+} XFORK_JOIN_T;
+
+typedef struct tagXEXECUTOR_WORKER_T
+{
+	SME_THREAD_CONTEXT_T ThreadContext;
+	XTHREADHANDLE Thread;
+	struct tagXEXECUTOR_T *pExecutor;
+	XMUTEX Mutex; /* Guards the run queue and bWoken. */
+	XEVENT Wakeup; /* Created by the worker, which sleeps on it. */
+	XMAILBOX_T *pReadyHead;
+	XMAILBOX_T *pReadyTail;
+	BOOL bSleeping; /* The worker is about to sleep or sleeping. */
+	BOOL bWoken; /* The worker is woken up since it sleeps. */
+	unsigned int nSeed; /* The seed to pick the first worker to steal from. */
+} XEXECUTOR_WORKER_T;
+
+struct tagXEXECUTOR_T
+{
+	XMUTEX Mutex; /* Guards the mailbox list and the worker counts. */
+	XEVENT StateEvent; /* Signaled when a worker starts or stops, to the thread which creates or destroys the executor. */
+	XMAILBOX_T *pMailboxes;
+	BOOL bExit;
+	int nIdleNum; /* The number of the sleeping workers. */
+	unsigned int nNextWorker; /* The worker to take the next mailbox which gets ready at another thread. */
+	int nWorkerNum;
+	int nCreatedNum; /* The number of the worker threads created. */
+	int nStartedNum; /* The number of the workers which have started. */
+	int nStoppedNum; /* The number of the workers which have stopped. */
+	SME_POST_APP_EXT_EVENT_PROC_T pfnOldPostAppExtEvent; /* The plugin restored by XDestroyExecutor(). */
+	XEXECUTOR_WORKER_T *pWorkers;
+};
+
+/* The worker of the calling thread, or NULL if it is not a worker. */
+static XTHREAD_LOCAL XEXECUTOR_WORKER_T *g_pCurrWorker = NULL;
+
+/* The fork-join sync of the calling thread. */
+static XTHREAD_LOCAL XFORK_JOIN_SYNC_T *g_pForkJoinSync = NULL;
+
+/* The executor which runs the fork-joins of XExecutorForkJoin(). */
+static XEXECUTOR_T *g_pForkJoinExecutor = NULL;
+
+static void XFreeMail(XMAIL_T *pMail)
+{
+	if (SME_EVENT_DATA_FORMAT_PTR == pMail->Event.nDataFormat && pMail->Event.Data.Ptr.pData)
+		free(pMail->Event.Data.Ptr.pData);
+	free(pMail);
+}
+
+/* Thread-safe actions and conditions on the worker wake-up. */
+static BOOL XIsWorkerWoken(void *pArg)
+{
+	return ((XEXECUTOR_WORKER_T*)pArg)->bWoken;
+}
+
+static int XWakeWorker(void *pArg)
+{
+	((XEXECUTOR_WORKER_T*)pArg)->bWoken = TRUE;
+	return 0;
+}
+
+static int XClearWorkerWoken(void *pArg)
+{
+	((XEXECUTOR_WORKER_T*)pArg)->bWoken = FALSE;
+	return 0;
+}
+
+/* Wake up a sleeping worker, the given one if it sleeps, so that it takes or steals a ready mailbox. */
+static void XWakeIdleWorker(XEXECUTOR_T *pExecutor, XEXECUTOR_WORKER_T *pWorker)
+{
+	int i;
+
+	if (XAtomicLoadAcquire(&pExecutor->nIdleNum) <= 0)
+		return;
+	if (!XAtomicLoadAcquire(&pWorker->bSleeping))
+	{
+		for (i=0; i<pExecutor->nWorkerNum; i++)
+		{
+			pWorker = &(pExecutor->pWorkers[i]);
+			if (XAtomicLoadAcquire(&pWorker->bSleeping))
+				break;
+		}
+		if (i==pExecutor->nWorkerNum)
+			return;
+	}
+	XSignalEvent(&pWorker->Wakeup, &pWorker->Mutex, XWakeWorker, pWorker);
+}
+
+/* Put a ready mailbox to the tail of the run queue of the calling worker, or of the next worker in turn. */
+static void XPushReadyMailbox(XEXECUTOR_T *pExecutor, XMAILBOX_T *pMailbox)
+{
+	XEXECUTOR_WORKER_T *pWorker = g_pCurrWorker;
+
+	if (NULL==pWorker || pWorker->pExecutor!=pExecutor)
+		pWorker = &(pExecutor->pWorkers[XAtomicFetchAdd(&pExecutor->nNextWorker, 1) % pExecutor->nWorkerNum]);
+
+	XMutexLock(&pWorker->Mutex);
+	pMailbox->pNextReady = NULL;
+	pMailbox->pPrevReady = pWorker->pReadyTail;
+	if (pWorker->pReadyTail)
+		pWorker->pReadyTail->pNextReady = pMailbox;
+	else
+		pWorker->pReadyHead = pMailbox;
+	pWorker->pReadyTail = pMailbox;
+	XMutexUnlock(&pWorker->Mutex);
+
+	/* Pairs with the barrier in XTakeReadyMailbox(), so that either the sleeping worker sees the mailbox, or it is woken up. */
+	XMemoryBarrier();
+	XWakeIdleWorker(pExecutor, pWorker);
+}
+
+/* Take a mailbox from the head of the run queue of a worker, or from the tail if it is stolen by another worker. */
+static XMAILBOX_T* XPopReadyMailbox(XEXECUTOR_WORKER_T *pWorker, BOOL bSteal)
+{
+	XMAILBOX_T *pMailbox;
+
+	XMutexLock(&pWorker->Mutex);
+	pMailbox = bSteal ? pWorker->pReadyTail : pWorker->pReadyHead;
+	if (pMailbox)
+	{
+		if (pMailbox->pPrevReady)
+			pMailbox->pPrevReady->pNextReady = pMailbox->pNextReady;
+		else
+			pWorker->pReadyHead = pMailbox->pNextReady;
+		if (pMailbox->pNextReady)
+			pMailbox->pNextReady->pPrevReady = pMailbox->pPrevReady;
+		else
+			pWorker->pReadyTail = pMailbox->pPrevReady;
+		pMailbox->pPrevReady = pMailbox->pNextReady = NULL;
+	}
+	XMutexUnlock(&pWorker->Mutex);
+	return pMailbox;
+}
+
+/* Take a mailbox from the own run queue, or steal one from the other workers, starting at a random worker. */
+static XMAILBOX_T* XFindReadyMailbox(XEXECUTOR_WORKER_T *pWorker)
+{
+	XEXECUTOR_T *pExecutor = pWorker->pExecutor;
+	XMAILBOX_T *pMailbox;
+	int nStart, i;
+
+	if (NULL != (pMailbox = XPopReadyMailbox(pWorker, FALSE)))
+		return pMailbox;
+	if (pExecutor->nWorkerNum < 2)
+		return NULL;
+
+	pWorker->nSeed = pWorker->nSeed * 1103515245 + 12345;
+	nStart = (int)((pWorker->nSeed >> 16) % pExecutor->nWorkerNum);
+	for (i=0; i<pExecutor->nWorkerNum; i++)
+	{
+		XEXECUTOR_WORKER_T *pVictim = &(pExecutor->pWorkers[(nStart+i) % pExecutor->nWorkerNum]);
+		if (pVictim != pWorker && NULL != (pMailbox = XPopReadyMailbox(pVictim, TRUE)))
+			return pMailbox;
+	}
+	return NULL;
+}
+
+/* Wait for a ready mailbox. Return NULL if the executor is being destroyed. */
+static XMAILBOX_T* XTakeReadyMailbox(XEXECUTOR_WORKER_T *pWorker)
+{
+	XEXECUTOR_T *pExecutor = pWorker->pExecutor;
+	XMAILBOX_T *pMailbox = NULL;
+
+	while (!XAtomicLoadAcquire(&pExecutor->bExit))
+	{
+		if (NULL != (pMailbox = XFindReadyMailbox(pWorker)))
+			return pMailbox;
+
+		XAtomicStoreRelease(&pWorker->bSleeping, TRUE);
+		XAtomicFetchAdd(&pExecutor->nIdleNum, 1);
+		XMemoryBarrier();
+		/* Look again after being counted as idle, since a mailbox may get ready before the worker sleeps. */
+		if (!XAtomicLoadAcquire(&pExecutor->bExit) && NULL == (pMailbox = XFindReadyMailbox(pWorker)))
+			XWaitForEvent(&pWorker->Wakeup, &pWorker->Mutex, XIsWorkerWoken, pWorker, XClearWorkerWoken, pWorker);
+		XAtomicFetchAdd(&pExecutor->nIdleNum, -1);
+		XAtomicStoreRelease(&pWorker->bSleeping, FALSE);
+		if (pMailbox)
+			return pMailbox;
+	}
+	return NULL;
+}
+
+/* Append a mail to a mailbox, and put the mailbox on the run queue if it is idle. */
+static BOOL XPostMail(XMAILBOX_T *pMailbox, XMAIL_T *pMail)
+{
+	BOOL bReady = FALSE;
+
+	pMail->pNext = NULL;
+	XMutexLock(&pMailbox->Mutex);
+	if (pMailbox->bClosed)
+	{
+		XMutexUnlock(&pMailbox->Mutex);
+		XFreeMail(pMail);
+		return FALSE;
+	}
+	if (pMailbox->pMailTail)
+		pMailbox->pMailTail->pNext = pMail;
+	else
+		pMailbox->pMailHead = pMail;
+	pMailbox->pMailTail = pMail;
+	if (XMAILBOX_IDLE == pMailbox->nState)
+	{
+		pMailbox->nState = XMAILBOX_READY;
+		bReady = TRUE;
+	}
+	if (XMAIL_DEACTIVATE == pMail->nKind)
+		pMailbox->bClosed = TRUE;
+	XMutexUnlock(&pMailbox->Mutex);
+
+	if (bReady)
+		XPushReadyMailbox(pMailbox->pExecutor, pMailbox);
+	return TRUE;
+}
+
+static void XHandleMail(XMAILBOX_T *pMailbox, XMAIL_T *pMail)
+{
+	SME_THREAD_CONTEXT_T *pThreadContext = XGetThreadContext();
+	SME_APP_T *pApp = pMailbox->pApp;
+	SME_EVENT_T Event;
+
+	switch (pMail->nKind)
+	{
+	case XMAIL_ACTIVATE:
+		/* The application is the only active application of the worker while it is activated. */
+		pThreadContext->pActAppHdr = NULL;
+		SmeActivateApp(pApp, NULL);
+		pThreadContext->pActAppHdr = NULL;
+		pThreadContext->pFocusedApp = NULL;
+		break;
+	case XMAIL_DEACTIVATE:
+		pThreadContext->pActAppHdr = pApp;
+		SmeDeactivateApp(pApp);
+		pThreadContext->pActAppHdr = NULL;
+		pThreadContext->pFocusedApp = NULL;
+		break;
+	default:
+		/* The built-in timers invoke their call back functions at the timer thread, so every timer event is a plain event here. */
+		if (!SME_IS_ACTIVATED(pApp))
+			break;
+		memset(&Event, 0, sizeof(Event));
+		Event.nEventID = pMail->Event.nMsgID;
+		Event.pDestApp = pApp;
+		Event.nSequenceNum = pMail->Event.nSequenceNum;
+		Event.nDataFormat = pMail->Event.nDataFormat;
+		Event.nCategory = SME_EVENT_CAT_OF(pMail->Event.nCategory);
+		Event.bIsConsumed = FALSE;
+		memcpy(&(Event.Data), &(pMail->Event.Data), sizeof(union SME_EVENT_DATA_T));
+		SmeDispatchAppEvent(&Event, pApp);
+		SmeDeleteEvent(&Event);
+		break;
+	}
+}
+
+/* Thread-safe action to count the completed tasks of a fork-join. */
+typedef struct tagXFORK_TASKS_DONE_T
+{
+	XFORK_JOIN_T *pForkJoin;
+	int nNum;
+} XFORK_TASKS_DONE_T;
+
+static int XAddDoneTasks(void *pArg)
+{
+	XFORK_TASKS_DONE_T *pDone = (XFORK_TASKS_DONE_T*)pArg;
+	pDone->pForkJoin->nDoneNum += pDone->nNum;
+	return 0;
+}
+
+static BOOL XIsForkJoinDone(void *pArg)
+{
+	XFORK_JOIN_T *pForkJoin = (XFORK_JOIN_T*)pArg;
+	return pForkJoin->nDoneNum == pForkJoin->nTaskNum;
+}
+
+/* Run the unclaimed tasks of a fork-join, and wake up the forking thread after them. */
+static void XRunForkTasks(XFORK_JOIN_T *pForkJoin)
+{
+	XFORK_TASKS_DONE_T Done;
+	int nIndex;
+
+	Done.pForkJoin = pForkJoin;
+	Done.nNum = 0;
+	while ((nIndex = XAtomicFetchAdd(&pForkJoin->nNextTask, 1)) < pForkJoin->nTaskNum)
+	{
+		(*pForkJoin->pfnTask)(pForkJoin->pParam, nIndex);
+		Done.nNum++;
+	}
+	if (0==Done.nNum)
+		return;
+	XSignalEvent(&pForkJoin->pSync->Done, &pForkJoin->pSync->Mutex, XAddDoneTasks, &Done);
+}
+
+static void XReleaseForkJoin(XFORK_JOIN_T *pForkJoin)
+{
+	BOOL bFree;
+
+	XMutexLock(&pForkJoin->pSync->Mutex);
+	bFree = (0 == --pForkJoin->nRefNum);
+	XMutexUnlock(&pForkJoin->pSync->Mutex);
+	if (!bFree)
+		return;
+	free(pForkJoin->pHelpers);
+	free(pForkJoin);
+}
+
+/* Handle a batch of mail of a running mailbox, and then put it back on the run queue if more mail has come. */
+static void XRunMailbox(XMAILBOX_T *pMailbox)
+{
+	XMAIL_T *pBatch, *pMail;
+	int nNum = 0;
+	BOOL bReady;
+
+	if (pMailbox->pForkJoin)
+	{
+		XFORK_JOIN_T *pForkJoin = pMailbox->pForkJoin;
+		XRunForkTasks(pForkJoin);
+		XReleaseForkJoin(pForkJoin);
+		return;
+	}
+
+	XMutexLock(&pMailbox->Mutex);
+	pMailbox->nState = XMAILBOX_RUNNING;
+	pBatch = pMail = pMailbox->pMailHead;
+	while (pMail && ++nNum < SME_EXECUTOR_BATCH_SIZE)
+		pMail = pMail->pNext;
+	if (pMail)
+	{
+		pMailbox->pMailHead = pMail->pNext;
+		pMail->pNext = NULL;
+	} else
+		pMailbox->pMailHead = NULL;
+	if (NULL==pMailbox->pMailHead)
+		pMailbox->pMailTail = NULL;
+	XMutexUnlock(&pMailbox->Mutex);
+
+	while (pBatch)
+	{
+		pMail = pBatch;
+		pBatch = pBatch->pNext;
+		XHandleMail(pMailbox, pMail);
+		XFreeMail(pMail);
+	}
+
+	XMutexLock(&pMailbox->Mutex);
+	bReady = (NULL!=pMailbox->pMailHead);
+	pMailbox->nState = bReady ? XMAILBOX_READY : XMAILBOX_IDLE;
+	XMutexUnlock(&pMailbox->Mutex);
+
+	if (bReady)
+		XPushReadyMailbox(pMailbox->pExecutor, pMailbox);
+}
+
+/* Thread-safe actions and conditions on the worker counts, which the creating or destroying thread waits for. */
+static int XCountStartedWorker(void *pArg)
+{
+	((XEXECUTOR_T*)pArg)->nStartedNum++;
+	return 0;
+}
+
+static int XCountStoppedWorker(void *pArg)
+{
+	((XEXECUTOR_T*)pArg)->nStoppedNum++;
+	return 0;
+}
+
+typedef struct tagXWORKER_COUNT_WAIT_T
+{
+	const int *pCount;
+	int nNum;
+	BOOL bReached;
+} XWORKER_COUNT_WAIT_T;
+
+static BOOL XIsWorkerCountReached(void *pArg)
+{
+	XWORKER_COUNT_WAIT_T *pWait = (XWORKER_COUNT_WAIT_T*)pArg;
+	return *(pWait->pCount) >= pWait->nNum;
+}
+
+static int XCheckWorkerCount(void *pArg)
+{
+	((XWORKER_COUNT_WAIT_T*)pArg)->bReached = XIsWorkerCountReached(pArg);
+	return 0;
+}
+
+/* Wait on the state event until a worker count reaches nNum. The calling thread should have created the state event. */
+static void XWaitForWorkerCount(XEXECUTOR_T *pExecutor, const int *pCount, int nNum)
+{
+	XWORKER_COUNT_WAIT_T Wait;
+
+	Wait.pCount = pCount;
+	Wait.nNum = nNum;
+	Wait.bReached = FALSE;
+	XMutexLock(&pExecutor->Mutex);
+	Wait.bReached = XIsWorkerCountReached(&Wait);
+	XMutexUnlock(&pExecutor->Mutex);
+	while (!Wait.bReached)
+		XWaitForEvent(&pExecutor->StateEvent, &pExecutor->Mutex, XIsWorkerCountReached, &Wait, XCheckWorkerCount, &Wait);
+}
+
+#ifdef SME_WIN32
+	static unsigned __stdcall XExecutorWorkerProc(void *Param)
+#else
+	static void* XExecutorWorkerProc(void *Param)
+#endif
+{
+	XEXECUTOR_WORKER_T *pWorker = (XEXECUTOR_WORKER_T*)Param;
+	XEXECUTOR_T *pExecutor = pWorker->pExecutor;
+	XMAILBOX_T *pMailbox;
+
+	g_pCurrWorker = pWorker;
+	SmeInitEngine(&(pWorker->ThreadContext));
+	XCreateEvent(&pWorker->Wakeup);
+	XSignalEvent(&pExecutor->StateEvent, &pExecutor->Mutex, XCountStartedWorker, pExecutor);
+
+	while (NULL != (pMailbox = XTakeReadyMailbox(pWorker)))
+		XRunMailbox(pMailbox);
+
+	XFreeThreadContext(&(pWorker->ThreadContext));
+	g_pCurrWorker = NULL;
+	/* The executor may be freed as soon as it is signaled. */
+	XSignalEvent(&pExecutor->StateEvent, &pExecutor->Mutex, XCountStoppedWorker, pExecutor);
+	return 0;
+}
+
+XEXECUTOR_T* XCreateExecutor(int nWorkerNum)
+{
+	XEXECUTOR_T *pExecutor;
+	int i;
+
+	if (nWorkerNum <= 0)
+	{
+#ifdef SME_WIN32
+		SYSTEM_INFO SysInfo;
+		GetSystemInfo(&SysInfo);
+		nWorkerNum = (int)SysInfo.dwNumberOfProcessors;
+#else
+		nWorkerNum = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	}
+	if (nWorkerNum <= 0)
+		nWorkerNum = 1;
+
+	pExecutor = (XEXECUTOR_T*)calloc(1, sizeof(XEXECUTOR_T));
+	if (NULL==pExecutor)
+		return NULL;
+	pExecutor->pWorkers = (XEXECUTOR_WORKER_T*)calloc(nWorkerNum, sizeof(XEXECUTOR_WORKER_T));
+	if (NULL==pExecutor->pWorkers)
+	{
+		free(pExecutor);
+		return NULL;
+	}
+	XCreateMutex(&pExecutor->Mutex);
+	XCreateEvent(&pExecutor->StateEvent);
+	/* All the run queues are ready before any worker starts, since a worker steals from all of them. */
+	pExecutor->nWorkerNum = nWorkerNum;
+	for (i=0; i<nWorkerNum; i++)
+	{
+		pExecutor->pWorkers[i].pExecutor = pExecutor;
+		pExecutor->pWorkers[i].nSeed = (unsigned int)i+1;
+		XCreateMutex(&(pExecutor->pWorkers[i].Mutex));
+	}
+
+	pExecutor->pfnOldPostAppExtEvent = SmeSetAppExtEventProc(XPostAppExtEvent);
+
+	for (i=0; i<nWorkerNum; i++)
+	{
+#ifdef SME_LINUX
+		/* Like the shard threads, so that the workers run without the thread support of the cross-platform layer. */
+		if (0!=pthread_create(&(pExecutor->pWorkers[i].Thread), NULL, XExecutorWorkerProc, &(pExecutor->pWorkers[i])))
+			break;
+#else
+		/* No thread is started without the thread support of the cross-platform layer. */
+		if (0!=XCreateThread(XExecutorWorkerProc, &(pExecutor->pWorkers[i]), &(pExecutor->pWorkers[i].Thread))
+			|| 0==pExecutor->pWorkers[i].Thread)
+			break;
+#endif
+	}
+	pExecutor->nCreatedNum = i;
+
+	/* The workers create their wake-up events when they start, which must be done before they are woken up. */
+	XWaitForWorkerCount(pExecutor, &pExecutor->nStartedNum, pExecutor->nCreatedNum);
+	if (pExecutor->nCreatedNum < nWorkerNum)
+	{
+		/* Stop the started workers only. */
+		XDestroyExecutor(pExecutor);
+		return NULL;
+	}
+	return pExecutor;
+}
+
+int XDestroyExecutor(XEXECUTOR_T *pExecutor)
+{
+	XMAILBOX_T *pMailbox;
+	XMAIL_T *pMail;
+	int i;
+
+	if (NULL==pExecutor)
+		return -1;
+
+	if (g_pForkJoinExecutor == pExecutor)
+		XSetForkJoinExecutor(NULL);
+	SmeSetAppExtEventProc(pExecutor->pfnOldPostAppExtEvent);
+
+	/* The destroying thread waits on the state event for the workers to stop, so it creates the event again. 
+	No worker signals the event between its start and stop. */
+	XDestroyEvent(&pExecutor->StateEvent);
+	XCreateEvent(&pExecutor->StateEvent);
+
+	XAtomicStoreRelease(&pExecutor->bExit, TRUE);
+	XMemoryBarrier();
+	for (i=0; i<pExecutor->nCreatedNum; i++)
+		XSignalEvent(&(pExecutor->pWorkers[i].Wakeup), &(pExecutor->pWorkers[i].Mutex), XWakeWorker, &(pExecutor->pWorkers[i]));
+	XWaitForWorkerCount(pExecutor, &pExecutor->nStoppedNum, pExecutor->nCreatedNum);
+
+	for (i=0; i<pExecutor->nWorkerNum; i++)
+	{
+		if (i < pExecutor->nCreatedNum)
+		{
+#ifdef SME_LINUX
+			pthread_join(pExecutor->pWorkers[i].Thread, NULL);
+#endif
+			XDestroyEvent(&(pExecutor->pWorkers[i].Wakeup));
+			XCLOSE_HANDLE(pExecutor->pWorkers[i].Thread);
+		}
+		XDestroyMutex(&(pExecutor->pWorkers[i].Mutex));
+	}
+
+	while (NULL != (pMailbox = pExecutor->pMailboxes))
+	{
+		pExecutor->pMailboxes = pMailbox->pNextMailbox;
+		while (NULL != (pMail = pMailbox->pMailHead))
+		{
+			pMailbox->pMailHead = pMail->pNext;
+			XFreeMail(pMail);
+		}
+		pMailbox->pApp->pMailbox = NULL;
+		XDestroyMutex(&pMailbox->Mutex);
+		free(pMailbox);
+	}
+
+	XDestroyEvent(&pExecutor->StateEvent);
+	XDestroyMutex(&pExecutor->Mutex);
+	free(pExecutor->pWorkers);
+	free(pExecutor);
+	return 0;
+}
+
+BOOL XExecutorAddApp(XEXECUTOR_T *pExecutor, SME_APP_T *pApp)
+{
+	XMAILBOX_T *pMailbox;
+	XMAIL_T *pMail;
+
+	if (NULL==pExecutor || NULL==pApp || NULL!=pApp->pMailbox || SME_IS_ACTIVATED(pApp))
+		return FALSE;
+
+	pMailbox = (XMAILBOX_T*)calloc(1, sizeof(XMAILBOX_T));
+	pMail = (XMAIL_T*)calloc(1, sizeof(XMAIL_T));
+	if (NULL==pMailbox || NULL==pMail)
+	{
+		free(pMailbox);
+		free(pMail);
+		return FALSE;
+	}
+	pMailbox->pApp = pApp;
+	pMailbox->pExecutor = pExecutor;
+	XCreateMutex(&pMailbox->Mutex);
+
+	XMutexLock(&pExecutor->Mutex);
+	pMailbox->pNextMailbox = pExecutor->pMailboxes;
+	pExecutor->pMailboxes = pMailbox;
+	XMutexUnlock(&pExecutor->Mutex);
+
+	pApp->pMailbox = pMailbox;
+	pMail->nKind = XMAIL_ACTIVATE;
+	return XPostMail(pMailbox, pMail);
+}
+
+BOOL XExecutorRemoveApp(SME_APP_T *pApp)
+{
+	XMAIL_T *pMail;
+
+	if (NULL==pApp || NULL==pApp->pMailbox)
+		return FALSE;
+
+	pMail = (XMAIL_T*)calloc(1, sizeof(XMAIL_T));
+	if (NULL==pMail)
+		return FALSE;
+	pMail->nKind = XMAIL_DEACTIVATE;
+	return XPostMail((XMAILBOX_T*)pApp->pMailbox, pMail);
+}
+
+int XPostAppExtEvent(SME_APP_T *pDestApp, const SME_EXT_EVENT_DESC *pEvent)
+{
+	XMAIL_T *pMail;
+
+	if (NULL==pDestApp || NULL==pDestApp->pMailbox || NULL==pEvent || 0==pEvent->nMsgID)
+		return -1;
+
+	pMail = (XMAIL_T*)calloc(1, sizeof(XMAIL_T));
+	if (NULL==pMail)
+		return -1;
+	pMail->nKind = XMAIL_EVENT;
+	memcpy(&(pMail->Event), pEvent, sizeof(SME_EXT_EVENT_DESC));
+	if (SME_EVENT_DATA_FORMAT_PTR == pEvent->nDataFormat)
+	{
+		pMail->Event.Data.Ptr.pData = NULL;
+		pMail->Event.Data.Ptr.nSize = 0;
+		if (pEvent->Data.Ptr.pData!=NULL && pEvent->Data.Ptr.nSize>0)
+		{
+			pMail->Event.Data.Ptr.pData = malloc(pEvent->Data.Ptr.nSize);
+			if (NULL==pMail->Event.Data.Ptr.pData)
+			{
+				free(pMail);
+				return -1;
+			}
+			memcpy(pMail->Event.Data.Ptr.pData, pEvent->Data.Ptr.pData, pEvent->Data.Ptr.nSize);
+			pMail->Event.Data.Ptr.nSize = pEvent->Data.Ptr.nSize;
+		}
+	}
+	return XPostMail((XMAILBOX_T*)pDestApp->pMailbox, pMail) ? 0 : -1;
+}
+
+void XSetForkJoinExecutor(XEXECUTOR_T *pExecutor)
+{
+	g_pForkJoinExecutor = pExecutor;
+	SmeSetForkJoinProc(pExecutor ? XExecutorForkJoin : NULL);
+}
+
+/* Get the fork-join sync of the calling thread. It is created by the thread, which waits on its event. */
+static XFORK_JOIN_SYNC_T* XGetForkJoinSync(void)
+{
+	XFORK_JOIN_SYNC_T *pSync = g_pForkJoinSync;
+	if (NULL==pSync)
+	{
+		pSync = (XFORK_JOIN_SYNC_T*)calloc(1, sizeof(XFORK_JOIN_SYNC_T));
+		if (NULL==pSync)
+			return NULL;
+		XCreateMutex(&pSync->Mutex);
+		XCreateEvent(&pSync->Done);
+		g_pForkJoinSync = pSync;
+	}
+	return pSync;
+}
+
+void XExecutorForkJoin(SME_FORK_TASK_PROC_T pfnTask, void *pParam, int nTaskNum)
+{
+	XEXECUTOR_T *pExecutor = g_pForkJoinExecutor;
+	XFORK_JOIN_SYNC_T *pSync;
+	XFORK_JOIN_T *pForkJoin = NULL;
+	int nHelperNum, i;
+
+	if (NULL==pfnTask || nTaskNum<=0)
+		return;
+
+	/* The forking thread runs a task itself, so a helper is needed for each of the other tasks, up to a worker each. */
+	nHelperNum = nTaskNum-1;
+	if (pExecutor && nHelperNum > pExecutor->nWorkerNum)
+		nHelperNum = pExecutor->nWorkerNum;
+	pSync = (pExecutor && nHelperNum>0) ? XGetForkJoinSync() : NULL;
+	if (pSync)
+		pForkJoin = (XFORK_JOIN_T*)calloc(1, sizeof(XFORK_JOIN_T));
+	if (pForkJoin)
+		pForkJoin->pHelpers = (XMAILBOX_T*)calloc(nHelperNum, sizeof(XMAILBOX_T));
+	if (NULL==pForkJoin || NULL==pForkJoin->pHelpers)
+	{
+		free(pForkJoin);
+		for (i=0; i<nTaskNum; i++)
+			(*pfnTask)(pParam, i);
+		return;
+	}
+
+	pForkJoin->pfnTask = pfnTask;
+	pForkJoin->pParam = pParam;
+	pForkJoin->nTaskNum = nTaskNum;
+	pForkJoin->pSync = pSync;
+	pForkJoin->nRefNum = nHelperNum+1;
+	for (i=0; i<nHelperNum; i++)
+	{
+		pForkJoin->pHelpers[i].pExecutor = pExecutor;
+		pForkJoin->pHelpers[i].nState = XMAILBOX_READY;
+		pForkJoin->pHelpers[i].pForkJoin = pForkJoin;
+		XPushReadyMailbox(pExecutor, &(pForkJoin->pHelpers[i]));
+	}
+
+	XRunForkTasks(pForkJoin);
+	while (TRUE)
+	{
+		BOOL bDone;
+		XMutexLock(&pSync->Mutex);
+		bDone = XIsForkJoinDone(pForkJoin);
+		XMutexUnlock(&pSync->Mutex);
+		if (bDone)
+			break;
+		XWaitForEvent(&pSync->Done, &pSync->Mutex, XIsForkJoinDone, pForkJoin, NULL, NULL);
+	}
+	XReleaseForkJoin(pForkJoin);
+}
@@ -38,15 +38,85 @@ The Mutex for a thread pool is to synchronize the message pool access between th
 
 */
 #define MSG_BUF_SIZE  100
+
+/* Pending timer events are indexed by a small chained hash on the sequence number, so that a duplicate timer event 
+is rejected without scanning the whole queue. Links are MsgBuf indexes plus 1, and 0 stands for the end of a chain. */
+#define MSG_TIMER_HASH_SIZE  64 /* Power of 2 */
+#define MSG_TIMER_HASH(_nSeqNum) ((_nSeqNum) & (MSG_TIMER_HASH_SIZE-1))
+#define MSG_IS_TIMER(_nMsgID) (SME_EVENT_TIMER==(_nMsgID) || SME_EVENT_STATE_TIMER==(_nMsgID))
+
+/* Events above the normal priority are kept in a ring per priority class, which is received from before the 
+normal ones. Timer events are always normal. */
+#define MSG_PRIO_BUF_SIZE  SME_EXT_EVENT_PRIORITY_BUF_SIZE
+#define MSG_PRIORITY(_pMsg) (MSG_IS_TIMER((_pMsg)->nMsgID) ? SME_EVENT_PRIORITY_NORMAL \
+	: (SME_EVENT_PRIORITY_OF((_pMsg)->nCategory) < SME_EVENT_PRIORITY_NUM ? SME_EVENT_PRIORITY_OF((_pMsg)->nCategory) : SME_EVENT_PRIORITY_NUM-1))
+
+typedef struct tagEXTMSGRING
+{
+	int nHdr;
+	int nRear;
+	X_EXT_MSG_T MsgBuf[MSG_PRIO_BUF_SIZE];
+} X_EXT_MSG_RING_T;
+
+#if defined(SME_LINUX) && defined(XTHREAD_LOCAL) && SME_MAX_EXT_EVENT_LANES>0
+	#define MSG_LANE_SUPPORT
+#endif
+
+#ifdef MSG_LANE_SUPPORT
+/* Each producer thread gets a single-producer/single-consumer ring (lane) into the pool on its first post, so that 
+producers do not contend with each other and the events from a producer are received in the order they are posted.
+nRear is written by the producer only and nHdr by the receiving thread only. Both are free-running counters. 
+Once the producer thread has exited, another producer takes its lane over, and goes on from its nRear. */
+#define MSG_LANE_SIZE  SME_EXT_EVENT_LANE_SIZE
+#define MSG_LANE_IDX(_n) ((_n) & (MSG_LANE_SIZE-1))
+
+/* A producer is identified by a record kept in its thread-local storage, because the thread ID is not 
+unique when the thread functions are provided by the embedder. A thread-specific key marks the record exited 
+when the thread exits. The record lives as long as the thread or a lane refers to it. */
+typedef struct tagEXTMSGPRODUCER
+{
+	unsigned int bExited;
+	unsigned int nRefNum; /* The producer thread and its lanes. */
+} X_EXT_MSG_PRODUCER_T;
+
+static XTHREAD_LOCAL X_EXT_MSG_PRODUCER_T *g_pProducer = NULL;
+static pthread_key_t g_ProducerKey;
+static pthread_once_t g_ProducerKeyOnce = PTHREAD_ONCE_INIT;
+
+typedef struct tagEXTMSGLANE
+{
+	X_EXT_MSG_PRODUCER_T *pProducer;
+	unsigned int nRear;
+	X_EXT_MSG_T MsgBuf[MSG_LANE_SIZE];
+	unsigned int nHdr;
+} X_EXT_MSG_LANE_T;
+#endif
+
 typedef struct tagEXTMSGPOOL
 {
 	int nMsgBufHdr;
 	int nMsgBufRear;
 	X_EXT_MSG_T MsgBuf[MSG_BUF_SIZE];
+	int TimerHash[MSG_TIMER_HASH_SIZE]; /* The first pending timer event in each hash chain. */
+	int TimerNext[MSG_BUF_SIZE]; /* The next pending timer event in the same hash chain. */
 	XEVENT EventToThread;
 	XMUTEX MutexForPool;
+	XWAIT_STRATEGY_T WaitStrategy; /* How the receiving thread waits on EventToThread. Blocking by default. */
+	X_EXT_MSG_RING_T PrioRings[SME_EVENT_PRIORITY_NUM-1]; /* The rings of SME_EVENT_PRIORITY_HIGH and above. */
+	unsigned int PrioQuota[SME_EVENT_PRIORITY_NUM]; /* Anti-starvation quota of each priority class. 0 for none. */
+	unsigned int PrioServed[SME_EVENT_PRIORITY_NUM]; /* Events received in a row from each priority class. */
+#ifdef MSG_LANE_SUPPORT
+	unsigned int nLaneNum; /* The number of registered lanes. Lanes are registered under MutexForPool. */
+	unsigned int nNextLane; /* The queue to receive from first. Index nLaneNum stands for MsgBuf. */
+	unsigned int bWaiting; /* The receiving thread is about to wait on EventToThread. */
+	X_EXT_MSG_LANE_T Lanes[SME_MAX_EXT_EVENT_LANES];
+#endif
 } X_EXT_MSG_POOL_T;
 
+#ifdef MSG_LANE_SUPPORT
+static void XReleaseLanes(X_EXT_MSG_POOL_T *pMsgPool);
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////////////////
 //   nMsgBufHdr  (Get from the head) <============== (Append to the rear) nMsgBufRear
 ///////////////////////////////////////////////////////////////////////////////////////////
@@ -78,6 +148,9 @@ BOOL XFreeMsgBuf()
 
 	if (NULL!=pThreadContext && NULL!=pThreadContext->pExtEventPool)
 	{
+#ifdef MSG_LANE_SUPPORT
+		XReleaseLanes((X_EXT_MSG_POOL_T*)(pThreadContext->pExtEventPool));
+#endif
 		free(pThreadContext->pExtEventPool);
 		pThreadContext->pExtEventPool= NULL;
 		return TRUE;
@@ -86,6 +159,81 @@ BOOL XFreeMsgBuf()
 	return FALSE;
 }
 
+/* Set how the thread waits for external events: busy-poll for nSpinNs nano-seconds with up to nMaxPause pause instructions 
+between polls, yield nYieldNum times, and then block. All zero restores the blocking wait. 
+Call it at the thread itself or before the thread starts to get external events. */
+BOOL XSetExtEventWaitStrategy(SME_THREAD_CONTEXT_T* pThreadContext, unsigned int nSpinNs, unsigned int nYieldNum, unsigned int nMaxPause)
+{
+	X_EXT_MSG_POOL_T *pMsgPool;
+	if (NULL==pThreadContext || NULL==pThreadContext->pExtEventPool)
+		return FALSE;
+
+	pMsgPool = (X_EXT_MSG_POOL_T*)(pThreadContext->pExtEventPool);
+	pMsgPool->WaitStrategy.nSpinNs = nSpinNs;
+	pMsgPool->WaitStrategy.nYieldNum = nYieldNum;
+	pMsgPool->WaitStrategy.nMaxPause = nMaxPause;
+	return TRUE;
+}
+
+typedef struct tagEXTMSGQUOTA
+{
+	X_EXT_MSG_POOL_T *pMsgPool;
+	int nPriority;
+	unsigned int nQuota;
+} X_EXT_MSG_QUOTA_T;
+
+/* Thread-safe action to set the quota of a priority class. */
+static int XSetPrioQuota(void *pArg)
+{
+	X_EXT_MSG_QUOTA_T *pQuota = (X_EXT_MSG_QUOTA_T*)pArg;
+	pQuota->pMsgPool->PrioQuota[pQuota->nPriority] = pQuota->nQuota;
+	pQuota->pMsgPool->PrioServed[pQuota->nPriority] = 0;
+	return 0;
+}
+
+/* Set the anti-starvation quota of a priority class above normal: after nQuota events of the class are received in a row 
+while lower priority events are pending, one lower priority event is received. 0 (default) receives strictly by priority. */
+BOOL XSetExtEventPriorityQuota(SME_THREAD_CONTEXT_T* pThreadContext, SME_EVENT_PRIORITY_T nPriority, unsigned int nQuota)
+{
+	X_EXT_MSG_QUOTA_T Quota;
+	if (NULL==pThreadContext || NULL==pThreadContext->pExtEventPool 
+		|| nPriority<=SME_EVENT_PRIORITY_NORMAL || nPriority>=SME_EVENT_PRIORITY_NUM)
+		return FALSE;
+
+	/* Set it under the pool mutex. The receiving thread may wake up for nothing, and waits again. */
+	Quota.pMsgPool = (X_EXT_MSG_POOL_T*)(pThreadContext->pExtEventPool);
+	Quota.nPriority = nPriority;
+	Quota.nQuota = nQuota;
+	XSignalEvent(&(Quota.pMsgPool->EventToThread),&(Quota.pMsgPool->MutexForPool),XSetPrioQuota,&Quota);
+	return TRUE;
+}
+
+/* Is any event of the priority classes from SME_EVENT_PRIORITY_HIGH to nBelow (exclusive) pending? */
+static BOOL XIsPrioMsgAvailable(X_EXT_MSG_POOL_T *pMsgPool, int nBelow)
+{
+	int i;
+	for (i=SME_EVENT_PRIORITY_HIGH; i<nBelow; i++)
+	{
+		if (pMsgPool->PrioRings[i-1].nHdr != pMsgPool->PrioRings[i-1].nRear)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* Is any normal event pending in the lanes or the shared queue? */
+static BOOL XIsNormalMsgAvailable(X_EXT_MSG_POOL_T *pMsgPool)
+{
+#ifdef MSG_LANE_SUPPORT
+	unsigned int i;
+	for (i=0; i<pMsgPool->nLaneNum; i++)
+	{
+		if (XAtomicLoadAcquire(&(pMsgPool->Lanes[i].nRear)) != pMsgPool->Lanes[i].nHdr)
+			return TRUE;
+	}
+#endif
+	return (pMsgPool->nMsgBufHdr!=pMsgPool->nMsgBufRear);
+}
+
 /* Is message available at the current thread event pool?*/
 static BOOL XIsMsgAvailable(void *pArg)
 {
@@ -98,67 +246,374 @@ static BOOL XIsMsgAvailable(void *pArg)
 
 	pMsgPool = (X_EXT_MSG_POOL_T*)p->pExtEventPool;
 
-	if (pMsgPool->nMsgBufHdr==pMsgPool->nMsgBufRear)
-		return FALSE; // empty buffer.
+#ifdef MSG_LANE_SUPPORT
+	/* Announce the wait before checking the lanes. Pairs with the barrier in XWakeUpReceiver(): either 
+	this check sees a new event, or the producer sees bWaiting set and signals under the mutex. */
+	XAtomicStoreRelease(&(pMsgPool->bWaiting), 1);
+	XMemoryBarrier();
+#endif
 
-	return TRUE;
+	return XIsPrioMsgAvailable(pMsgPool, SME_EVENT_PRIORITY_NUM) || XIsNormalMsgAvailable(pMsgPool);
 }
 
+/* Is any event pending at the given event pool? It is polled by the receiving thread without the pool mutex, 
+so the indices written by the producers are read lock-free. */
+static BOOL XIsMsgPending(void *pArg)
+{
+	X_EXT_MSG_POOL_T *pMsgPool = (X_EXT_MSG_POOL_T*)pArg;
+	int i;
+
+	for (i=SME_EVENT_PRIORITY_HIGH; i<SME_EVENT_PRIORITY_NUM; i++)
+	{
+		if (XAtomicLoadAcquire(&(pMsgPool->PrioRings[i-1].nRear)) != pMsgPool->PrioRings[i-1].nHdr)
+			return TRUE;
+	}
+#ifdef MSG_LANE_SUPPORT
+	{
+		unsigned int j, nNum = XAtomicLoadAcquire(&(pMsgPool->nLaneNum));
+		for (j=0; j<nNum; j++)
+		{
+			if (XAtomicLoadAcquire(&(pMsgPool->Lanes[j].nRear)) != pMsgPool->Lanes[j].nHdr)
+				return TRUE;
+		}
+	}
+#endif
+	return (XAtomicLoadAcquire(&(pMsgPool->nMsgBufRear)) != pMsgPool->nMsgBufHdr);
+}
+
+
+/* Is a timer event with the same event ID and sequence number pending in the queue? */
+static BOOL XIsTimerMsgPending(X_EXT_MSG_POOL_T *pMsgPool, X_EXT_MSG_T *pMsg)
+{
+	int nLink = pMsgPool->TimerHash[MSG_TIMER_HASH(pMsg->nSequenceNum)];
+	while (0!=nLink)
+	{
+		if (pMsgPool->MsgBuf[nLink-1].nMsgID == pMsg->nMsgID
+			&& pMsgPool->MsgBuf[nLink-1].nSequenceNum == pMsg->nSequenceNum)
+			return TRUE;
+		nLink = pMsgPool->TimerNext[nLink-1];
+	}
+	return FALSE;
+}
+
+/* Remove the timer event at the given buffer index from its hash chain. */
+static void XUnlinkTimerMsg(X_EXT_MSG_POOL_T *pMsgPool, int nIdx)
+{
+	int *pLink = &(pMsgPool->TimerHash[MSG_TIMER_HASH(pMsgPool->MsgBuf[nIdx].nSequenceNum)]);
+	while (0!=*pLink)
+	{
+		if (*pLink == nIdx+1)
+		{
+			*pLink = pMsgPool->TimerNext[nIdx];
+			pMsgPool->TimerNext[nIdx] = 0;
+			return;
+		}
+		pLink = &(pMsgPool->TimerNext[*pLink-1]);
+	}
+}
+
+/* Append an external event above the normal priority to the ring of its priority class. */
+static void XAppendMsgToPrioRing(X_EXT_MSG_RING_T *pRing, X_EXT_MSG_T *pMsg)
+{
+	if (((pRing->nRear+1) % MSG_PRIO_BUF_SIZE) == pRing->nHdr)
+	{
+		pMsg->nMsgID = 0;
+		return; // ring full.
+	}
+	memcpy(&(pRing->MsgBuf[pRing->nRear]),pMsg,sizeof(X_EXT_MSG_T));
+	pRing->nRear = (pRing->nRear+1)%MSG_PRIO_BUF_SIZE;
+}
 
 /* Thread-safe action to append an external event to the rear of the queue at the destination thread.
- Timer event overflow prevention.
+ Timer event overflow prevention. If the event is not appended, its nMsgID is set to 0.
 */
 static void XAppendMsgToBuf(void *pArg)
 {
 	X_EXT_MSG_T *pMsg = (X_EXT_MSG_T*)pArg;
-	int nHdr;
+	int nRear, nPriority;
 	X_EXT_MSG_POOL_T *pMsgPool;
 	if (NULL==pMsg || NULL==pMsg->pDestThread || NULL==pMsg->pDestThread->pExtEventPool)
 		return;
 
 	pMsgPool = (X_EXT_MSG_POOL_T*)(pMsg->pDestThread->pExtEventPool);
+
+	nPriority = MSG_PRIORITY(pMsg);
+	if (nPriority > SME_EVENT_PRIORITY_NORMAL)
+	{
+		XAppendMsgToPrioRing(&(pMsgPool->PrioRings[nPriority-1]), pMsg);
+		return;
+	}
 	
 	if (((pMsgPool->nMsgBufRear+1) % MSG_BUF_SIZE) == pMsgPool->nMsgBufHdr)
+	{
+		pMsg->nMsgID = 0;
 		return; // buffer full.
+	}
 
-	// Prevent duplicate SME_EVENT_TIMER event triggered by a timer in the queue.
-	nHdr = pMsgPool->nMsgBufHdr;
-	if (SME_EVENT_TIMER == pMsg->nMsgID)
+	// Prevent duplicate SME_EVENT_TIMER/SME_EVENT_STATE_TIMER event triggered by a timer in the queue.
+	if (MSG_IS_TIMER(pMsg->nMsgID) && XIsTimerMsgPending(pMsgPool, pMsg))
 	{
-		while (nHdr != pMsgPool->nMsgBufRear)
+		pMsg->nMsgID = 0;
+		return;
+	}
+
+	nRear = pMsgPool->nMsgBufRear;
+	memcpy(&(pMsgPool->MsgBuf[nRear]),pMsg,sizeof(X_EXT_MSG_T));
+
+	if (MSG_IS_TIMER(pMsg->nMsgID))
+	{
+		int nBucket = MSG_TIMER_HASH(pMsg->nSequenceNum);
+		pMsgPool->TimerNext[nRear] = pMsgPool->TimerHash[nBucket];
+		pMsgPool->TimerHash[nBucket] = nRear+1;
+	}
+
+	pMsgPool->nMsgBufRear = (nRear+1)%MSG_BUF_SIZE;
+}
+
+/* Remove an external event from the head of the shared queue. */
+static BOOL XGetMsgFromQueue(X_EXT_MSG_POOL_T *pMsgPool, X_EXT_MSG_T *pMsg)
+{
+	if (pMsgPool->nMsgBufHdr==pMsgPool->nMsgBufRear)
+		return FALSE; // empty buffer.
+
+	memcpy(pMsg,&(pMsgPool->MsgBuf[pMsgPool->nMsgBufHdr]),sizeof(X_EXT_MSG_T));
+
+	if (MSG_IS_TIMER(pMsg->nMsgID))
+		XUnlinkTimerMsg(pMsgPool, pMsgPool->nMsgBufHdr);
+
+	pMsgPool->MsgBuf[pMsgPool->nMsgBufHdr].nMsgID =0;
+
+	pMsgPool->nMsgBufHdr = (pMsgPool->nMsgBufHdr+1)%MSG_BUF_SIZE;
+	return TRUE;
+}
+
+#ifdef MSG_LANE_SUPPORT
+static void XReleaseProducer(X_EXT_MSG_PRODUCER_T *pProducer)
+{
+	XMemoryBarrier();
+	if (1 == XAtomicFetchAdd(&(pProducer->nRefNum), (unsigned int)-1))
+		free(pProducer);
+}
+
+/* The destructor of the thread-specific key, called when a producer thread exits. */
+static void XOnProducerExit(void *pArg)
+{
+	X_EXT_MSG_PRODUCER_T *pProducer = (X_EXT_MSG_PRODUCER_T*)pArg;
+	g_pProducer = NULL;
+	XAtomicStoreRelease(&(pProducer->bExited), 1);
+	XReleaseProducer(pProducer);
+}
+
+static void XCreateProducerKey(void)
+{
+	pthread_key_create(&g_ProducerKey, XOnProducerExit);
+}
+
+/* Get the producer record of the current thread. Return NULL if out of memory. */
+static X_EXT_MSG_PRODUCER_T* XGetProducer(void)
+{
+	if (NULL==g_pProducer)
+	{
+		pthread_once(&g_ProducerKeyOnce, XCreateProducerKey);
+		g_pProducer = (X_EXT_MSG_PRODUCER_T*)calloc(1, sizeof(X_EXT_MSG_PRODUCER_T));
+		if (NULL==g_pProducer)
+			return NULL;
+		g_pProducer->nRefNum = 1;
+		pthread_setspecific(g_ProducerKey, g_pProducer);
+	}
+	return g_pProducer;
+}
+
+typedef struct tagEXTMSGLANEREG
+{
+	X_EXT_MSG_POOL_T *pMsgPool;
+	X_EXT_MSG_PRODUCER_T *pProducer;
+	X_EXT_MSG_LANE_T *pLane; /* The registered lane, or NULL if all lanes are taken. */
+} X_EXT_MSG_LANE_REG_T;
+
+/* Thread-safe action to register a lane for a producer: a new lane, or the lane of an exited producer. */
+static int XRegisterLane(void *pArg)
+{
+	X_EXT_MSG_LANE_REG_T *pReg = (X_EXT_MSG_LANE_REG_T*)pArg;
+	X_EXT_MSG_POOL_T *pMsgPool = pReg->pMsgPool;
+	unsigned int i, nNum = pMsgPool->nLaneNum;
+
+	if (nNum < SME_MAX_EXT_EVENT_LANES)
+	{
+		pReg->pLane = &(pMsgPool->Lanes[nNum]);
+		pReg->pLane->nHdr = pReg->pLane->nRear = 0;
+	} else if (pMsgPool->nMsgBufHdr == pMsgPool->nMsgBufRear)
+	{
+		/* The producer may have posted to the shared queue while all lanes were taken. Its events there are received 
+		before it moves to a lane, since the queue is empty. Take over a drained lane of an exited producer. */
+		for (i=0; i<nNum; i++)
 		{
-			if (SME_EVENT_TIMER == pMsgPool->MsgBuf[nHdr].nMsgID
-			&& pMsg->nSequenceNum == pMsgPool->MsgBuf[nHdr].nSequenceNum)
-				return; 
-			nHdr = (nHdr+1) % MSG_BUF_SIZE;
+			if (XAtomicLoadAcquire(&(pMsgPool->Lanes[i].pProducer->bExited))
+				&& XAtomicLoadAcquire(&(pMsgPool->Lanes[i].nHdr)) == pMsgPool->Lanes[i].nRear)
+			{
+				pReg->pLane = &(pMsgPool->Lanes[i]);
+				XReleaseProducer(pReg->pLane->pProducer);
+				break;
+			}
 		}
 	}
+	if (NULL==pReg->pLane)
+		return 0;
+	XAtomicFetchAdd(&(pReg->pProducer->nRefNum), 1);
+	pReg->pLane->pProducer = pReg->pProducer;
+	if (nNum < SME_MAX_EXT_EVENT_LANES)
+		XAtomicStoreRelease(&(pMsgPool->nLaneNum), nNum+1);
+	return 0;
+}
+
+/* Release the lanes of a pool, which is freed. */
+static void XReleaseLanes(X_EXT_MSG_POOL_T *pMsgPool)
+{
+	unsigned int i;
+	for (i=0; i<pMsgPool->nLaneNum; i++)
+		XReleaseProducer(pMsgPool->Lanes[i].pProducer);
+}
+
+/* Get the lane of the current thread into the pool. Register one on the first post. 
+Return NULL if all lanes are taken, then the shared queue is used. */
+static X_EXT_MSG_LANE_T* XGetProducerLane(X_EXT_MSG_POOL_T *pMsgPool)
+{
+	X_EXT_MSG_LANE_REG_T Reg;
+	X_EXT_MSG_PRODUCER_T *pProducer = XGetProducer();
+	unsigned int i, nNum = XAtomicLoadAcquire(&(pMsgPool->nLaneNum));
+
+	if (NULL==pProducer)
+		return NULL;
+
+	for (i=0; i<nNum; i++)
+	{
+		if (pMsgPool->Lanes[i].pProducer == pProducer)
+			return &(pMsgPool->Lanes[i]);
+	}
 
-	memcpy(&(pMsgPool->MsgBuf[pMsgPool->nMsgBufRear]),pMsg,sizeof(X_EXT_MSG_T));
+	/* Register under the pool mutex. The receiving thread may wake up for nothing, and waits again. */
+	Reg.pMsgPool = pMsgPool;
+	Reg.pProducer = pProducer;
+	Reg.pLane = NULL;
+	XSignalEvent(&(pMsgPool->EventToThread),&(pMsgPool->MutexForPool),XRegisterLane,&Reg);
+	return Reg.pLane;
+}
 
-	pMsgPool->nMsgBufRear = (pMsgPool->nMsgBufRear+1)%MSG_BUF_SIZE;
+/* Append an external event to the lane. It is called by the lane owner only. */
+static BOOL XAppendMsgToLane(X_EXT_MSG_LANE_T *pLane, X_EXT_MSG_T *pMsg)
+{
+	unsigned int nRear = pLane->nRear;
+	if (nRear - XAtomicLoadAcquire(&(pLane->nHdr)) == MSG_LANE_SIZE)
+		return FALSE; // lane full.
+
+	memcpy(&(pLane->MsgBuf[MSG_LANE_IDX(nRear)]), pMsg, sizeof(X_EXT_MSG_T));
+	XAtomicStoreRelease(&(pLane->nRear), nRear+1);
+	return TRUE;
 }
 
-/* Thread-safe action to remove an external event from the current thread event pool.*/
-static void XGetMsgFromBuf(void *pArg)
+/* Wake up the receiving thread after events are appended to a lane, if it is waiting or about to wait. */
+static void XWakeUpReceiver(X_EXT_MSG_POOL_T *pMsgPool)
+{
+	XMemoryBarrier();
+	if (XAtomicLoadAcquire(&(pMsgPool->bWaiting)))
+		XSignalEvent(&(pMsgPool->EventToThread),&(pMsgPool->MutexForPool),NULL,NULL);
+}
+#endif
+
+/* Remove an external event from the highest priority ring which is not empty and has not used up its quota. */
+static BOOL XGetMsgFromPrioRings(X_EXT_MSG_POOL_T *pMsgPool, X_EXT_MSG_T *pMsg)
+{
+	int i;
+	X_EXT_MSG_RING_T *pRing;
+
+	for (i=SME_EVENT_PRIORITY_NUM-1; i>SME_EVENT_PRIORITY_NORMAL; i--)
+	{
+		pRing = &(pMsgPool->PrioRings[i-1]);
+		if (pRing->nHdr==pRing->nRear)
+		{
+			pMsgPool->PrioServed[i] = 0;
+			continue;
+		}
+		if (pMsgPool->PrioQuota[i] && pMsgPool->PrioServed[i] >= pMsgPool->PrioQuota[i]
+			&& (XIsPrioMsgAvailable(pMsgPool, i) || XIsNormalMsgAvailable(pMsgPool)))
+		{
+			pMsgPool->PrioServed[i] = 0; // Let a lower priority event go first.
+			continue;
+		}
+
+		memcpy(pMsg,&(pRing->MsgBuf[pRing->nHdr]),sizeof(X_EXT_MSG_T));
+		pRing->MsgBuf[pRing->nHdr].nMsgID =0;
+		pRing->nHdr = (pRing->nHdr+1)%MSG_PRIO_BUF_SIZE;
+		pMsgPool->PrioServed[i]++;
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/* Thread-safe action to remove an external event from the current thread event pool.
+The priority rings are received from first. Then the lanes and the shared queue are received from round-robin. */
+static int XGetMsgFromBuf(void *pArg)
 {
 	X_EXT_MSG_T *pMsg = (X_EXT_MSG_T*)pArg;
 	SME_THREAD_CONTEXT_T* p = XGetThreadContext();
 	X_EXT_MSG_POOL_T *pMsgPool;
 	if (NULL==pMsg || NULL==p || NULL==p->pExtEventPool)
-		return;
+		return 0;
 
 	pMsgPool = (X_EXT_MSG_POOL_T*)(p->pExtEventPool);
 
-	if (pMsgPool->nMsgBufHdr==pMsgPool->nMsgBufRear)
-		return; // empty buffer.
-
-	memcpy(pMsg,&(pMsgPool->MsgBuf[pMsgPool->nMsgBufHdr]),sizeof(X_EXT_MSG_T));
+#ifdef MSG_LANE_SUPPORT
+	pMsgPool->bWaiting = 0;
+#endif
+	if (XGetMsgFromPrioRings(pMsgPool, pMsg))
+		return 0;
 
-	pMsgPool->MsgBuf[pMsgPool->nMsgBufHdr].nMsgID =0;
+#ifdef MSG_LANE_SUPPORT
+	{
+		unsigned int i, k, nNum = pMsgPool->nLaneNum;
+		X_EXT_MSG_LANE_T *pLane;
 
-	pMsgPool->nMsgBufHdr = (pMsgPool->nMsgBufHdr+1)%MSG_BUF_SIZE;
+		for (k=0; k<=nNum; k++)
+		{
+			i = (pMsgPool->nNextLane + k) % (nNum+1);
+			if (i==nNum)
+			{
+				if (!XGetMsgFromQueue(pMsgPool, pMsg))
+					continue;
+			} else
+			{
+				pLane = &(pMsgPool->Lanes[i]);
+				if (XAtomicLoadAcquire(&(pLane->nRear)) == pLane->nHdr)
+					continue;
+				memcpy(pMsg, &(pLane->MsgBuf[MSG_LANE_IDX(pLane->nHdr)]), sizeof(X_EXT_MSG_T));
+				XAtomicStoreRelease(&(pLane->nHdr), pLane->nHdr+1);
+			}
+			pMsgPool->nNextLane = i+1;
+			return 0;
+		}
+	}
+#else
+	XGetMsgFromQueue(pMsgPool, pMsg);
+#endif
+	return 0;
+}
 
+/* Post an external event to the pool. Return FALSE if the event is dropped. */
+static BOOL XPostMsgToPool(X_EXT_MSG_POOL_T *pMsgPool, X_EXT_MSG_T *pMsg)
+{
+#ifdef MSG_LANE_SUPPORT
+	X_EXT_MSG_LANE_T *pLane;
+	// Timer events go through the shared queue, where duplicate timer events are rejected. Lanes are normal priority.
+	if (!MSG_IS_TIMER(pMsg->nMsgID) && SME_EVENT_PRIORITY_NORMAL==MSG_PRIORITY(pMsg) && NULL!=(pLane=XGetProducerLane(pMsgPool)))
+	{
+		if (!XAppendMsgToLane(pLane, pMsg))
+			return FALSE;
+		XWakeUpReceiver(pMsgPool);
+		return TRUE;
+	}
+#endif
+	XSignalEvent(&(pMsgPool->EventToThread),&(pMsgPool->MutexForPool),(XTHREAD_SAFE_ACTION_T)XAppendMsgToBuf,pMsg);
+	return (0!=pMsg->nMsgID);
 }
 
 int XPostThreadExtIntEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, int Param1, int Param2, 
@@ -181,8 +636,7 @@ int XPostThreadExtIntEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID,
 
 	pMsgPool = (X_EXT_MSG_POOL_T *)(pDestThreadContext->pExtEventPool);
 
-	XSignalEvent(&(pMsgPool->EventToThread),&(pMsgPool->MutexForPool),(XTHREAD_SAFE_ACTION_T)XAppendMsgToBuf,&Msg);
-	return 0;
+	return XPostMsgToPool(pMsgPool, &Msg) ? 0 : -1;
 }
 
 int XPostThreadExtPtrEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, void *pData, int nDataSize, 
@@ -217,31 +671,210 @@ int XPostThreadExtPtrEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID,
 	}
 	pMsgPool = (X_EXT_MSG_POOL_T *)(pDestThreadContext->pExtEventPool);
 
+	if (XPostMsgToPool(pMsgPool, &Msg))
+		return 0;
+	// The event is dropped.
+	if (Msg.Data.Ptr.pData)
+	{
+#if SME_CPP
+		delete Msg.Data.Ptr.pData;
+#else
+		free(Msg.Data.Ptr.pData);
+#endif
+	}
+	return -1;
+}
+
+typedef struct tagEXTMSGBATCH
+{
+	X_EXT_MSG_T *pMsgs;
+	int nNum;
+} X_EXT_MSG_BATCH_T;
+
+/* Thread-safe action to append a batch of external events to the rear of the queue at the destination thread.
+ An event which is not appended (buffer full or a duplicate timer event) gets nMsgID 0, so that the poster can free its data.
+*/
+static int XAppendMsgBatchToBuf(void *pArg)
+{
+	X_EXT_MSG_BATCH_T *pBatch = (X_EXT_MSG_BATCH_T*)pArg;
+	int i;
+	if (NULL==pBatch)
+		return 0;
 
-	XSignalEvent(&(pMsgPool->EventToThread),&(pMsgPool->MutexForPool),(XTHREAD_SAFE_ACTION_T)XAppendMsgToBuf,&Msg);
+	for (i=0; i<pBatch->nNum; i++)
+		XAppendMsgToBuf(&(pBatch->pMsgs[i]));
 	return 0;
 }
 
+/* Post a batch of events to a thread. Each run of events is appended under one lock, or to the lane of the posting 
+thread, with one wake-up of the destination thread. A run is no longer than the free space of the lane or the shared 
+queue, read without the lock, so that the events which would be dropped are not copied. Events are dropped if the 
+buffer is full, the same as a single post. Return -1 if any event is dropped. */
+int XPostThreadExtEventBatch(SME_THREAD_CONTEXT_T* pDestThreadContext, const SME_EXT_EVENT_DESC *pEvents, int nNum)
+{
+	X_EXT_MSG_T Msgs[MSG_BUF_SIZE];
+	X_EXT_MSG_BATCH_T Batch;
+	X_EXT_MSG_POOL_T *pMsgPool;
+	int i, nCount, nFree;
+	int nRet = 0;
+#ifdef MSG_LANE_SUPPORT
+	X_EXT_MSG_LANE_T *pLane;
+#endif
+	if (NULL==pEvents || nNum<=0 || NULL== pDestThreadContext || NULL==pDestThreadContext->pExtEventPool)
+		return -1;
+
+	pMsgPool = (X_EXT_MSG_POOL_T *)(pDestThreadContext->pExtEventPool);
+#ifdef MSG_LANE_SUPPORT
+	pLane = XGetProducerLane(pMsgPool);
+#endif
+
+	while (nNum>0)
+	{
+		nFree = (XAtomicLoadAcquire(&(pMsgPool->nMsgBufHdr)) - pMsgPool->nMsgBufRear - 1 + MSG_BUF_SIZE) % MSG_BUF_SIZE;
+#ifdef MSG_LANE_SUPPORT
+		if (NULL!=pLane)
+			nFree = MSG_LANE_SIZE - (int)(pLane->nRear - XAtomicLoadAcquire(&(pLane->nHdr)));
+#endif
+		if (nFree < 1)
+			nFree = 1; /* The receiving thread may have made room, or the event has a priority ring. */
+
+		nCount = 0;
+		for (i=0; i<nNum && nCount<nFree; i++)
+		{
+			X_EXT_MSG_T *pMsg = &(Msgs[nCount]);
+			if (pEvents[i].nMsgID==0)
+				continue;
+
+			pMsg->nMsgID = pEvents[i].nMsgID;
+			pMsg->pDestApp = pEvents[i].pDestApp;
+			pMsg->pDestThread = pDestThreadContext;
+			pMsg->nSequenceNum = pEvents[i].nSequenceNum;
+			pMsg->nCategory = pEvents[i].nCategory;
+			pMsg->nDataFormat = pEvents[i].nDataFormat;
+
+			if (SME_EVENT_DATA_FORMAT_PTR == pEvents[i].nDataFormat
+				&& pEvents[i].Data.Ptr.pData!=NULL && pEvents[i].Data.Ptr.nSize>0)
+			{
+#if SME_CPP
+				pMsg->Data.Ptr.pData = new char[pEvents[i].Data.Ptr.nSize];
+#else
+				pMsg->Data.Ptr.pData = malloc(pEvents[i].Data.Ptr.nSize);
+#endif
+				memcpy(pMsg->Data.Ptr.pData, pEvents[i].Data.Ptr.pData, pEvents[i].Data.Ptr.nSize);
+				pMsg->Data.Ptr.nSize = pEvents[i].Data.Ptr.nSize;
+			} else if (SME_EVENT_DATA_FORMAT_PTR == pEvents[i].nDataFormat)
+			{
+				pMsg->Data.Ptr.pData = NULL;
+				pMsg->Data.Ptr.nSize = 0;
+			} else
+			{
+				pMsg->Data.Int.nParam1 = pEvents[i].Data.Int.nParam1;
+				pMsg->Data.Int.nParam2 = pEvents[i].Data.Int.nParam2;
+			}
+			nCount++;
+		}
+		pEvents += i;
+		nNum -= i;
+
+		if (0==nCount)
+			continue;
+
+#ifdef MSG_LANE_SUPPORT
+		if (NULL!=pLane)
+		{
+			for (i=0; i<nCount; i++)
+			{
+				if (MSG_IS_TIMER(Msgs[i].nMsgID) || SME_EVENT_PRIORITY_NORMAL!=MSG_PRIORITY(&(Msgs[i])))
+				{
+					Batch.pMsgs = &(Msgs[i]);
+					Batch.nNum = 1;
+					XSignalEvent(&(pMsgPool->EventToThread),&(pMsgPool->MutexForPool),XAppendMsgBatchToBuf,&Batch);
+				} else if (!XAppendMsgToLane(pLane, &(Msgs[i])))
+					Msgs[i].nMsgID = 0;
+			}
+			XWakeUpReceiver(pMsgPool);
+		} else
+#endif
+		{
+			Batch.pMsgs = Msgs;
+			Batch.nNum = nCount;
+			XSignalEvent(&(pMsgPool->EventToThread),&(pMsgPool->MutexForPool),XAppendMsgBatchToBuf,&Batch);
+		}
+
+		// Free the data of the events which are dropped.
+		for (i=0; i<nCount; i++)
+		{
+			if (0!=Msgs[i].nMsgID)
+				continue;
+			nRet = -1;
+			if (SME_EVENT_DATA_FORMAT_PTR == Msgs[i].nDataFormat && Msgs[i].Data.Ptr.pData)
+			{
+#if SME_CPP
+				delete Msgs[i].Data.Ptr.pData;
+#else
+				free(Msgs[i].Data.Ptr.pData);
+#endif
+			}
+		}
+	}
+	return nRet;
+}
+
 BOOL XGetExtEvent(SME_EVENT_T* pEvent)
+{
+	return SME_EXT_EVENT_GOT == XGetExtEventTimeout(pEvent, XINFINITE);
+}
+
+// Wait for an external event no longer than nTimeOut milli-seconds. XINFINITE waits forever.
+int XGetExtEventTimeout(SME_EVENT_T* pEvent, unsigned int nTimeOut)
 {
 	X_EXT_MSG_T NativeMsg;
 	int ret=0;
+	unsigned int nWait = nTimeOut;
+	SME_UINT64 nDeadline = 0;
+	SME_UINT64 nNow;
+	BOOL bBlocking;
 
 	SME_THREAD_CONTEXT_T* p = XGetThreadContext();
 	X_EXT_MSG_POOL_T *pMsgPool;
 	if (NULL==pEvent || NULL==p || NULL==p->pExtEventPool)
-		return FALSE;
+		return SME_EXT_EVENT_EXIT;
 
 	pMsgPool = (X_EXT_MSG_POOL_T*)(p->pExtEventPool);
+	bBlocking = (0 == pMsgPool->WaitStrategy.nSpinNs && 0 == pMsgPool->WaitStrategy.nYieldNum);
+	if (XINFINITE != nTimeOut)
+		nDeadline = XGetTickNs() + (SME_UINT64)nTimeOut * 1000000;
 
 	memset(&NativeMsg,0,sizeof(NativeMsg));
 	while (TRUE)
 	{
-		ret = XWaitForEvent(&(pMsgPool->EventToThread), &(pMsgPool->MutexForPool), (XIS_CODITION_OK_T)XIsMsgAvailable, NULL, (XTHREAD_SAFE_ACTION_T)XGetMsgFromBuf,&NativeMsg);
+		// A blocking wait without a time-out stays on XWaitForEvent(), as XGetExtEvent() always did.
+		if (XINFINITE == nWait && bBlocking)
+			ret = XWaitForEvent(&(pMsgPool->EventToThread), &(pMsgPool->MutexForPool), XIsMsgAvailable, pMsgPool, 
+				XGetMsgFromBuf,&NativeMsg);
+		else
+			ret = XWaitForEventEx(&(pMsgPool->EventToThread), &(pMsgPool->MutexForPool), XIsMsgAvailable, pMsgPool, 
+				XGetMsgFromBuf,&NativeMsg, &(pMsgPool->WaitStrategy), XIsMsgPending, nWait);
 			
-		if (NativeMsg.nMsgID == SME_EVENT_EXIT_LOOP)
+		if (0 == NativeMsg.nMsgID && XWAIT_TIMEOUT == ret)
+		{
+			return SME_EXT_EVENT_TIMEOUT;
+		}
+		else if (0 == NativeMsg.nMsgID && 0 == ret)
 		{
-			return FALSE; //Request Exit
+			// Woken up without an event. Wait for the rest of the time.
+			if (XINFINITE != nTimeOut)
+			{
+				nNow = XGetTickNs();
+				if (nNow >= nDeadline)
+					return SME_EXT_EVENT_TIMEOUT;
+				nWait = (unsigned int)((nDeadline - nNow + 999999) / 1000000);
+			}
+			continue;
+		}
+		else if (NativeMsg.nMsgID == SME_EVENT_EXIT_LOOP)
+		{
+			return SME_EXT_EVENT_EXIT; //Request Exit
 		}
 #ifdef SME_WIN32
 #else
@@ -260,14 +893,14 @@ BOOL XGetExtEvent(SME_EVENT_T* pEvent)
 			pEvent->pDestApp = NativeMsg.pDestApp;
 			pEvent->nSequenceNum = NativeMsg.nSequenceNum;
 			pEvent->nDataFormat = NativeMsg.nDataFormat;
-			pEvent->nCategory = NativeMsg.nCategory;
+			pEvent->nCategory = SME_EVENT_CAT_OF(NativeMsg.nCategory);
 			pEvent->bIsConsumed = FALSE;
 			memcpy(&(pEvent->Data),&(NativeMsg.Data), sizeof(union SME_EVENT_DATA_T));
 		}
 
 		//printf("External message received. \n");
 
-		return TRUE;
+		return SME_EXT_EVENT_GOT;
 	}; // while (TRUE)
 }
 
@@ -0,0 +1,680 @@
+/* ==============================================================================================================================
+ * This notice must be untouched at all times.
+ *
+ * Copyright  IntelliWizard Inc. 
+ * All rights reserved.
+ * LICENSE: LGPL. 
+ * Redistributions of source code modifications must send back to the Intelliwizard Project and republish them. 
+ * Web: http://www.intelliwizard.com
+ * eMail: info@intelliwizard.com
+ * We provide technical supports for UML StateWizard users. The StateWizard users do NOT have to pay for technical supports 
+ * from the Intelliwizard team. We accept donation, but it is not mandatory.
+ * ==============================================================================================================================
+ High-resolution built-in timer
+ The XSetTimer() timers tick at the pulse interval. These timers expire at absolute deadlines on CLOCK_MONOTONIC, so that 
+ the handling time of expired timers does not add to the next deadline and time-outs are not rounded to a tick.
+
+ The timers which expire within the current wheel round are kept in a min-heap on their deadlines, and the timer thread 
+ sleeps on a timerfd armed to the earliest one. The far timers, which are most of the armed state timers, wait in a 
+ hierarchical timing wheel, where setting and killing a timer is O(1). The wheel is cascaded once a round, and the timers 
+ of the new round move to the heap with their exact deadlines.
+*/
+
+#include "sme_hr_timer.h"
+#include "sme_ext_event.h"
+
+#ifdef SME_LINUX
+#include <sys/timerfd.h>
+#include <stdlib.h>
+
+#define XHR_NS_PER_MS	1000000ULL
+#define XHR_NS_PER_US	1000ULL
+#define XHR_EXPIRE_BATCH  64 // The number of expired timers taken at a time under the timer mutex.
+#define XHR_SLAB_CHUNK_BITS	6
+#define XHR_SLAB_CHUNK	(1<<XHR_SLAB_CHUNK_BITS) // The number of timer nodes a thread allocates at a time.
+
+/* The timer nodes are also the slots of a table, which grows by the slab chunks and never shrinks. The sequence number 
+of a timer, which is also its handle, is the slot index with a generation count in the upper bits. A handle is looked up 
+in O(1), and once a timer is killed, its handle never matches the reused slot. The sequence number of a free node is 0. */
+#define XHR_SLOT_MASK	((1U<<SME_TIMER_SLOT_BITS)-1)
+#define XHR_GEN_MASK	((1U<<(32-SME_TIMER_SLOT_BITS))-1)
+#define XHR_CHUNK_NUM	((XHR_SLOT_MASK>>XHR_SLAB_CHUNK_BITS)+1)
+#define XHR_SLOT(_nSlot) (&(g_HrTimerChunks[(_nSlot)>>XHR_SLAB_CHUNK_BITS][(_nSlot)&(XHR_SLAB_CHUNK-1)]))
+
+/* A wheel round is 2^XHR_WHEEL_ROUND_BITS milli-seconds. Each level of the wheel has 64 slots, and a slot covers a whole 
+round of the level below, so that 4 levels cover the 32-bit milli-second time-outs. */
+#define XHR_WHEEL_ROUND_BITS	8
+#define XHR_WHEEL_BITS		6
+#define XHR_WHEEL_SIZE		(1<<XHR_WHEEL_BITS)
+#define XHR_WHEEL_MASK		(XHR_WHEEL_SIZE-1)
+#define XHR_WHEEL_LEVELS	4
+#define XHR_WHEEL_ROUND(_nNs) (((_nNs) / XHR_NS_PER_MS) >> XHR_WHEEL_ROUND_BITS)
+#define XHR_WHEEL_INDEX(_nRound,_nLevel) ((int)(((_nRound) >> ((_nLevel)*XHR_WHEEL_BITS)) & XHR_WHEEL_MASK))
+
+typedef struct tagXHRTIMER_T
+{
+	unsigned int nTimeOut; /* SME_IS_STATE_BUILT_IN_TIMEOUT_VAL can check whether a state timer or not. */
+	SME_UINT64 nDeadline; /* Absolute CLOCK_MONOTONIC time in nano-seconds. */
+	SME_UINT64 nPeriod; /* In nano-seconds. */
+	unsigned long nSequenceNum;
+	SME_TIMER_PROC_T pfnTimerFunc;
+	SME_APP_T *pDestApp;
+	SME_THREAD_CONTEXT_T *pDestThread;
+	int nHeapIdx;
+	unsigned int nSlot; /* The index in the timer slot table. */
+	unsigned int nGeneration;
+	struct tagXHRTIMER_T **ppWheelSlot; /* The wheel slot which the timer is linked in, or NULL if it is in the heap. */
+	struct tagXHRTIMER_T *pPrev;
+	struct tagXHRTIMER_T *pNext; /* The next timer in the wheel slot, or the next node in a free list. */
+	struct tagXHRTIMER_SLAB_T *pSlab; /* The slab of the thread which allocated the node. */
+} XHRTIMER_T;
+
+/* Timer nodes come from a slab of the setting thread, so that setting a timer does not malloc, and the timer mutex 
+guards the heap and the handles only. The owner thread takes nodes from its free list without a lock. A node freed by 
+another thread, e.g. a one-shot timer freed by the timer thread, is pushed onto pReturned by compare-and-swap, and 
+the owner takes the whole stack at once when its free list runs out. A slab and its chunks are never freed, since 
+the nodes of a thread may outlive it. */
+typedef struct tagXHRTIMER_SLAB_T
+{
+	XHRTIMER_T *pFree; /* Touched by the owner thread only. */
+	XHRTIMER_T *pReturned; /* Pushed by the other threads. */
+} XHRTIMER_SLAB_T;
+
+static XTHREAD_LOCAL XHRTIMER_SLAB_T *g_pHrTimerSlab = NULL;
+
+static XHRTIMER_T *g_HrTimerChunks[XHR_CHUNK_NUM];
+static unsigned int g_nHrTimerSlotNum = 0; /* The number of slots allocated. */
+static XHRTIMER_T **g_HrTimerHeap = NULL; /* Min-heap on nDeadline. */
+static int g_nHrTimerNum = 0;
+static int g_nHrTimerHeapSize = 0;
+static XHRTIMER_T *g_HrWheel[XHR_WHEEL_LEVELS][XHR_WHEEL_SIZE];
+static SME_UINT64 g_nHrWheelRound = 0; /* The current round, whose timers are in the heap. */
+static int g_nHrWheelNum = 0; /* The number of timers in the wheel. */
+static pthread_mutex_t g_HrTimerMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t g_HrTimerThread;
+static int g_nHrTimerFd = -1;
+static volatile BOOL g_bExitHrTimerThread = FALSE;
+
+static SME_UINT64 XHrNow(void)
+{
+	struct timespec Now;
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (SME_UINT64)Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+}
+
+static XHRTIMER_T* XHrAllocTimer(void)
+{
+	XHRTIMER_SLAB_T *pSlab = g_pHrTimerSlab;
+	XHRTIMER_T *pTimer;
+	int i;
+
+	if (NULL==pSlab)
+	{
+		pSlab = (XHRTIMER_SLAB_T*)calloc(1, sizeof(XHRTIMER_SLAB_T));
+		if (NULL==pSlab)
+			return NULL;
+		g_pHrTimerSlab = pSlab;
+	}
+
+	if (NULL==pSlab->pFree)
+		pSlab->pFree = __atomic_exchange_n(&(pSlab->pReturned), (XHRTIMER_T*)NULL, __ATOMIC_ACQUIRE);
+	if (NULL==pSlab->pFree)
+	{
+		unsigned int nFirstSlot;
+
+		pTimer = (XHRTIMER_T*)calloc(XHR_SLAB_CHUNK, sizeof(XHRTIMER_T));
+		if (NULL==pTimer)
+			return NULL;
+		/* Register the chunk in the slot table. */
+		pthread_mutex_lock(&g_HrTimerMutex);
+		nFirstSlot = g_nHrTimerSlotNum;
+		if ((nFirstSlot>>XHR_SLAB_CHUNK_BITS) >= XHR_CHUNK_NUM)
+		{
+			pthread_mutex_unlock(&g_HrTimerMutex);
+			free(pTimer);
+			return NULL;
+		}
+		g_HrTimerChunks[nFirstSlot>>XHR_SLAB_CHUNK_BITS] = pTimer;
+		g_nHrTimerSlotNum += XHR_SLAB_CHUNK;
+		pthread_mutex_unlock(&g_HrTimerMutex);
+
+		for (i=0; i<XHR_SLAB_CHUNK; i++)
+		{
+			pTimer[i].nSlot = nFirstSlot + i;
+			pTimer[i].pSlab = pSlab;
+			pTimer[i].pNext = (i+1<XHR_SLAB_CHUNK) ? &(pTimer[i+1]) : NULL;
+		}
+		pSlab->pFree = pTimer;
+	}
+
+	pTimer = pSlab->pFree;
+	pSlab->pFree = pTimer->pNext;
+	return pTimer;
+}
+
+static void XHrFreeTimer(XHRTIMER_T *pTimer)
+{
+	XHRTIMER_SLAB_T *pSlab = pTimer->pSlab;
+
+	if (pSlab == g_pHrTimerSlab)
+	{
+		pTimer->pNext = pSlab->pFree;
+		pSlab->pFree = pTimer;
+		return;
+	}
+
+	pTimer->pNext = __atomic_load_n(&(pSlab->pReturned), __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&(pSlab->pReturned), &(pTimer->pNext), pTimer, TRUE, 
+		__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+}
+
+// Find the armed timer of a handle under the timer mutex. Return NULL if the timer is killed.
+static XHRTIMER_T* XHrFindTimer(unsigned long nSequenceNum)
+{
+	unsigned int nSlot = (unsigned int)nSequenceNum & XHR_SLOT_MASK;
+	XHRTIMER_T *pTimer;
+
+	if (0==nSequenceNum || nSlot>=g_nHrTimerSlotNum)
+		return NULL;
+	pTimer = XHR_SLOT(nSlot);
+	return (pTimer->nSequenceNum == nSequenceNum) ? pTimer : NULL;
+}
+
+// Give a timer a new handle by counting up the generation of its slot, under the timer mutex.
+static void XHrRenewHandle(XHRTIMER_T *pTimer)
+{
+	unsigned int nGen = (pTimer->nGeneration + 1) & XHR_GEN_MASK;
+	if (0==nGen)
+		nGen = 1;
+	pTimer->nGeneration = nGen;
+	pTimer->nSequenceNum = (nGen << SME_TIMER_SLOT_BITS) | pTimer->nSlot;
+}
+
+static void XHrHeapSet(int nIdx, XHRTIMER_T *pTimer)
+{
+	g_HrTimerHeap[nIdx] = pTimer;
+	pTimer->nHeapIdx = nIdx;
+}
+
+static void XHrHeapUp(int nIdx)
+{
+	XHRTIMER_T *pTimer = g_HrTimerHeap[nIdx];
+	while (nIdx > 0 && g_HrTimerHeap[(nIdx-1)/2]->nDeadline > pTimer->nDeadline)
+	{
+		XHrHeapSet(nIdx, g_HrTimerHeap[(nIdx-1)/2]);
+		nIdx = (nIdx-1)/2;
+	}
+	XHrHeapSet(nIdx, pTimer);
+}
+
+static void XHrHeapDown(int nIdx)
+{
+	XHRTIMER_T *pTimer = g_HrTimerHeap[nIdx];
+	int nChild;
+	while ((nChild = 2*nIdx+1) < g_nHrTimerNum)
+	{
+		if (nChild+1 < g_nHrTimerNum && g_HrTimerHeap[nChild+1]->nDeadline < g_HrTimerHeap[nChild]->nDeadline)
+			nChild++;
+		if (g_HrTimerHeap[nChild]->nDeadline >= pTimer->nDeadline)
+			break;
+		XHrHeapSet(nIdx, g_HrTimerHeap[nChild]);
+		nIdx = nChild;
+	}
+	XHrHeapSet(nIdx, pTimer);
+}
+
+static BOOL XHrHeapPush(XHRTIMER_T *pTimer)
+{
+	if (g_nHrTimerNum == g_nHrTimerHeapSize)
+	{
+		int nSize = g_nHrTimerHeapSize ? 2*g_nHrTimerHeapSize : 64;
+		XHRTIMER_T **pHeap = (XHRTIMER_T**)realloc(g_HrTimerHeap, nSize*sizeof(XHRTIMER_T*));
+		if (NULL==pHeap)
+			return FALSE;
+		g_HrTimerHeap = pHeap;
+		g_nHrTimerHeapSize = nSize;
+	}
+	XHrHeapSet(g_nHrTimerNum++, pTimer);
+	XHrHeapUp(g_nHrTimerNum-1);
+	return TRUE;
+}
+
+static void XHrHeapRemove(XHRTIMER_T *pTimer)
+{
+	int nIdx = pTimer->nHeapIdx;
+	XHRTIMER_T *pLast = g_HrTimerHeap[--g_nHrTimerNum];
+	if (pLast == pTimer)
+		return;
+	XHrHeapSet(nIdx, pLast);
+	XHrHeapUp(nIdx);
+	XHrHeapDown(pLast->nHeapIdx);
+}
+
+static void XHrWheelLink(int nLevel, SME_UINT64 nRound, XHRTIMER_T *pTimer)
+{
+	XHRTIMER_T **ppSlot = &(g_HrWheel[nLevel][XHR_WHEEL_INDEX(nRound, nLevel)]);
+
+	pTimer->ppWheelSlot = ppSlot;
+	pTimer->pPrev = NULL;
+	pTimer->pNext = *ppSlot;
+	if (*ppSlot)
+		(*ppSlot)->pPrev = pTimer;
+	*ppSlot = pTimer;
+	g_nHrWheelNum++;
+}
+
+static void XHrWheelUnlink(XHRTIMER_T *pTimer)
+{
+	if (pTimer->pPrev)
+		pTimer->pPrev->pNext = pTimer->pNext;
+	else
+		*(pTimer->ppWheelSlot) = pTimer->pNext;
+	if (pTimer->pNext)
+		pTimer->pNext->pPrev = pTimer->pPrev;
+	pTimer->ppWheelSlot = NULL;
+	g_nHrWheelNum--;
+}
+
+/* Queue a timer in the heap if it expires in the current round, or in the wheel level whose slots cover its round 
+otherwise. Return FALSE if the heap can not grow. */
+static BOOL XHrQueueTimer(XHRTIMER_T *pTimer)
+{
+	SME_UINT64 nRound = XHR_WHEEL_ROUND(pTimer->nDeadline);
+	SME_UINT64 nDelta;
+	int nLevel;
+
+	pTimer->ppWheelSlot = NULL;
+	if (nRound <= g_nHrWheelRound)
+		return XHrHeapPush(pTimer);
+
+	nDelta = nRound - g_nHrWheelRound;
+	for (nLevel=0; nLevel<XHR_WHEEL_LEVELS-1 && nDelta >= ((SME_UINT64)1 << ((nLevel+1)*XHR_WHEEL_BITS)); nLevel++)
+		;
+	XHrWheelLink(nLevel, nRound, pTimer);
+	return TRUE;
+}
+
+// Take an armed timer off the heap or the wheel.
+static void XHrDequeueTimer(XHRTIMER_T *pTimer)
+{
+	if (pTimer->ppWheelSlot)
+		XHrWheelUnlink(pTimer);
+	else
+		XHrHeapRemove(pTimer);
+}
+
+// Queue the timers of a wheel slot again, as its round comes near.
+static void XHrCascadeTimers(int nLevel, SME_UINT64 nRound)
+{
+	XHRTIMER_T **ppSlot = &(g_HrWheel[nLevel][XHR_WHEEL_INDEX(nRound, nLevel)]);
+	XHRTIMER_T *pTimer;
+
+	while (NULL != (pTimer = *ppSlot))
+	{
+		XHrWheelUnlink(pTimer);
+		if (!XHrQueueTimer(pTimer))
+			XHrWheelLink(0, g_nHrWheelRound+1, pTimer); /* No memory for the heap. Try again at the next round. */
+	}
+}
+
+/* Turn the wheel to the round of nNow. Going to a round, the upper levels whose slot begins with it are cascaded from 
+the top down, and then the timers of the round move from the root level to the heap. */
+static void XHrTurnWheel(SME_UINT64 nNow)
+{
+	SME_UINT64 nRound = XHR_WHEEL_ROUND(nNow);
+	int nLevel;
+
+	while (g_nHrWheelRound < nRound)
+	{
+		if (0==g_nHrWheelNum)
+		{
+			g_nHrWheelRound = nRound;
+			break;
+		}
+		g_nHrWheelRound++;
+		for (nLevel=1; nLevel<XHR_WHEEL_LEVELS && 0==XHR_WHEEL_INDEX(g_nHrWheelRound, nLevel-1); nLevel++)
+			;
+		while (--nLevel >= 0)
+			XHrCascadeTimers(nLevel, g_nHrWheelRound);
+	}
+}
+
+/* Arm the timerfd to the earliest deadline in the heap, or to the next round if the wheel has a timer which is due 
+earlier, or disarm it if no timer is armed. */
+static void XHrArmTimerFd(void)
+{
+	struct itimerspec Spec;
+	SME_UINT64 nDeadline = 0;
+	SME_UINT64 nNextRound;
+
+	if (g_nHrTimerNum > 0)
+		nDeadline = g_HrTimerHeap[0]->nDeadline;
+	if (g_nHrWheelNum > 0)
+	{
+		nNextRound = ((g_nHrWheelRound+1) << XHR_WHEEL_ROUND_BITS) * XHR_NS_PER_MS;
+		if (0==nDeadline || nNextRound < nDeadline)
+			nDeadline = nNextRound;
+	}
+
+	memset(&Spec, 0, sizeof(Spec));
+	if (nDeadline)
+	{
+		Spec.it_value.tv_sec = (time_t)(nDeadline / 1000000000ULL);
+		Spec.it_value.tv_nsec = (long)(nDeadline % 1000000000ULL);
+		if (0==Spec.it_value.tv_sec && 0==Spec.it_value.tv_nsec)
+			Spec.it_value.tv_nsec = 1;
+	}
+	timerfd_settime(g_nHrTimerFd, TFD_TIMER_ABSTIME, &Spec, NULL);
+}
+
+// Whether a timer which is queued just now is due before the timerfd is armed to.
+#define XHR_IS_NEW_EARLIEST(_pTimer) ((_pTimer)->ppWheelSlot ? 1==g_nHrWheelNum : 0==(_pTimer)->nHeapIdx)
+
+static void XHrFireTimer(XHRTIMER_T *pTimer)
+{
+	if (pTimer->pfnTimerFunc)
+	{
+		// Invoke the call back function.
+		(*(pTimer->pfnTimerFunc))(pTimer->pDestApp, pTimer->nSequenceNum);
+	} else
+	{
+		// Create an external timer event and post it .
+		SmePostThreadExtIntEvent(pTimer->pDestThread, 
+			SME_IS_STATE_BUILT_IN_TIMEOUT_VAL(pTimer->nTimeOut) ? SME_EVENT_STATE_TIMER : SME_EVENT_TIMER, 
+			SME_TIMER_TYPE_EVENT,
+			0, 
+			pTimer->pDestApp,
+			pTimer->nSequenceNum,
+			SME_EVENT_CAT_OTHER);
+	}
+}
+
+static void* XHrTimerProc(void *Param)
+{
+	XHRTIMER_T Expired[XHR_EXPIRE_BATCH];
+	XHRTIMER_T *pTimer;
+	SME_UINT64 nNow, nTicks;
+	int i, nNum;
+
+	SME_UNUSED_VOIDP_PARAM(Param);
+	while (!g_bExitHrTimerThread)
+	{
+		if (read(g_nHrTimerFd, &nTicks, sizeof(nTicks)) < 0 && EINTR!=errno && EAGAIN!=errno)
+			break;
+
+		nNow = XHrNow();
+		do
+		{
+			nNum = 0;
+			pthread_mutex_lock(&g_HrTimerMutex);
+			XHrTurnWheel(nNow);
+			while (nNum<XHR_EXPIRE_BATCH && g_nHrTimerNum>0 && g_HrTimerHeap[0]->nDeadline <= nNow)
+			{
+				pTimer = g_HrTimerHeap[0];
+				memcpy(&(Expired[nNum++]), pTimer, sizeof(XHRTIMER_T));
+
+				if (SME_IS_ONE_SHOT_TIMEOUT_VAL(pTimer->nTimeOut))
+				{
+					pTimer->nSequenceNum = 0;
+					XHrHeapRemove(pTimer);
+					XHrFreeTimer(pTimer);
+					continue;
+				}
+
+				// Restart timer from its deadline. Do not catch up on the missed periods.
+				pTimer->nDeadline += pTimer->nPeriod;
+				if (pTimer->nDeadline <= nNow)
+					pTimer->nDeadline = nNow + pTimer->nPeriod;
+				pTimer->nDeadline = SME_TIMER_SLACK_ROUND_UP(pTimer->nDeadline, SME_GET_TIMER_SLACK(pTimer->pDestApp) * XHR_NS_PER_MS);
+				XHrHeapRemove(pTimer);
+				if (!XHrQueueTimer(pTimer))
+					XHrWheelLink(0, g_nHrWheelRound+1, pTimer); /* No memory for the heap. Try again at the next round. */
+			}
+			XHrArmTimerFd();
+			pthread_mutex_unlock(&g_HrTimerMutex);
+
+			// The expired timers are handled out of the timer mutex, so that a call back function may set or kill timers.
+			for (i=0; i<nNum; i++)
+				XHrFireTimer(&(Expired[i]));
+		} while (XHR_EXPIRE_BATCH==nNum);
+	}
+	return NULL;
+}
+
+int XInitHrTimer()
+{
+	if (g_nHrTimerFd >= 0)
+		return 0;
+
+	g_nHrTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (g_nHrTimerFd < 0)
+		return -1;
+
+	g_bExitHrTimerThread = FALSE;
+	g_nHrWheelRound = XHR_WHEEL_ROUND(XHrNow());
+	if (0!=pthread_create(&g_HrTimerThread, NULL, XHrTimerProc, NULL))
+	{
+		close(g_nHrTimerFd);
+		g_nHrTimerFd = -1;
+		return -1;
+	}
+	return 0;
+}
+
+// Stop the timer thread. The timers which are still armed are freed.
+int XDestroyHrTimer()
+{
+	struct itimerspec Spec;
+	XHRTIMER_T *pTimer;
+	int i, j;
+
+	if (g_nHrTimerFd < 0)
+		return -1;
+
+	// Wake up the timer thread at once.
+	g_bExitHrTimerThread = TRUE;
+	memset(&Spec, 0, sizeof(Spec));
+	Spec.it_value.tv_nsec = 1;
+	timerfd_settime(g_nHrTimerFd, 0, &Spec, NULL);
+	pthread_join(g_HrTimerThread, NULL);
+
+	close(g_nHrTimerFd);
+	g_nHrTimerFd = -1;
+
+	pthread_mutex_lock(&g_HrTimerMutex);
+	for (i=0; i<g_nHrTimerNum; i++)
+	{
+		g_HrTimerHeap[i]->nSequenceNum = 0;
+		XHrFreeTimer(g_HrTimerHeap[i]);
+	}
+	g_nHrTimerNum = 0;
+	for (i=0; i<XHR_WHEEL_LEVELS; i++)
+	{
+		for (j=0; j<XHR_WHEEL_SIZE; j++)
+		{
+			while (NULL != (pTimer = g_HrWheel[i][j]))
+			{
+				XHrWheelUnlink(pTimer);
+				pTimer->nSequenceNum = 0;
+				XHrFreeTimer(pTimer);
+			}
+		}
+	}
+	pthread_mutex_unlock(&g_HrTimerMutex);
+	return 0;
+}
+
+static unsigned int XHrSetTimer(SME_APP_T *pDestApp, unsigned int nTimeOut, SME_UINT64 nPeriod, SME_TIMER_PROC_T pfnTimerFunc)
+{
+	XHRTIMER_T *pTimer;
+	unsigned long nSeqNum;
+
+	/* The per-thread timers keep the virtual clock, in milli-seconds. They do not call a callback function. */
+	if (SmeIsVirtualClock())
+		return pfnTimerFunc ? 0 : SmeSetThreadTimer(pDestApp, (nTimeOut & ~SME_GET_TIMEOUT_VAL(nTimeOut)) 
+			| (unsigned int)((nPeriod + XHR_NS_PER_MS - 1) / XHR_NS_PER_MS));
+
+	if (g_nHrTimerFd < 0)
+		return 0;
+
+	pTimer = XHrAllocTimer();
+	if (NULL==pTimer)
+		return 0;
+
+	if (0==nPeriod)
+		nPeriod = 1;
+	pTimer->nTimeOut = nTimeOut;
+	pTimer->nPeriod = nPeriod;
+	pTimer->nDeadline = SME_TIMER_SLACK_ROUND_UP(XHrNow() + nPeriod, SME_GET_TIMER_SLACK(pDestApp) * XHR_NS_PER_MS);
+	pTimer->pfnTimerFunc = pfnTimerFunc;
+	pTimer->pDestApp = pDestApp;
+	pTimer->pDestThread = SME_OWNER_THREAD_CONTEXT(XGetThreadContext()); /* The time-out event destination thread is the current calling thread. */
+
+	pthread_mutex_lock(&g_HrTimerMutex);
+	if (0==g_nHrWheelNum)
+		XHrTurnWheel(XHrNow()); /* The timer thread does not turn an empty wheel. */
+	if (!XHrQueueTimer(pTimer))
+	{
+		pthread_mutex_unlock(&g_HrTimerMutex);
+		XHrFreeTimer(pTimer);
+		return 0;
+	}
+	XHrRenewHandle(pTimer);
+	nSeqNum = pTimer->nSequenceNum;
+	if (XHR_IS_NEW_EARLIEST(pTimer))
+		XHrArmTimerFd(); // A new earliest deadline.
+	pthread_mutex_unlock(&g_HrTimerMutex);
+
+	return nSeqNum;
+}
+
+/* The same as XSetTimer(). nTimeOut is in milli-seconds. */
+unsigned int XSetHrTimer(SME_APP_T *pDestApp, unsigned int nTimeOut, SME_TIMER_PROC_T pfnTimerFunc)
+{
+	return XHrSetTimer(pDestApp, nTimeOut, SME_GET_TIMEOUT_VAL(nTimeOut) * XHR_NS_PER_MS, pfnTimerFunc);
+}
+
+/* A regular timer with a time-out value in micro-seconds. */
+unsigned int XSetHrTimerUs(SME_APP_T *pDestApp, unsigned int nTimeOutUs, SME_TIMER_PROC_T pfnTimerFunc)
+{
+	return XHrSetTimer(pDestApp, 0, nTimeOutUs * XHR_NS_PER_US, pfnTimerFunc);
+}
+
+unsigned int XSetHrEventTimer(SME_APP_T *pDestApp, unsigned int nTimeOut)
+{
+	return XSetHrTimer(pDestApp, nTimeOut, NULL);
+}
+
+/* Return the remaining time in milli-seconds, rounded up. Return (unsigned int)-1 if the timer does not exist. */
+unsigned int XGetHrTimerRemain(unsigned int nSequenceNum)
+{
+	XHRTIMER_T *pTimer;
+	SME_UINT64 nNow;
+	int nLeft = -1;
+
+	if (SmeIsVirtualClock())
+		return SmeGetThreadTimerRemain(nSequenceNum);
+
+	pthread_mutex_lock(&g_HrTimerMutex);
+	pTimer = XHrFindTimer(nSequenceNum);
+	if (pTimer)
+	{
+		nNow = XHrNow();
+		nLeft = (pTimer->nDeadline > nNow) ? (int)((pTimer->nDeadline - nNow + XHR_NS_PER_MS - 1) / XHR_NS_PER_MS) : 0;
+	}
+	pthread_mutex_unlock(&g_HrTimerMutex);
+	return nLeft;
+}
+
+/* Restart an armed timer with a new time-out value. It gets a new handle in the same slot, so that its expired 
+time-out events, which have not been handled yet, do not match it. Return 0 if the timer does not exist. */
+unsigned int XRearmHrTimer(unsigned int nSequenceNum, unsigned int nTimeOut)
+{
+	XHRTIMER_T *pTimer;
+	unsigned long nSeqNum = 0;
+	BOOL bWasEarliest;
+
+	if (SmeIsVirtualClock())
+		return SmeRearmThreadTimer(nSequenceNum, nTimeOut);
+
+	pthread_mutex_lock(&g_HrTimerMutex);
+	pTimer = XHrFindTimer(nSequenceNum);
+	if (pTimer)
+	{
+		XHrRenewHandle(pTimer);
+		nSeqNum = pTimer->nSequenceNum;
+
+		pTimer->nTimeOut = nTimeOut;
+		pTimer->nPeriod = SME_GET_TIMEOUT_VAL(nTimeOut) * XHR_NS_PER_MS;
+		if (0==pTimer->nPeriod)
+			pTimer->nPeriod = 1;
+		pTimer->nDeadline = SME_TIMER_SLACK_ROUND_UP(XHrNow() + pTimer->nPeriod, SME_GET_TIMER_SLACK(pTimer->pDestApp) * XHR_NS_PER_MS);
+
+		bWasEarliest = (NULL==pTimer->ppWheelSlot && 0==pTimer->nHeapIdx);
+		XHrDequeueTimer(pTimer);
+		if (!XHrQueueTimer(pTimer))
+			XHrWheelLink(0, g_nHrWheelRound+1, pTimer); /* No memory for the heap. Try again at the next round. */
+		if (bWasEarliest || XHR_IS_NEW_EARLIEST(pTimer))
+			XHrArmTimerFd();
+	}
+	pthread_mutex_unlock(&g_HrTimerMutex);
+	return nSeqNum;
+}
+
+BOOL XKillHrTimer(unsigned int nSequenceNum)
+{
+	XHRTIMER_T *pTimer;
+
+	if (SmeIsVirtualClock())
+		return SmeKillThreadTimer(nSequenceNum);
+
+	pthread_mutex_lock(&g_HrTimerMutex);
+	pTimer = XHrFindTimer(nSequenceNum);
+	if (pTimer)
+	{
+		pTimer->nSequenceNum = 0;
+		XHrDequeueTimer(pTimer);
+	}
+	pthread_mutex_unlock(&g_HrTimerMutex);
+
+	if (NULL==pTimer)
+		return FALSE;
+	XHrFreeTimer(pTimer);
+	return TRUE;
+}
+
+/* Kill a batch of timers under a single lock. 0 handles are skipped. Return the number of timers killed. */
+int XKillHrTimers(const unsigned int *pSequenceNums, int nNum)
+{
+	XHRTIMER_T *pTimer;
+	int nKilled = 0;
+	int i;
+
+	if (NULL==pSequenceNums || nNum<=0)
+		return 0;
+
+	if (SmeIsVirtualClock())
+	{
+		for (i=0; i<nNum; i++)
+			if (pSequenceNums[i] && SmeKillThreadTimer(pSequenceNums[i]))
+				nKilled++;
+		return nKilled;
+	}
+
+	pthread_mutex_lock(&g_HrTimerMutex);
+	for (i=0; i<nNum; i++)
+	{
+		pTimer = XHrFindTimer(pSequenceNums[i]);
+		if (NULL==pTimer)
+			continue;
+		pTimer->nSequenceNum = 0;
+		XHrDequeueTimer(pTimer);
+		XHrFreeTimer(pTimer);
+		nKilled++;
+	}
+	pthread_mutex_unlock(&g_HrTimerMutex);
+	return nKilled;
+}
+
+#endif /* SME_LINUX */
@@ -0,0 +1,428 @@
+/* ==============================================================================================================================
+ * This notice must be untouched at all times.
+ *
+ * Copyright  IntelliWizard Inc. 
+ * All rights reserved.
+ * LICENSE: LGPL. 
+ * Redistributions of source code modifications must send back to the Intelliwizard Project and republish them. 
+ * Web: http://www.intelliwizard.com
+ * eMail: info@intelliwizard.com
+ * We provide technical supports for UML StateWizard users. The StateWizard users do NOT have to pay for technical supports 
+ * from the Intelliwizard team. We accept donation, but it is not mandatory.
+ * ==============================================================================================================================
+ Shards
+ The keys are indexed by a hash table under a read-write lock. A post takes the read lock to look up the shard and the 
+ application of a key. Adding or removing a key takes the write lock, and posts SME_EVENT_SHARD_ADD_APP or 
+ SME_EVENT_SHARD_REMOVE_APP to the shard thread under it, so that the events posted to a key once it is added come after 
+ its activation, and the events posted once it is removed fail.
+
+ A shard thread handles these two events in its event come hook, before the engine dispatches them to the dummy 
+ application of the shard, which keeps the thread loop running. The hook calls the one installed before it.
+
+ Nothing waits under the write lock: if the external event pool of the shard is full, adding or removing the key fails 
+ and is undone, since a shard thread which adds a key to itself would never drain its pool.
+*/
+
+#include "sme_shard.h"
+
+#ifdef SME_LINUX
+#include <stdlib.h>
+
+#define XSHARD_KEY_HASH(_nKey) ((unsigned int)(_nKey) & (SME_SHARD_KEY_HASH_SIZE-1))
+
+/* The states of a shard thread. */
+enum { XSHARD_STARTING=0, XSHARD_RUNNING, XSHARD_STOPPED };
+
+typedef struct tagXSHARD_KEY_T
+{
+	unsigned long nKey;
+	SME_APP_T *pApp;
+	int nShard;
+	struct tagXSHARD_KEY_T *pNext; /* The next key in the same hash chain. */
+} XSHARD_KEY_T;
+
+typedef struct tagXSHARD_T
+{
+	SME_THREAD_CONTEXT_T ThreadContext;
+	pthread_t Thread;
+	SME_APP_T *pShardApp; /* The dummy application of the shard. */
+	struct tagXSHARDS_T *pShards;
+	int nState; /* XSHARD_RUNNING once its external event buffer is ready, under the mutex of the shards. */
+	SME_ON_EVENT_COME_HOOK_T pfnOldOnEventCome; /* The hook installed at the shard thread before. */
+	int nAppNum;
+	unsigned long nPostedNum;
+	unsigned long nPostFailedNum;
+	unsigned long nHandledNum;
+} XSHARD_T;
+
+struct tagXSHARDS_T
+{
+	pthread_rwlock_t Lock; /* Guards the keys and the route function. */
+	XSHARD_KEY_T *Keys[SME_SHARD_KEY_HASH_SIZE];
+	XSHARD_ROUTE_PROC_T pfnRoute;
+	void *pRouteParam;
+	int nShardNum;
+	int nStartedNum; /* The number of the shard threads started. */
+	XSHARD_T *pShards;
+	pthread_mutex_t StateMutex; /* Guards the states of the shards. */
+	pthread_cond_t StateCond;
+};
+
+/* The shard of the calling thread, or NULL if it is not a shard thread. */
+static XTHREAD_LOCAL XSHARD_T *g_pCurrShard = NULL;
+
+static XSHARD_KEY_T** XFindShardKey(XSHARDS_T *pShards, unsigned long nKey)
+{
+	XSHARD_KEY_T **ppKey = &(pShards->Keys[XSHARD_KEY_HASH(nKey)]);
+
+	while (*ppKey && (*ppKey)->nKey != nKey)
+		ppKey = &((*ppKey)->pNext);
+	return ppKey;
+}
+
+static int XShardOnEventCome(SME_EVENT_ORIGIN_T nEventOrigin, SME_EVENT_T *pEvent)
+{
+	XSHARD_T *pShard = g_pCurrShard;
+	SME_APP_T *pApp;
+
+	if (NULL==pShard)
+		return 0;
+	if (pShard->pfnOldOnEventCome)
+		(*pShard->pfnOldOnEventCome)(nEventOrigin, pEvent);
+	if (SME_EVENT_ORIGIN_EXTERNAL!=nEventOrigin || NULL==pEvent)
+		return 0;
+
+	if ((SME_EVENT_SHARD_ADD_APP != pEvent->nEventID && SME_EVENT_SHARD_REMOVE_APP != pEvent->nEventID)
+		|| pEvent->pDestApp != pShard->pShardApp)
+	{
+		XAtomicFetchAdd(&pShard->nHandledNum, 1);
+		return 0;
+	}
+	if (SME_EVENT_DATA_FORMAT_PTR != pEvent->nDataFormat || sizeof(pApp) != (unsigned int)pEvent->Data.Ptr.nSize)
+		return 0;
+	memcpy(&pApp, pEvent->Data.Ptr.pData, sizeof(pApp));
+	if (SME_EVENT_SHARD_ADD_APP == pEvent->nEventID)
+		SmeActivateApp(pApp, NULL);
+	else
+		SmeDeactivateApp(pApp);
+	return 0;
+}
+
+/* Post an event to the shard thread itself. It returns 0 on success, or non-zero if its external event pool is full. */
+static int XPostShardControl(XSHARD_T *pShard, int nMsgID, SME_APP_T *pApp, SME_EVENT_PRIORITY_T nPriority)
+{
+	return SmePostThreadExtPtrEventEx(&(pShard->ThreadContext), nMsgID, &pApp, sizeof(pApp), 
+		pShard->pShardApp, 0, SME_EVENT_CAT_OTHER, nPriority);
+}
+
+static void XSetShardState(XSHARD_T *pShard, int nState)
+{
+	pthread_mutex_lock(&pShard->pShards->StateMutex);
+	pShard->nState = nState;
+	pthread_cond_broadcast(&pShard->pShards->StateCond);
+	pthread_mutex_unlock(&pShard->pShards->StateMutex);
+}
+
+/* Wait for a shard thread to leave XSHARD_STARTING, and return its state. */
+static int XWaitShardStarted(XSHARD_T *pShard)
+{
+	int nState;
+
+	pthread_mutex_lock(&pShard->pShards->StateMutex);
+	while (XSHARD_STARTING == pShard->nState)
+		pthread_cond_wait(&pShard->pShards->StateCond, &pShard->pShards->StateMutex);
+	nState = pShard->nState;
+	pthread_mutex_unlock(&pShard->pShards->StateMutex);
+	return nState;
+}
+
+static int XShardInit(void *pParam)
+{
+	XSHARD_T *pShard = (XSHARD_T*)pParam;
+
+	/* Without the external event buffer, the thread loop returns at once. */
+	if (NULL==pShard->ThreadContext.pExtEventPool)
+		return -1;
+	g_pCurrShard = pShard;
+	pShard->pfnOldOnEventCome = SmeSetOnEventComeHook(XShardOnEventCome);
+	XSetShardState(pShard, XSHARD_RUNNING);
+	return 0;
+}
+
+static void* XShardThreadProc(void *Param)
+{
+	XSHARD_T *pShard = (XSHARD_T*)Param;
+
+	SmeThreadLoop(&(pShard->ThreadContext), pShard->pShardApp, XShardInit, pShard);
+	g_pCurrShard = NULL;
+	XSetShardState(pShard, XSHARD_STOPPED);
+	return NULL;
+}
+
+XSHARDS_T* XCreateShards(int nShardNum)
+{
+	XSHARDS_T *pShards;
+	int i;
+
+	if (nShardNum <= 0)
+		nShardNum = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (nShardNum <= 0)
+		nShardNum = 1;
+
+	pShards = (XSHARDS_T*)calloc(1, sizeof(XSHARDS_T));
+	if (NULL==pShards)
+		return NULL;
+	pShards->pShards = (XSHARD_T*)calloc(nShardNum, sizeof(XSHARD_T));
+	if (NULL==pShards->pShards)
+	{
+		free(pShards);
+		return NULL;
+	}
+	pthread_rwlock_init(&pShards->Lock, NULL);
+	pthread_mutex_init(&pShards->StateMutex, NULL);
+	pthread_cond_init(&pShards->StateCond, NULL);
+	pShards->pfnRoute = XHashShardKey;
+	pShards->nShardNum = nShardNum;
+
+	for (i=0; i<nShardNum; i++)
+	{
+		XSHARD_T *pShard = &(pShards->pShards[i]);
+		pShard->pShards = pShards;
+		pShard->pShardApp = SmeCreateApp("Shard", i, NULL);
+		if (NULL==pShard->pShardApp 
+			|| 0!=pthread_create(&(pShard->Thread), NULL, XShardThreadProc, pShard))
+		{
+			/* Stop the started shards only. */
+			pShards->nStartedNum = i;
+			XDestroyShards(pShards);
+			return NULL;
+		}
+		pShards->nStartedNum = i+1;
+	}
+
+	/* The events posted to a shard are not dropped once it is created. A shard thread which can not set up its external 
+	event buffer has stopped already. */
+	for (i=0; i<nShardNum; i++)
+	{
+		if (XSHARD_RUNNING != XWaitShardStarted(&(pShards->pShards[i])))
+		{
+			XDestroyShards(pShards);
+			return NULL;
+		}
+	}
+	return pShards;
+}
+
+int XDestroyShards(XSHARDS_T *pShards)
+{
+	XSHARD_KEY_T *pKey;
+	int i;
+
+	if (NULL==pShards)
+		return -1;
+
+	for (i=0; i<pShards->nStartedNum; i++)
+	{
+		/* The shard thread takes the exit event once its buffer is ready. A running shard drains its pool meanwhile, 
+		and no lock is held here. */
+		if (XSHARD_RUNNING != XWaitShardStarted(&(pShards->pShards[i])))
+			continue;
+		while (0 != SmePostThreadExtIntEvent(&(pShards->pShards[i].ThreadContext), SME_EVENT_EXIT_LOOP, 0, 0, NULL, 0, 
+			SME_EVENT_CAT_OTHER))
+			usleep(1000);
+	}
+	for (i=0; i<pShards->nStartedNum; i++)
+		pthread_join(pShards->pShards[i].Thread, NULL);
+	for (i=0; i<pShards->nShardNum; i++)
+		SmeDestroyApp(pShards->pShards[i].pShardApp);
+
+	for (i=0; i<SME_SHARD_KEY_HASH_SIZE; i++)
+	{
+		while (NULL != (pKey = pShards->Keys[i]))
+		{
+			pShards->Keys[i] = pKey->pNext;
+			free(pKey);
+		}
+	}
+
+	pthread_rwlock_destroy(&pShards->Lock);
+	pthread_mutex_destroy(&pShards->StateMutex);
+	pthread_cond_destroy(&pShards->StateCond);
+	free(pShards->pShards);
+	free(pShards);
+	return 0;
+}
+
+void XSetShardRouteProc(XSHARDS_T *pShards, XSHARD_ROUTE_PROC_T pfnRoute, void *pParam)
+{
+	if (NULL==pShards)
+		return;
+	pthread_rwlock_wrlock(&pShards->Lock);
+	pShards->pfnRoute = pfnRoute ? pfnRoute : XHashShardKey;
+	pShards->pRouteParam = pParam;
+	pthread_rwlock_unlock(&pShards->Lock);
+}
+
+int XHashShardKey(XSHARDS_T *pShards, unsigned long nKey, int nShardNum, void *pParam)
+{
+	/* Fibonacci hashing spreads the sequential keys, such as session IDs, over the shards. */
+	SME_UINT64 nHash = (SME_UINT64)nKey * 0x9E3779B97F4A7C15ULL;
+
+	(void)pShards; /* SME_UNUSED_VOIDP_PARAM() takes a void pointer only. */
+	SME_UNUSED_VOIDP_PARAM(pParam);
+	return (int)((nHash >> 32) % (SME_UINT64)nShardNum);
+}
+
+BOOL XShardAddApp(XSHARDS_T *pShards, unsigned long nKey, SME_APP_T *pApp)
+{
+	XSHARD_KEY_T **ppKey, *pKey;
+	XSHARD_T *pShard;
+	int nShard;
+
+	if (NULL==pShards || NULL==pApp || SME_IS_ACTIVATED(pApp))
+		return FALSE;
+
+	pthread_rwlock_wrlock(&pShards->Lock);
+	ppKey = XFindShardKey(pShards, nKey);
+	if (*ppKey)
+	{
+		pthread_rwlock_unlock(&pShards->Lock);
+		return FALSE;
+	}
+	nShard = (*pShards->pfnRoute)(pShards, nKey, pShards->nShardNum, pShards->pRouteParam);
+	if (nShard<0 || nShard>=pShards->nShardNum 
+		|| NULL == (pKey = (XSHARD_KEY_T*)calloc(1, sizeof(XSHARD_KEY_T))))
+	{
+		pthread_rwlock_unlock(&pShards->Lock);
+		return FALSE;
+	}
+	pShard = &(pShards->pShards[nShard]);
+	/* Urgent, so that the application is activated before the events posted to it at any priority. */
+	if (0 != XPostShardControl(pShard, SME_EVENT_SHARD_ADD_APP, pApp, SME_EVENT_PRIORITY_URGENT))
+	{
+		pthread_rwlock_unlock(&pShards->Lock);
+		free(pKey);
+		return FALSE;
+	}
+	pKey->nKey = nKey;
+	pKey->pApp = pApp;
+	pKey->nShard = nShard;
+	*ppKey = pKey;
+	XAtomicFetchAdd(&pShard->nAppNum, 1);
+	pthread_rwlock_unlock(&pShards->Lock);
+	return TRUE;
+}
+
+BOOL XShardRemoveApp(XSHARDS_T *pShards, unsigned long nKey)
+{
+	XSHARD_KEY_T **ppKey, *pKey;
+	XSHARD_T *pShard;
+
+	if (NULL==pShards)
+		return FALSE;
+
+	pthread_rwlock_wrlock(&pShards->Lock);
+	ppKey = XFindShardKey(pShards, nKey);
+	pKey = *ppKey;
+	if (NULL==pKey)
+	{
+		pthread_rwlock_unlock(&pShards->Lock);
+		return FALSE;
+	}
+	pShard = &(pShards->pShards[pKey->nShard]);
+	if (0 != XPostShardControl(pShard, SME_EVENT_SHARD_REMOVE_APP, pKey->pApp, SME_EVENT_PRIORITY_NORMAL))
+	{
+		pthread_rwlock_unlock(&pShards->Lock);
+		return FALSE;
+	}
+	*ppKey = pKey->pNext;
+	XAtomicFetchAdd(&pShard->nAppNum, -1);
+	pthread_rwlock_unlock(&pShards->Lock);
+	free(pKey);
+	return TRUE;
+}
+
+int XGetKeyShard(XSHARDS_T *pShards, unsigned long nKey)
+{
+	XSHARD_KEY_T *pKey;
+	int nShard = -1;
+
+	if (NULL==pShards)
+		return -1;
+	pthread_rwlock_rdlock(&pShards->Lock);
+	pKey = *XFindShardKey(pShards, nKey);
+	if (pKey)
+		nShard = pKey->nShard;
+	pthread_rwlock_unlock(&pShards->Lock);
+	return nShard;
+}
+
+/* Post an INT or a PTR event to the application of a key under the read lock, so that the key is not removed meanwhile. */
+static int XPostEventToKey(XSHARDS_T *pShards, unsigned long nKey, int nMsgID, BOOL bPtr, int nParam1, int nParam2, 
+						   void *pData, int nDataSize, unsigned char nCategory)
+{
+	XSHARD_KEY_T *pKey;
+	XSHARD_T *pShard;
+	int nRet = -1;
+
+	if (NULL==pShards)
+		return -1;
+
+	pthread_rwlock_rdlock(&pShards->Lock);
+	pKey = *XFindShardKey(pShards, nKey);
+	if (NULL==pKey)
+	{
+		pthread_rwlock_unlock(&pShards->Lock);
+		return -1;
+	}
+	pShard = &(pShards->pShards[pKey->nShard]);
+	if (bPtr)
+		nRet = SmePostThreadExtPtrEvent(&(pShard->ThreadContext), nMsgID, pData, nDataSize, pKey->pApp, 0, nCategory);
+	else
+		nRet = SmePostThreadExtIntEvent(&(pShard->ThreadContext), nMsgID, nParam1, nParam2, pKey->pApp, 0, nCategory);
+	pthread_rwlock_unlock(&pShards->Lock);
+
+	if (0==nRet)
+		XAtomicFetchAdd(&pShard->nPostedNum, 1);
+	else
+		XAtomicFetchAdd(&pShard->nPostFailedNum, 1);
+	return nRet;
+}
+
+int XPostToKey(XSHARDS_T *pShards, unsigned long nKey, int nMsgID, int nParam1, int nParam2, unsigned char nCategory)
+{
+	return XPostEventToKey(pShards, nKey, nMsgID, FALSE, nParam1, nParam2, NULL, 0, nCategory);
+}
+
+int XPostPtrToKey(XSHARDS_T *pShards, unsigned long nKey, int nMsgID, void *pData, int nDataSize, unsigned char nCategory)
+{
+	return XPostEventToKey(pShards, nKey, nMsgID, TRUE, 0, 0, pData, nDataSize, nCategory);
+}
+
+int XGetShardNum(XSHARDS_T *pShards)
+{
+	return pShards ? pShards->nShardNum : 0;
+}
+
+BOOL XGetShardStat(XSHARDS_T *pShards, int nShard, XSHARD_STAT_T *pStat)
+{
+	XSHARD_T *pShard;
+
+	if (NULL==pShards || nShard<0 || nShard>=pShards->nShardNum || NULL==pStat)
+		return FALSE;
+	pShard = &(pShards->pShards[nShard]);
+	pStat->nAppNum = XAtomicLoadAcquire(&pShard->nAppNum);
+	pStat->nPostedNum = XAtomicLoadAcquire(&pShard->nPostedNum);
+	pStat->nPostFailedNum = XAtomicLoadAcquire(&pShard->nPostFailedNum);
+	pStat->nHandledNum = XAtomicLoadAcquire(&pShard->nHandledNum);
+	return TRUE;
+}
+
+SME_THREAD_CONTEXT_T* XGetShardThreadContext(XSHARDS_T *pShards, int nShard)
+{
+	if (NULL==pShards || nShard<0 || nShard>=pShards->nShardNum)
+		return NULL;
+	return &(pShards->pShards[nShard].ThreadContext);
+}
+
+#endif /* SME_LINUX */
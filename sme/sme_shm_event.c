@@ -0,0 +1,292 @@
+/* ==============================================================================================================================
+ * This notice must be untouched at all times.
+ *
+ * Copyright  IntelliWizard Inc. 
+ * All rights reserved.
+ * LICENSE: LGPL. 
+ * Redistributions of source code modifications must send back to the Intelliwizard Project and republish them. 
+ * Web: http://www.intelliwizard.com
+ * eMail: info@intelliwizard.com
+ * We provide technical supports for UML StateWizard users. The StateWizard users do NOT have to pay for technical supports 
+ * from the Intelliwizard team. We accept donation, but it is not mandatory.
+ * ==============================================================================================================================
+ Shared-memory external event transport 
+ Each thread context has an event pool in a shared anonymous mapping, guarded by a process-shared mutex and condition. 
+ The pool of a region process is created by the parent before fork, so that both processes post to and receive from it.
+ The data of a pointer event is copied into the pool, since a pointer is meaningless at the other process.
+*/
+
+#include "sme_shm_event.h"
+#include "sme_ext_event.h"
+#include "sme_cross_platform.h"
+
+#ifdef SME_LINUX
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+typedef struct tagSHMMSG
+{
+	SME_EVENT_ID_T nMsgID;
+	unsigned char nDataFormat ; /* Flag for this event. SME_EVENT_DATA_FORMAT_INT=0, SME_EVENT_DATA_FORMAT_PTR*/
+	unsigned char nCategory ; /* Category of this event. */
+	union SME_EVENT_DATA_T Data; /* Data.Ptr.pData is not used. The pointer data is in DataBuf. */
+	SME_APP_T *pDestApp;
+	unsigned long nSequenceNum;
+	char DataBuf[SME_SHM_EVENT_DATA_SIZE];
+}	X_SHM_MSG_T;
+
+typedef struct tagSHMMSGPOOL
+{
+	unsigned int nMsgBufHdr; /* Free-running counters. */
+	unsigned int nMsgBufRear;
+	pthread_mutex_t MutexForPool;
+	pthread_cond_t EventToThread;
+	X_SHM_MSG_T MsgBuf[SME_SHM_MSG_BUF_SIZE];
+} X_SHM_MSG_POOL_T;
+
+/* A region process may crash holding the mutex. The pool is consistent at each point where the lock can be lost, 
+since an event is only published by the counter update after it is written. */
+static void XShmLock(X_SHM_MSG_POOL_T *pMsgPool)
+{
+	if (EOWNERDEAD == pthread_mutex_lock(&(pMsgPool->MutexForPool)))
+		pthread_mutex_consistent(&(pMsgPool->MutexForPool));
+}
+
+static void XShmUnlock(X_SHM_MSG_POOL_T *pMsgPool)
+{
+	pthread_mutex_unlock(&(pMsgPool->MutexForPool));
+}
+
+BOOL XShmCreateMsgPool(SME_THREAD_CONTEXT_T* pThreadContext)
+{
+	X_SHM_MSG_POOL_T *pMsgPool;
+	pthread_mutexattr_t MutexAttr;
+	pthread_condattr_t CondAttr;
+
+	if (NULL==pThreadContext || NULL!=pThreadContext->pExtEventPool) /* Prevent from creating more than once. */
+		return FALSE;
+
+	/* The mapping is zero filled. */
+	pMsgPool = (X_SHM_MSG_POOL_T*)mmap(NULL, sizeof(X_SHM_MSG_POOL_T), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if (MAP_FAILED==(void*)pMsgPool)
+		return FALSE;
+
+	pthread_mutexattr_init(&MutexAttr);
+	pthread_mutexattr_setpshared(&MutexAttr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&MutexAttr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(&(pMsgPool->MutexForPool), &MutexAttr);
+	pthread_mutexattr_destroy(&MutexAttr);
+
+	pthread_condattr_init(&CondAttr);
+	pthread_condattr_setpshared(&CondAttr, PTHREAD_PROCESS_SHARED);
+	pthread_cond_init(&(pMsgPool->EventToThread), &CondAttr);
+	pthread_condattr_destroy(&CondAttr);
+
+	pThreadContext->pExtEventPool = pMsgPool;
+	return TRUE;
+}
+
+BOOL XShmDestroyMsgPool(SME_THREAD_CONTEXT_T* pThreadContext)
+{
+	X_SHM_MSG_POOL_T *pMsgPool;
+
+	if (NULL==pThreadContext || NULL==pThreadContext->pExtEventPool)
+		return FALSE;
+
+	pMsgPool = (X_SHM_MSG_POOL_T*)(pThreadContext->pExtEventPool);
+	pThreadContext->pExtEventPool = NULL;
+
+	pthread_cond_destroy(&(pMsgPool->EventToThread));
+	pthread_mutex_destroy(&(pMsgPool->MutexForPool));
+	munmap(pMsgPool, sizeof(X_SHM_MSG_POOL_T));
+	return TRUE;
+}
+
+/* Fork a region process without a new program. The child process is killed when the forking thread exits. 
+Return the process ID at the parent, 0 at the child, or -1 on failure. */
+int XShmForkRegionProcess(void)
+{
+	int nPid = fork();
+	if (0==nPid)
+		prctl(PR_SET_PDEATHSIG, SIGKILL);
+	return nPid;
+}
+
+/* Wait for a region process to exit. Return its exit code, or -1 on error. */
+int XShmWaitForRegionProcess(int nPid)
+{
+	int nStatus=0;
+	while (-1 == waitpid(nPid, &nStatus, 0))
+	{
+		if (EINTR != errno)
+			return -1;
+	}
+	return WIFEXITED(nStatus) ? WEXITSTATUS(nStatus) : -1;
+}
+
+/* Initialize the external event buffer at the current thread. */
+BOOL XShmInitMsgBuf()
+{
+	return XShmCreateMsgPool(XGetThreadContext());
+}
+
+/* Free the external event buffer at the current thread. */
+BOOL XShmFreeMsgBuf()
+{
+	return XShmDestroyMsgPool(XGetThreadContext());
+}
+
+/* Post a batch of events to a thread under one lock with one wake-up. 
+An event is dropped if the pool is full or its pointer data is larger than SME_SHM_EVENT_DATA_SIZE. 
+Return -1 if any event is dropped. */
+int XShmPostThreadExtEventBatch(SME_THREAD_CONTEXT_T* pDestThreadContext, const SME_EXT_EVENT_DESC *pEvents, int nNum)
+{
+	X_SHM_MSG_POOL_T *pMsgPool;
+	X_SHM_MSG_T *pMsg;
+	int i, nRet=0;
+	if (NULL==pEvents || nNum<=0 || NULL== pDestThreadContext || NULL==pDestThreadContext->pExtEventPool)
+		return -1;
+
+	pMsgPool = (X_SHM_MSG_POOL_T *)(pDestThreadContext->pExtEventPool);
+
+	XShmLock(pMsgPool);
+	for (i=0; i<nNum; i++)
+	{
+		if (pEvents[i].nMsgID==0)
+			continue;
+		if (pMsgPool->nMsgBufRear - pMsgPool->nMsgBufHdr == SME_SHM_MSG_BUF_SIZE)
+		{
+			nRet = -1;
+			break; // buffer full.
+		}
+		if (SME_EVENT_DATA_FORMAT_PTR == pEvents[i].nDataFormat && pEvents[i].Data.Ptr.nSize > SME_SHM_EVENT_DATA_SIZE)
+		{
+			nRet = -1;
+			continue;
+		}
+
+		pMsg = &(pMsgPool->MsgBuf[pMsgPool->nMsgBufRear % SME_SHM_MSG_BUF_SIZE]);
+		pMsg->nMsgID = pEvents[i].nMsgID;
+		pMsg->nDataFormat = pEvents[i].nDataFormat;
+		pMsg->nCategory = pEvents[i].nCategory;
+		pMsg->pDestApp = pEvents[i].pDestApp;
+		pMsg->nSequenceNum = pEvents[i].nSequenceNum;
+		if (SME_EVENT_DATA_FORMAT_PTR == pEvents[i].nDataFormat)
+		{
+			pMsg->Data.Ptr.pData = NULL;
+			pMsg->Data.Ptr.nSize = (NULL!=pEvents[i].Data.Ptr.pData) ? pEvents[i].Data.Ptr.nSize : 0;
+			if (pMsg->Data.Ptr.nSize > 0)
+				memcpy(pMsg->DataBuf, pEvents[i].Data.Ptr.pData, pMsg->Data.Ptr.nSize);
+		} else
+		{
+			pMsg->Data.Int.nParam1 = pEvents[i].Data.Int.nParam1;
+			pMsg->Data.Int.nParam2 = pEvents[i].Data.Int.nParam2;
+		}
+		pMsgPool->nMsgBufRear++;
+	}
+	pthread_cond_broadcast(&(pMsgPool->EventToThread));
+	XShmUnlock(pMsgPool);
+	return nRet;
+}
+
+int XShmPostThreadExtIntEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, int Param1, int Param2, 
+						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory)
+{
+	SME_EXT_EVENT_DESC Event;
+	if (nMsgID==0)
+		return -1;
+
+	Event.nMsgID = nMsgID;
+	Event.nDataFormat = SME_EVENT_DATA_FORMAT_INT;
+	Event.nCategory = nCategory;
+	Event.Data.Int.nParam1 = Param1;
+	Event.Data.Int.nParam2 = Param2;
+	Event.pDestApp = pDestApp;
+	Event.nSequenceNum = nSequenceNum;
+	return XShmPostThreadExtEventBatch(pDestThreadContext, &Event, 1);
+}
+
+int XShmPostThreadExtPtrEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, void *pData, int nDataSize, 
+						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory)
+{
+	SME_EXT_EVENT_DESC Event;
+	if (nMsgID==0 || nDataSize<0 || nDataSize>SME_SHM_EVENT_DATA_SIZE)
+		return -1;
+
+	Event.nMsgID = nMsgID;
+	Event.nDataFormat = SME_EVENT_DATA_FORMAT_PTR;
+	Event.nCategory = nCategory;
+	Event.Data.Ptr.pData = pData;
+	Event.Data.Ptr.nSize = nDataSize;
+	Event.pDestApp = pDestApp;
+	Event.nSequenceNum = nSequenceNum;
+	return XShmPostThreadExtEventBatch(pDestThreadContext, &Event, 1);
+}
+
+BOOL XShmGetExtEvent(SME_EVENT_T* pEvent)
+{
+	X_SHM_MSG_T NativeMsg;
+	X_SHM_MSG_POOL_T *pMsgPool;
+	SME_THREAD_CONTEXT_T* p = XGetThreadContext();
+	if (NULL==pEvent || NULL==p || NULL==p->pExtEventPool)
+		return FALSE;
+
+	pMsgPool = (X_SHM_MSG_POOL_T*)(p->pExtEventPool);
+
+	while (TRUE)
+	{
+		XShmLock(pMsgPool);
+		while (pMsgPool->nMsgBufHdr == pMsgPool->nMsgBufRear)
+		{
+			if (EOWNERDEAD == pthread_cond_wait(&(pMsgPool->EventToThread), &(pMsgPool->MutexForPool)))
+				pthread_mutex_consistent(&(pMsgPool->MutexForPool));
+		}
+		memcpy(&NativeMsg, &(pMsgPool->MsgBuf[pMsgPool->nMsgBufHdr % SME_SHM_MSG_BUF_SIZE]), sizeof(X_SHM_MSG_T));
+		pMsgPool->nMsgBufHdr++;
+		XShmUnlock(pMsgPool);
+
+		if (NativeMsg.nMsgID == SME_EVENT_EXIT_LOOP)
+		{
+			return FALSE; //Request Exit
+		}
+		else if (SME_EVENT_TIMER == NativeMsg.nMsgID  && SME_TIMER_TYPE_CALLBACK == NativeMsg.Data.Int.nParam1)
+		{
+			// A call back function is not called from the shared pool, which another process may write. Drop it.
+			continue;
+		}
+
+		// Translate the native message to SME event.
+		memset(pEvent,0,sizeof(SME_EVENT_T));
+		pEvent->nEventID = NativeMsg.nMsgID;
+		pEvent->pDestApp = NativeMsg.pDestApp;
+		pEvent->nSequenceNum = NativeMsg.nSequenceNum;
+		pEvent->nDataFormat = NativeMsg.nDataFormat;
+		pEvent->nCategory = SME_EVENT_CAT_OF(NativeMsg.nCategory);
+		pEvent->bIsConsumed = FALSE;
+		if (SME_EVENT_DATA_FORMAT_PTR == NativeMsg.nDataFormat)
+		{
+			pEvent->Data.Ptr.nSize = NativeMsg.Data.Ptr.nSize;
+			if (NativeMsg.Data.Ptr.nSize > 0)
+			{
+#if SME_CPP
+				pEvent->Data.Ptr.pData = new char[NativeMsg.Data.Ptr.nSize];
+#else
+				pEvent->Data.Ptr.pData = malloc(NativeMsg.Data.Ptr.nSize);
+#endif
+				memcpy(pEvent->Data.Ptr.pData, NativeMsg.DataBuf, NativeMsg.Data.Ptr.nSize);
+			}
+		} else
+		{
+			memcpy(&(pEvent->Data),&(NativeMsg.Data), sizeof(union SME_EVENT_DATA_T));
+		}
+		return TRUE;
+	}
+}
+
+BOOL XShmDelExtEvent(SME_EVENT_T *pEvent)
+{
+	return XDelExtEvent(pEvent);
+}
+
+#endif /* SME_LINUX */
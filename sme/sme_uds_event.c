@@ -0,0 +1,554 @@
+/* ==============================================================================================================================
+ * This notice must be untouched at all times.
+ *
+ * Copyright  IntelliWizard Inc. 
+ * All rights reserved.
+ * LICENSE: LGPL. 
+ * Redistributions of source code modifications must send back to the Intelliwizard Project and republish them. 
+ * Web: http://www.intelliwizard.com
+ * eMail: info@intelliwizard.com
+ * We provide technical supports for UML StateWizard users. The StateWizard users do NOT have to pay for technical supports 
+ * from the Intelliwizard team. We accept donation, but it is not mandatory.
+ * ==============================================================================================================================
+ Unix domain socket external event transport 
+ Each event is a packed frame on an AF_UNIX SOCK_SEQPACKET socket, with the pointer data following the header. 
+ A receiving thread owns a socket pair for the events posted within the process, an optional listening socket, 
+ and the sockets accepted from other processes. Frames are sent by sendmmsg() and received by recvmmsg() in batches.
+*/
+
+#include "sme_uds_event.h"
+#include "sme_ext_event.h"
+#include "sme_cross_platform.h"
+
+#ifdef SME_LINUX
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+
+typedef struct tagUDSFRAMEHDR
+{
+	SME_UINT32 nMsgID;
+	SME_UINT32 nSequenceNum;
+	SME_UINT32 nParam1; /* The data size of a pointer event. */
+	SME_UINT32 nParam2;
+	SME_UINT64 nDestApp; /* An opaque token of the destination application at the receiving process. */
+	SME_BYTE nDataFormat;
+	SME_BYTE nCategory;
+} __attribute__((packed)) X_UDS_FRAME_HDR_T;
+
+#define UDS_MAX_DATA_SIZE  (SME_UDS_FRAME_SIZE - (int)sizeof(X_UDS_FRAME_HDR_T))
+
+/* The sending side of a socket. Frames are coalesced in FrameBuf until it is flushed. */
+typedef struct tagUDSSENDER
+{
+	int nSocket;
+	BOOL bCorked;
+	int nFrameNum;
+	pthread_mutex_t MutexForSend;
+	int FrameLen[SME_UDS_BATCH_SIZE];
+	char FrameBuf[SME_UDS_BATCH_SIZE][SME_UDS_FRAME_SIZE];
+} X_UDS_SENDER_T;
+
+/* The external event pool of a receiving thread. A proxy thread context holds an X_UDS_SENDER_T only. */
+typedef struct tagUDSMSGPOOL
+{
+	X_UDS_SENDER_T Sender; /* To the socket pair, for the events posted within the process. */
+	int nSelfSocket;
+	int nListenSocket;
+	char sListenPath[sizeof(((struct sockaddr_un*)0)->sun_path)];
+	int nPeerNum;
+	int PeerSockets[SME_UDS_MAX_PEERS];
+	int nNextSocket; /* The socket to receive from first, for round-robin receiving. */
+	int nFrameNum; /* Received frames in RecvBuf. */
+	int nFrameIdx; /* The next frame to translate. */
+	unsigned int RecvLen[SME_UDS_BATCH_SIZE];
+	char RecvBuf[SME_UDS_BATCH_SIZE][SME_UDS_FRAME_SIZE];
+} X_UDS_MSG_POOL_T;
+
+static void XUdsInitSender(X_UDS_SENDER_T *pSender, int nSocket)
+{
+	pSender->nSocket = nSocket;
+	pSender->bCorked = FALSE;
+	pSender->nFrameNum = 0;
+	pthread_mutex_init(&(pSender->MutexForSend), NULL);
+}
+
+/* Send the pending frames. It is called with MutexForSend locked. Frames which can not be sent at once are dropped, 
+the same as the events posted to a full pool. */
+static int XUdsFlush(X_UDS_SENDER_T *pSender)
+{
+	struct mmsghdr Msgs[SME_UDS_BATCH_SIZE];
+	struct iovec Iovs[SME_UDS_BATCH_SIZE];
+	int i, nSent=0, nRet=0;
+
+	if (0==pSender->nFrameNum)
+		return 0;
+
+	memset(Msgs, 0, sizeof(Msgs));
+	for (i=0; i<pSender->nFrameNum; i++)
+	{
+		Iovs[i].iov_base = pSender->FrameBuf[i];
+		Iovs[i].iov_len = pSender->FrameLen[i];
+		Msgs[i].msg_hdr.msg_iov = &(Iovs[i]);
+		Msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	while (nSent < pSender->nFrameNum)
+	{
+		nRet = sendmmsg(pSender->nSocket, &(Msgs[nSent]), pSender->nFrameNum - nSent, MSG_DONTWAIT|MSG_NOSIGNAL);
+		if (nRet < 0)
+		{
+			if (EINTR == errno)
+				continue;
+			break;
+		}
+		nSent += nRet;
+	}
+
+	pSender->nFrameNum = 0;
+	return (nRet < 0) ? -1 : 0;
+}
+
+/* Append a frame of an event to the sender. Return FALSE if the pointer data is too large for a frame. 
+It is called with MutexForSend locked. */
+static BOOL XUdsAppendFrame(X_UDS_SENDER_T *pSender, const SME_EXT_EVENT_DESC *pEvent)
+{
+	X_UDS_FRAME_HDR_T Hdr;
+	char *pFrame;
+	int nDataSize=0;
+
+	if (SME_EVENT_DATA_FORMAT_PTR == pEvent->nDataFormat && NULL!=pEvent->Data.Ptr.pData)
+		nDataSize = (int)pEvent->Data.Ptr.nSize;
+	if (nDataSize > UDS_MAX_DATA_SIZE)
+		return FALSE;
+
+	if (SME_UDS_BATCH_SIZE == pSender->nFrameNum)
+		XUdsFlush(pSender);
+
+	Hdr.nMsgID = pEvent->nMsgID;
+	Hdr.nSequenceNum = (SME_UINT32)pEvent->nSequenceNum;
+	Hdr.nDestApp = (SME_UINT64)(size_t)pEvent->pDestApp;
+	Hdr.nDataFormat = pEvent->nDataFormat;
+	Hdr.nCategory = pEvent->nCategory;
+	if (SME_EVENT_DATA_FORMAT_PTR == pEvent->nDataFormat)
+	{
+		Hdr.nParam1 = nDataSize;
+		Hdr.nParam2 = 0;
+	} else
+	{
+		Hdr.nParam1 = pEvent->Data.Int.nParam1;
+		Hdr.nParam2 = pEvent->Data.Int.nParam2;
+	}
+
+	pFrame = pSender->FrameBuf[pSender->nFrameNum];
+	memcpy(pFrame, &Hdr, sizeof(Hdr));
+	if (nDataSize > 0)
+		memcpy(pFrame + sizeof(Hdr), pEvent->Data.Ptr.pData, nDataSize);
+	pSender->FrameLen[pSender->nFrameNum] = sizeof(Hdr) + nDataSize;
+	pSender->nFrameNum++;
+	return TRUE;
+}
+
+/* Initialize the external event buffer at the current thread. */
+BOOL XUdsInitMsgBuf()
+{
+	SME_THREAD_CONTEXT_T* pThreadContext = XGetThreadContext();
+	X_UDS_MSG_POOL_T *pMsgPool;
+	int Sockets[2];
+
+	if (NULL==pThreadContext || NULL!=pThreadContext->pExtEventPool) /* Prevent from creating more than once. */
+		return FALSE;
+
+	if (0!=socketpair(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC, 0, Sockets))
+		return FALSE;
+
+	pMsgPool = (X_UDS_MSG_POOL_T*)malloc(sizeof(X_UDS_MSG_POOL_T));
+	if (NULL==pMsgPool)
+	{
+		close(Sockets[0]);
+		close(Sockets[1]);
+		return FALSE;
+	}
+	memset(pMsgPool, 0, sizeof(X_UDS_MSG_POOL_T));
+
+	XUdsInitSender(&(pMsgPool->Sender), Sockets[1]);
+	pMsgPool->nSelfSocket = Sockets[0];
+	pMsgPool->nListenSocket = -1;
+
+	pThreadContext->pExtEventPool = pMsgPool;
+	return TRUE;
+}
+
+/* Free the external event buffer at the current thread. */
+BOOL XUdsFreeMsgBuf()
+{
+	SME_THREAD_CONTEXT_T* pThreadContext = XGetThreadContext();
+	X_UDS_MSG_POOL_T *pMsgPool;
+	int i;
+
+	if (NULL==pThreadContext || NULL==pThreadContext->pExtEventPool)
+		return FALSE;
+
+	pMsgPool = (X_UDS_MSG_POOL_T*)(pThreadContext->pExtEventPool);
+	pThreadContext->pExtEventPool = NULL;
+
+	for (i=0; i<pMsgPool->nPeerNum; i++)
+		close(pMsgPool->PeerSockets[i]);
+	if (pMsgPool->nListenSocket >= 0)
+	{
+		close(pMsgPool->nListenSocket);
+		unlink(pMsgPool->sListenPath);
+	}
+	close(pMsgPool->nSelfSocket);
+	close(pMsgPool->Sender.nSocket);
+	pthread_mutex_destroy(&(pMsgPool->Sender.MutexForSend));
+	free(pMsgPool);
+	return TRUE;
+}
+
+/* Receive the events from other processes at the given path at the current thread. */
+BOOL XUdsListen(const char *sPath)
+{
+	SME_THREAD_CONTEXT_T* pThreadContext = XGetThreadContext();
+	X_UDS_MSG_POOL_T *pMsgPool;
+	struct sockaddr_un Addr;
+	int nSocket;
+
+	if (NULL==sPath || NULL==pThreadContext || NULL==pThreadContext->pExtEventPool)
+		return FALSE;
+
+	pMsgPool = (X_UDS_MSG_POOL_T*)(pThreadContext->pExtEventPool);
+	if (pMsgPool->nListenSocket >= 0 || strlen(sPath) >= sizeof(Addr.sun_path))
+		return FALSE;
+
+	memset(&Addr, 0, sizeof(Addr));
+	Addr.sun_family = AF_UNIX;
+	strcpy(Addr.sun_path, sPath);
+
+	nSocket = socket(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC, 0);
+	if (nSocket < 0)
+		return FALSE;
+
+	unlink(sPath);
+	if (0!=bind(nSocket, (struct sockaddr*)&Addr, sizeof(Addr)) || 0!=listen(nSocket, SOMAXCONN))
+	{
+		close(nSocket);
+		return FALSE;
+	}
+
+	strcpy(pMsgPool->sListenPath, sPath);
+	pMsgPool->nListenSocket = nSocket;
+	return TRUE;
+}
+
+/* Set up a proxy thread context for the thread listening at the given path in another process. */
+BOOL XUdsConnect(SME_THREAD_CONTEXT_T* pProxyThreadContext, const char *sPath)
+{
+	X_UDS_SENDER_T *pSender;
+	struct sockaddr_un Addr;
+	int nSocket;
+
+	if (NULL==pProxyThreadContext || NULL==sPath || strlen(sPath) >= sizeof(Addr.sun_path))
+		return FALSE;
+
+	memset(&Addr, 0, sizeof(Addr));
+	Addr.sun_family = AF_UNIX;
+	strcpy(Addr.sun_path, sPath);
+
+	nSocket = socket(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC, 0);
+	if (nSocket < 0)
+		return FALSE;
+	if (0!=connect(nSocket, (struct sockaddr*)&Addr, sizeof(Addr)))
+	{
+		close(nSocket);
+		return FALSE;
+	}
+
+	pSender = (X_UDS_SENDER_T*)malloc(sizeof(X_UDS_SENDER_T));
+	if (NULL==pSender)
+	{
+		close(nSocket);
+		return FALSE;
+	}
+	XUdsInitSender(pSender, nSocket);
+
+	memset(pProxyThreadContext, 0, sizeof(SME_THREAD_CONTEXT_T));
+	pProxyThreadContext->pExtEventPool = pSender;
+	return TRUE;
+}
+
+BOOL XUdsDisconnect(SME_THREAD_CONTEXT_T* pProxyThreadContext)
+{
+	X_UDS_SENDER_T *pSender;
+
+	if (NULL==pProxyThreadContext || NULL==pProxyThreadContext->pExtEventPool)
+		return FALSE;
+
+	pSender = (X_UDS_SENDER_T*)(pProxyThreadContext->pExtEventPool);
+	pProxyThreadContext->pExtEventPool = NULL;
+
+	pthread_mutex_lock(&(pSender->MutexForSend));
+	XUdsFlush(pSender);
+	pthread_mutex_unlock(&(pSender->MutexForSend));
+
+	close(pSender->nSocket);
+	pthread_mutex_destroy(&(pSender->MutexForSend));
+	free(pSender);
+	return TRUE;
+}
+
+BOOL XUdsCork(SME_THREAD_CONTEXT_T* pDestThreadContext, BOOL bCork)
+{
+	X_UDS_SENDER_T *pSender;
+
+	if (NULL==pDestThreadContext || NULL==pDestThreadContext->pExtEventPool)
+		return FALSE;
+
+	pSender = (X_UDS_SENDER_T*)(pDestThreadContext->pExtEventPool);
+	pthread_mutex_lock(&(pSender->MutexForSend));
+	pSender->bCorked = bCork;
+	if (!bCork)
+		XUdsFlush(pSender);
+	pthread_mutex_unlock(&(pSender->MutexForSend));
+	return TRUE;
+}
+
+/* Post a batch of events to a thread with as few system calls as possible. 
+An event is dropped if its pointer data is larger than a frame, or the socket buffer is full. */
+int XUdsPostThreadExtEventBatch(SME_THREAD_CONTEXT_T* pDestThreadContext, const SME_EXT_EVENT_DESC *pEvents, int nNum)
+{
+	X_UDS_SENDER_T *pSender;
+	int i, nRet=0;
+
+	if (NULL==pEvents || nNum<=0 || NULL== pDestThreadContext || NULL==pDestThreadContext->pExtEventPool)
+		return -1;
+
+	pSender = (X_UDS_SENDER_T*)(pDestThreadContext->pExtEventPool);
+
+	pthread_mutex_lock(&(pSender->MutexForSend));
+	for (i=0; i<nNum; i++)
+	{
+		if (pEvents[i].nMsgID!=0 && !XUdsAppendFrame(pSender, &(pEvents[i])))
+			nRet = -1;
+	}
+	if (!pSender->bCorked && 0!=XUdsFlush(pSender))
+		nRet = -1;
+	pthread_mutex_unlock(&(pSender->MutexForSend));
+	return nRet;
+}
+
+int XUdsPostThreadExtIntEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, int Param1, int Param2, 
+						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory)
+{
+	SME_EXT_EVENT_DESC Event;
+	if (nMsgID==0)
+		return -1;
+
+	Event.nMsgID = nMsgID;
+	Event.nDataFormat = SME_EVENT_DATA_FORMAT_INT;
+	Event.nCategory = nCategory;
+	Event.Data.Int.nParam1 = Param1;
+	Event.Data.Int.nParam2 = Param2;
+	Event.pDestApp = pDestApp;
+	Event.nSequenceNum = nSequenceNum;
+	return XUdsPostThreadExtEventBatch(pDestThreadContext, &Event, 1);
+}
+
+int XUdsPostThreadExtPtrEvent(SME_THREAD_CONTEXT_T* pDestThreadContext, int nMsgID, void *pData, int nDataSize, 
+						   SME_APP_T *pDestApp, unsigned long nSequenceNum,unsigned char nCategory)
+{
+	SME_EXT_EVENT_DESC Event;
+	if (nMsgID==0 || nDataSize<0)
+		return -1;
+
+	Event.nMsgID = nMsgID;
+	Event.nDataFormat = SME_EVENT_DATA_FORMAT_PTR;
+	Event.nCategory = nCategory;
+	Event.Data.Ptr.pData = pData;
+	Event.Data.Ptr.nSize = nDataSize;
+	Event.pDestApp = pDestApp;
+	Event.nSequenceNum = nSequenceNum;
+	return XUdsPostThreadExtEventBatch(pDestThreadContext, &Event, 1);
+}
+
+/* Receive a batch of frames from the socket. Return FALSE if the peer has closed the socket. */
+static BOOL XUdsRecvFrames(X_UDS_MSG_POOL_T *pMsgPool, int nSocket)
+{
+	struct mmsghdr Msgs[SME_UDS_BATCH_SIZE];
+	struct iovec Iovs[SME_UDS_BATCH_SIZE];
+	int i, nRet;
+
+	memset(Msgs, 0, sizeof(Msgs));
+	for (i=0; i<SME_UDS_BATCH_SIZE; i++)
+	{
+		Iovs[i].iov_base = pMsgPool->RecvBuf[i];
+		Iovs[i].iov_len = SME_UDS_FRAME_SIZE;
+		Msgs[i].msg_hdr.msg_iov = &(Iovs[i]);
+		Msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	nRet = recvmmsg(nSocket, Msgs, SME_UDS_BATCH_SIZE, MSG_DONTWAIT, NULL);
+	if (nRet < 0)
+		return (EAGAIN==errno || EWOULDBLOCK==errno || EINTR==errno);
+
+	/* A frame is never empty, so an empty message stands for the end of the connection. */
+	for (i=0; i<nRet; i++)
+	{
+		if (0==Msgs[i].msg_len)
+			break;
+		pMsgPool->RecvLen[i] = Msgs[i].msg_len;
+	}
+	pMsgPool->nFrameNum = i;
+	pMsgPool->nFrameIdx = 0;
+	return (i==nRet && nRet>0);
+}
+
+/* Wait for and receive frames from the socket pair, the listening socket or a peer socket, round-robin. */
+static void XUdsWaitForFrames(X_UDS_MSG_POOL_T *pMsgPool)
+{
+	struct pollfd Fds[SME_UDS_MAX_PEERS+2];
+	int i, k, nFdNum=0, nSocket;
+
+	Fds[nFdNum++].fd = pMsgPool->nSelfSocket;
+	if (pMsgPool->nListenSocket >= 0)
+		Fds[nFdNum++].fd = pMsgPool->nListenSocket;
+	for (i=0; i<pMsgPool->nPeerNum; i++)
+		Fds[nFdNum++].fd = pMsgPool->PeerSockets[i];
+	for (i=0; i<nFdNum; i++)
+	{
+		Fds[i].events = POLLIN;
+		Fds[i].revents = 0;
+	}
+
+	if (poll(Fds, nFdNum, -1) <= 0)
+		return;
+
+	for (k=0; k<nFdNum; k++)
+	{
+		i = (pMsgPool->nNextSocket + k) % nFdNum;
+		if (0==Fds[i].revents)
+			continue;
+		pMsgPool->nNextSocket = i+1;
+
+		nSocket = Fds[i].fd;
+		if (nSocket == pMsgPool->nListenSocket)
+		{
+			nSocket = accept4(nSocket, NULL, NULL, SOCK_CLOEXEC);
+			if (nSocket < 0)
+				return;
+			if (pMsgPool->nPeerNum < SME_UDS_MAX_PEERS)
+				pMsgPool->PeerSockets[pMsgPool->nPeerNum++] = nSocket;
+			else
+				close(nSocket);
+			return;
+		}
+
+		if (!XUdsRecvFrames(pMsgPool, nSocket) && nSocket != pMsgPool->nSelfSocket)
+		{
+			/* The peer process has closed the connection. Remove it. */
+			int j;
+			for (j=0; j<pMsgPool->nPeerNum; j++)
+			{
+				if (pMsgPool->PeerSockets[j] == nSocket)
+				{
+					pMsgPool->PeerSockets[j] = pMsgPool->PeerSockets[--pMsgPool->nPeerNum];
+					break;
+				}
+			}
+			close(nSocket);
+		}
+		return;
+	}
+}
+
+/* Is the application active at the thread? The destination of a frame from another process is an untrusted token 
+until it is found among the active applications. */
+static BOOL XUdsIsActiveApp(SME_THREAD_CONTEXT_T* pThreadContext, SME_APP_T *pApp)
+{
+	SME_APP_T *pActApp;
+	for (pActApp = pThreadContext->pActAppHdr; NULL!=pActApp; pActApp = pActApp->pNext)
+	{
+		if (pActApp == pApp)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+BOOL XUdsGetExtEvent(SME_EVENT_T* pEvent)
+{
+	X_UDS_FRAME_HDR_T Hdr;
+	X_UDS_MSG_POOL_T *pMsgPool;
+	char *pFrame;
+	unsigned int nLen;
+	SME_THREAD_CONTEXT_T* p = XGetThreadContext();
+	if (NULL==pEvent || NULL==p || NULL==p->pExtEventPool)
+		return FALSE;
+
+	pMsgPool = (X_UDS_MSG_POOL_T*)(p->pExtEventPool);
+
+	while (TRUE)
+	{
+		if (pMsgPool->nFrameIdx >= pMsgPool->nFrameNum)
+		{
+			XUdsWaitForFrames(pMsgPool);
+			continue;
+		}
+
+		pFrame = pMsgPool->RecvBuf[pMsgPool->nFrameIdx];
+		nLen = pMsgPool->RecvLen[pMsgPool->nFrameIdx];
+		pMsgPool->nFrameIdx++;
+		if (nLen < sizeof(Hdr))
+			continue;
+		memcpy(&Hdr, pFrame, sizeof(Hdr));
+
+		if (Hdr.nMsgID == SME_EVENT_EXIT_LOOP)
+		{
+			return FALSE; //Request Exit
+		}
+		else if (SME_EVENT_TIMER == Hdr.nMsgID  && SME_TIMER_TYPE_CALLBACK == Hdr.nParam1)
+		{
+			// A frame can not carry a call back function, which is meaningless at another process. Drop it.
+			continue;
+		}
+		else if (0!=Hdr.nDestApp && !XUdsIsActiveApp(p, (SME_APP_T*)(size_t)Hdr.nDestApp))
+		{
+			continue; // No such application at this thread.
+		}
+
+		// Translate the frame to SME event.
+		memset(pEvent,0,sizeof(SME_EVENT_T));
+		pEvent->nEventID = Hdr.nMsgID;
+		pEvent->pDestApp = (SME_APP_T*)(size_t)Hdr.nDestApp;
+		pEvent->nSequenceNum = Hdr.nSequenceNum;
+		pEvent->nDataFormat = Hdr.nDataFormat;
+		pEvent->nCategory = SME_EVENT_CAT_OF(Hdr.nCategory);
+		pEvent->bIsConsumed = FALSE;
+		if (SME_EVENT_DATA_FORMAT_PTR == Hdr.nDataFormat)
+		{
+			if (Hdr.nParam1 > nLen - sizeof(Hdr))
+				continue; // Truncated frame.
+			pEvent->Data.Ptr.nSize = Hdr.nParam1;
+			if (Hdr.nParam1 > 0)
+			{
+#if SME_CPP
+				pEvent->Data.Ptr.pData = new char[Hdr.nParam1];
+#else
+				pEvent->Data.Ptr.pData = malloc(Hdr.nParam1);
+#endif
+				memcpy(pEvent->Data.Ptr.pData, pFrame + sizeof(Hdr), Hdr.nParam1);
+			}
+		} else
+		{
+			pEvent->Data.Int.nParam1 = Hdr.nParam1;
+			pEvent->Data.Int.nParam2 = Hdr.nParam2;
+		}
+		return TRUE;
+	}
+}
+
+BOOL XUdsDelExtEvent(SME_EVENT_T *pEvent)
+{
+	return XDelExtEvent(pEvent);
+}
+
+#endif /* SME_LINUX */
@@ -0,0 +1,40 @@
+/* ==============================================================================================================================
+ * This notice must be untouched at all times.
+ *
+ * Copyright  IntelliWizard Inc. 
+ * All rights reserved.
+ * LICENSE: LGPL. 
+ * Redistributions of source code modifications must send back to the Intelliwizard Project and republish them. 
+ * Web: http://www.intelliwizard.com
+ * eMail: info@intelliwizard.com
+ * We provide technical supports for UML StateWizard users. The StateWizard users do NOT have to pay for technical supports 
+ * from the Intelliwizard team. We accept donation, but it is not mandatory.
+ * ==============================================================================================================================*/
+// sme_test.h
+// The common definitions of the test drivers. Each driver is a program which returns 0 if all its checks pass.
+
+#ifndef _SME_TEST_H_
+#define _SME_TEST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "sme.h"
+#include "sme_cross_platform.h"
+#include "sme_debug.h"
+
+// Report the failed check and exit the driver with 1.
+#define SME_TEST_CHECK(_Expr) \
+	do { if (!(_Expr)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #_Expr); exit(1); } } while (0)
+
+// Sleep for the given milli-seconds.
+#define SME_TEST_SLEEP(_nMs) usleep((_nMs)*1000)
+
+// Poll the expression every milli-second until it is met, for _nMs milli-seconds at most.
+#define SME_TEST_WAIT(_Expr, _nMs) \
+	do { int _nWait = 0; while (!(_Expr) && _nWait++ < (_nMs)) SME_TEST_SLEEP(1); } while (0)
+
+// The debug build traces every event to SME_DEF_DBGLOG_FILE, which is too slow for the timing of the drivers.
+#define SME_TEST_INIT() SME_TURN_OFF_ALL_MODULE_TRACERS()
+
+#endif
@@ -0,0 +1,170 @@
+/* ==============================================================================================================================
+ * This notice must be untouched at all times.
+ *
+ * Copyright  IntelliWizard Inc. 
+ * All rights reserved.
+ * LICENSE: LGPL. 
+ * Redistributions of source code modifications must send back to the Intelliwizard Project and republish them. 
+ * Web: http://www.intelliwizard.com
+ * eMail: info@intelliwizard.com
+ * We provide technical supports for UML StateWizard users. The StateWizard users do NOT have to pay for technical supports 
+ * from the Intelliwizard team. We accept donation, but it is not mandatory.
+ * ==============================================================================================================================*/
+// sme_test_executor.c
+// Run applications on the executor workers: the events of an application are handled in posting order and never by two 
+// workers at once, the internal events and the state timers go to the application itself, and a removed application 
+// takes no more events.
+
+#include <string.h>
+#include "sme_test.h"
+#include "sme_executor.h"
+#include "sme_hr_timer.h"
+
+enum { EVT_COUNT=1, EVT_INTERNAL, EVT_PING, EVT_PTR };
+
+#define TEST_APP_NUM	10
+#define TEST_EVENT_NUM	100
+#define TEST_TIMEOUT	500
+
+typedef struct tagTEST_APP_DATA_T
+{
+	int nNext;
+	int bBusy;
+	int nInternal;
+	int nPing;
+	int nPtr;
+	int nTimeout;
+	int nBad;
+} TEST_APP_DATA_T;
+
+static SME_APP_T *g_pApps[TEST_APP_NUM];
+static TEST_APP_DATA_T g_AppData[TEST_APP_NUM];
+
+static int OnCount(SME_APP_T *pApp, SME_EVENT_T *pEvent)
+{
+	TEST_APP_DATA_T *pData = (TEST_APP_DATA_T*)pApp->pData;
+	int nApp = (int)(pData - g_AppData);
+
+	if (XAtomicFetchAdd(&(pData->bBusy), 1))
+		pData->nBad++;
+	if ((int)pEvent->Data.Int.nParam1 != pData->nNext)
+		pData->nBad++;
+	pData->nNext++;
+	if (0 == pData->nNext % 50)
+		SmePostEvent(SmeCreateIntEvent(EVT_INTERNAL, 0, 0, SME_EVENT_CAT_OTHER, NULL));
+	if (TEST_EVENT_NUM == pData->nNext)
+		SmePostThreadExtIntEvent(NULL, EVT_PING, nApp, 0, g_pApps[(nApp+1)%TEST_APP_NUM], 0, SME_EVENT_CAT_OTHER);
+	XAtomicFetchAdd(&(pData->bBusy), -1);
+	return 0;
+}
+
+static int OnInternal(SME_APP_T *pApp, SME_EVENT_T *pEvent)
+{
+	TEST_APP_DATA_T *pData = (TEST_APP_DATA_T*)pApp->pData;
+	if (SME_EVENT_CAT_OTHER != pEvent->nCategory)
+		pData->nBad++;
+	pData->nInternal++;
+	return 0;
+}
+
+static int OnPing(SME_APP_T *pApp, SME_EVENT_T *pEvent)
+{
+	TEST_APP_DATA_T *pData = (TEST_APP_DATA_T*)pApp->pData;
+	if (g_pApps[((int)pEvent->Data.Int.nParam1+1)%TEST_APP_NUM] != pApp)
+		pData->nBad++;
+	XAtomicFetchAdd(&(pData->nPing), 1);
+	return 0;
+}
+
+static int OnPtr(SME_APP_T *pApp, SME_EVENT_T *pEvent)
+{
+	if (6 == pEvent->Data.Ptr.nSize && 0 == strcmp((char*)pEvent->Data.Ptr.pData, "hello"))
+		((TEST_APP_DATA_T*)pApp->pData)->nPtr++;
+	return 0;
+}
+
+static int OnTimeout(SME_APP_T *pApp, SME_EVENT_T *pEvent)
+{
+	TEST_APP_DATA_T *pData = (TEST_APP_DATA_T*)pApp->pData;
+	if (SME_EVENT_STATE_TIMER != pEvent->nEventID)
+		pData->nBad++;
+	pData->nTimeout++;
+	return 0;
+}
+
+SME_LEAF_STATE_DECLARE(Idle)
+SME_LEAF_STATE_DECLARE(Done)
+SME_COMP_STATE_DECLARE(Worker)
+
+#define SME_CURR_DEFAULT_PARENT Worker
+
+SME_BEGIN_ROOT_COMP_STATE_DEF(Worker, SME_NULL_ACTION, SME_NULL_ACTION)
+	SME_ON_INIT_STATE(SME_NULL_ACTION, Idle)
+SME_END_STATE_DEF
+
+SME_BEGIN_LEAF_STATE_DEF_P(Idle, SME_NULL_ACTION, SME_NULL_ACTION)
+	SME_ON_INTERNAL_TRAN(EVT_COUNT, OnCount)
+	SME_ON_INTERNAL_TRAN(EVT_INTERNAL, OnInternal)
+	SME_ON_INTERNAL_TRAN(EVT_PING, OnPing)
+	SME_ON_INTERNAL_TRAN(EVT_PTR, OnPtr)
+	SME_ON_STATE_TIMEOUT(TEST_TIMEOUT, OnTimeout, Done)
+SME_END_STATE_DEF
+
+SME_BEGIN_LEAF_STATE_DEF_P(Done, SME_NULL_ACTION, SME_NULL_ACTION)
+	SME_ON_INTERNAL_TRAN(EVT_PING, OnPing)
+SME_END_STATE_DEF
+
+int main()
+{
+	XEXECUTOR_T *pExecutor;
+	int i, k;
+
+	SME_TEST_INIT();
+	SME_TEST_CHECK(0 == XInitHrTimer());
+	SmeSetTimerProc(XSetHrEventTimer, XKillHrTimer);
+
+	pExecutor = XCreateExecutor(4);
+	SME_TEST_CHECK(NULL != pExecutor);
+	for (i=0; i<TEST_APP_NUM; i++)
+	{
+		g_pApps[i] = SmeCreateApp("Worker", i, &SME_COMPSTATE_REF(Worker));
+		g_pApps[i]->pData = &g_AppData[i];
+		SME_TEST_CHECK(XExecutorAddApp(pExecutor, g_pApps[i]));
+	}
+	SME_TEST_CHECK(!XExecutorAddApp(pExecutor, g_pApps[0]));
+
+	for (k=0; k<TEST_EVENT_NUM; k++)
+		for (i=0; i<TEST_APP_NUM; i++)
+			SME_TEST_CHECK(0 == SmePostThreadExtIntEvent(NULL, EVT_COUNT, k, 0, g_pApps[i], 0, SME_EVENT_CAT_OTHER));
+	SmePostThreadExtPtrEvent(NULL, EVT_PTR, (void*)"hello", 6, g_pApps[7], 0, SME_EVENT_CAT_OTHER);
+
+	// Each application pings the next one after its last count event, and its state timer fires at the executor then.
+	for (i=0; i<TEST_APP_NUM; i++)
+	{
+		SME_TEST_WAIT(g_pApps[i]->pAppState == &SME_STATE_REF(Done) && XAtomicLoadAcquire(&(g_AppData[i].nPing)), 
+			TEST_TIMEOUT*10);
+		SME_TEST_CHECK(0 == g_AppData[i].nBad);
+		SME_TEST_CHECK(TEST_EVENT_NUM == g_AppData[i].nNext);
+		SME_TEST_CHECK(TEST_EVENT_NUM/50 == g_AppData[i].nInternal);
+		SME_TEST_CHECK(1 == g_AppData[i].nPing);
+		SME_TEST_CHECK(1 == g_AppData[i].nTimeout);
+		SME_TEST_CHECK(g_pApps[i]->pAppState == &SME_STATE_REF(Done));
+	}
+	SME_TEST_CHECK(1 == g_AppData[7].nPtr);
+
+	for (i=0; i<TEST_APP_NUM; i++)
+		SME_TEST_CHECK(XExecutorRemoveApp(g_pApps[i]));
+	for (i=0; i<TEST_APP_NUM; i++)
+		SME_TEST_WAIT(!SME_IS_ACTIVATED(g_pApps[i]), 1000);
+	SME_TEST_CHECK(-1 == SmePostThreadExtIntEvent(NULL, EVT_PING, 0, 0, g_pApps[0], 0, SME_EVENT_CAT_OTHER));
+	for (i=0; i<TEST_APP_NUM; i++)
+		SME_TEST_CHECK(!SME_IS_ACTIVATED(g_pApps[i]));
+
+	SME_TEST_CHECK(0 == XDestroyExecutor(pExecutor));
+	for (i=0; i<TEST_APP_NUM; i++)
+		SmeDestroyApp(g_pApps[i]);
+	XDestroyHrTimer();
+
+	printf("sme_test_executor: ok\n");
+	return 0;
+}
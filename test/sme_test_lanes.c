@@ -0,0 +1,89 @@
+/* ==============================================================================================================================
+ * This notice must be untouched at all times.
+ *
+ * Copyright  IntelliWizard Inc. 
+ * All rights reserved.
+ * LICENSE: LGPL. 
+ * Redistributions of source code modifications must send back to the Intelliwizard Project and republish them. 
+ * Web: http://www.intelliwizard.com
+ * eMail: info@intelliwizard.com
+ * We provide technical supports for UML StateWizard users. The StateWizard users do NOT have to pay for technical supports 
+ * from the Intelliwizard team. We accept donation, but it is not mandatory.
+ * ==============================================================================================================================*/
+// sme_test_lanes.c
+// Post external events from waves of producer threads, more producers than lanes in all, while the receiving thread 
+// takes them: every event arrives, in posting order per producer, and the lanes of the exited producers are taken over.
+
+#include <pthread.h>
+#include "sme_test.h"
+#include "sme_ext_event.h"
+
+#define TEST_EVENT_ID		1
+#define TEST_WAVE_NUM		4
+#define TEST_WAVE_SIZE		(SME_MAX_EXT_EVENT_LANES/2 + 1)
+#define TEST_PRODUCER_NUM	(TEST_WAVE_NUM * TEST_WAVE_SIZE)
+#define TEST_EVENT_NUM		5000
+
+static SME_THREAD_CONTEXT_T g_Receiver;
+
+// Post the events of a producer, retrying while the pool is full.
+static void* ProducerProc(void *pParam)
+{
+	int nProducer = (int)(long)pParam;
+	int i;
+
+	for (i=0; i<TEST_EVENT_NUM; i++)
+	{
+		while (0 != XPostThreadExtIntEvent(&g_Receiver, TEST_EVENT_ID, nProducer, i, NULL, 0, SME_EVENT_CAT_OTHER))
+			sched_yield();
+	}
+	return NULL;
+}
+
+int main()
+{
+	pthread_t Producers[TEST_WAVE_SIZE];
+	int nLast[TEST_PRODUCER_NUM];
+	int nWave, i, nGot = 0;
+	SME_EVENT_T Event;
+
+	SME_TEST_INIT();
+	SmeSetTlsProc(XSetThreadContext, XGetThreadContext);
+	XTlsAlloc();
+	SmeInitEngine(&g_Receiver);
+	SME_TEST_CHECK(XInitMsgBuf());
+
+	for (i=0; i<TEST_PRODUCER_NUM; i++)
+		nLast[i] = -1;
+
+	for (nWave=0; nWave<TEST_WAVE_NUM; nWave++)
+	{
+		for (i=0; i<TEST_WAVE_SIZE; i++)
+			SME_TEST_CHECK(0 == pthread_create(&Producers[i], NULL, ProducerProc, (void*)(long)(nWave*TEST_WAVE_SIZE + i)));
+
+		while (nGot < (nWave+1)*TEST_WAVE_SIZE*TEST_EVENT_NUM)
+		{
+			int nProducer, nSeq;
+			SME_TEST_CHECK(XGetExtEvent(&Event));
+			SME_TEST_CHECK(TEST_EVENT_ID == Event.nEventID);
+			nProducer = (int)Event.Data.Int.nParam1;
+			nSeq = (int)Event.Data.Int.nParam2;
+			SME_TEST_CHECK(nProducer >= nWave*TEST_WAVE_SIZE && nProducer < (nWave+1)*TEST_WAVE_SIZE);
+			SME_TEST_CHECK(nSeq == nLast[nProducer]+1);
+			nLast[nProducer] = nSeq;
+			XDelExtEvent(&Event);
+			nGot++;
+		}
+
+		for (i=0; i<TEST_WAVE_SIZE; i++)
+			pthread_join(Producers[i], NULL);
+	}
+
+	for (i=0; i<TEST_PRODUCER_NUM; i++)
+		SME_TEST_CHECK(TEST_EVENT_NUM-1 == nLast[i]);
+
+	XFreeMsgBuf();
+	XFreeThreadContext(&g_Receiver);
+	printf("sme_test_lanes: ok\n");
+	return 0;
+}
@@ -0,0 +1,147 @@
+/* ==============================================================================================================================
+ * This notice must be untouched at all times.
+ *
+ * Copyright  IntelliWizard Inc. 
+ * All rights reserved.
+ * LICENSE: LGPL. 
+ * Redistributions of source code modifications must send back to the Intelliwizard Project and republish them. 
+ * Web: http://www.intelliwizard.com
+ * eMail: info@intelliwizard.com
+ * We provide technical supports for UML StateWizard users. The StateWizard users do NOT have to pay for technical supports 
+ * from the Intelliwizard team. We accept donation, but it is not mandatory.
+ * ==============================================================================================================================*/
+// sme_test_region.c
+// Fork the events of the parallel regions of an orthogonal state to the workers of an executor: each region handles 
+// every event and the internal events it posts, the regions run on more than one thread, and the parent thread goes on 
+// after all of them.
+
+#include <pthread.h>
+#include "sme_test.h"
+#include "sme_ext_event.h"
+#include "sme_executor.h"
+
+enum { EVT_WORK=1, EVT_STEP, EVT_ENTER };
+
+#define TEST_REGION_NUM		4
+#define TEST_WORK_NUM		3
+#define TEST_MAX_THREADS	16
+
+static SME_THREAD_CONTEXT_T g_Ctx;
+static pthread_mutex_t g_Mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t g_Threads[TEST_MAX_THREADS];
+static int g_nThreadNum;
+static int g_nWorks;
+static int g_nSteps;
+static int g_nTopWorks;
+static int g_nBad;
+
+// Count an event which a region of SME_RUN_MODE_PARALLEL should handle, or the root application otherwise.
+static void CheckRegionEvent(SME_APP_T *pApp, SME_EVENT_T *pEvent, SME_EVENT_ID_T nEventID, BOOL bForkJoin)
+{
+	if (nEventID != pEvent->nEventID || bForkJoin != pApp->bForkJoin)
+		XAtomicFetchAdd(&g_nBad, 1);
+}
+
+static int OnRegionWork(SME_APP_T *pApp, SME_EVENT_T *pEvent)
+{
+	int i;
+
+	CheckRegionEvent(pApp, pEvent, EVT_WORK, TRUE);
+	SME_TEST_SLEEP(20);
+	pthread_mutex_lock(&g_Mutex);
+	for (i=0; i<g_nThreadNum; i++)
+		if (pthread_equal(g_Threads[i], pthread_self()))
+			break;
+	if (i == g_nThreadNum && g_nThreadNum < TEST_MAX_THREADS)
+		g_Threads[g_nThreadNum++] = pthread_self();
+	g_nWorks++;
+	pthread_mutex_unlock(&g_Mutex);
+	SmePostEvent(SmeCreateIntEvent(EVT_STEP, 0, 0, SME_EVENT_CAT_OTHER, NULL));
+	return 0;
+}
+
+static int OnRegionStep(SME_APP_T *pApp, SME_EVENT_T *pEvent)
+{
+	CheckRegionEvent(pApp, pEvent, EVT_STEP, TRUE);
+	XAtomicFetchAdd(&g_nSteps, 1);
+	return 0;
+}
+
+static int OnTopWork(SME_APP_T *pApp, SME_EVENT_T *pEvent)
+{
+	CheckRegionEvent(pApp, pEvent, EVT_WORK, FALSE);
+	g_nTopWorks++;
+	return 0;
+}
+
+SME_COMP_STATE_DECLARE(Region)
+SME_LEAF_STATE_DECLARE(RegionIdle)
+SME_COMP_STATE_DECLARE(Top)
+SME_ORTHO_COMP_STATE_DECLARE(Parallel)
+SME_LEAF_STATE_DECLARE(Waiting)
+
+#define SME_CURR_DEFAULT_PARENT Region
+
+SME_BEGIN_ROOT_COMP_STATE_DEF(Region, SME_NULL_ACTION, SME_NULL_ACTION)
+	SME_ON_INIT_STATE(SME_NULL_ACTION, RegionIdle)
+SME_END_STATE_DEF
+
+SME_BEGIN_LEAF_STATE_DEF_P(RegionIdle, SME_NULL_ACTION, SME_NULL_ACTION)
+	SME_ON_INTERNAL_TRAN(EVT_WORK, OnRegionWork)
+	SME_ON_INTERNAL_TRAN(EVT_STEP, OnRegionStep)
+SME_END_STATE_DEF
+
+#undef SME_CURR_DEFAULT_PARENT
+#define SME_CURR_DEFAULT_PARENT Top
+
+SME_BEGIN_ROOT_COMP_STATE_DEF(Top, SME_NULL_ACTION, SME_NULL_ACTION)
+	SME_ON_INIT_STATE(SME_NULL_ACTION, Waiting)
+SME_END_STATE_DEF
+
+SME_BEGIN_SUB_STATE_DEF_P(Parallel)
+	SME_ON_INTERNAL_TRAN(EVT_WORK, OnTopWork)
+SME_END_STATE_DEF
+
+SME_BEGIN_LEAF_STATE_DEF_P(Waiting, SME_NULL_ACTION, SME_NULL_ACTION)
+	SME_ON_EVENT(EVT_ENTER, SME_NULL_ACTION, Parallel)
+SME_END_STATE_DEF
+
+SME_BEGIN_ORTHO_COMP_STATE_DEF(Parallel, Top, SME_NULL_ACTION, SME_NULL_ACTION)
+	SME_MULTI_REGION_DEF(Region, TEST_REGION_NUM, Region, SME_RUN_MODE_PARALLEL, 0)
+SME_END_ORTHO_STATE_DEF
+
+SME_APPLICATION_DEF(Top, Top)
+
+int main()
+{
+	XEXECUTOR_T *pExecutor;
+	int i;
+
+	SME_TEST_INIT();
+	SmeSetExtEventOprProc(XGetExtEvent, XDelExtEvent, XPostThreadExtIntEvent, XPostThreadExtPtrEvent, XInitMsgBuf, XFreeMsgBuf);
+	SmeSetExtEventBatchProc(XPostThreadExtEventBatch);
+	SmeInitEngine(&g_Ctx);
+	SME_TEST_CHECK(XInitMsgBuf());
+
+	pExecutor = XCreateExecutor(TEST_REGION_NUM);
+	SME_TEST_CHECK(NULL != pExecutor);
+	XSetForkJoinExecutor(pExecutor);
+
+	SmeActivateApp(&SME_GET_APP_VAR(Top), NULL);
+	XPostThreadExtIntEvent(&g_Ctx, EVT_ENTER, 0, 0, NULL, 0, SME_EVENT_CAT_OTHER);
+	for (i=0; i<TEST_WORK_NUM; i++)
+		XPostThreadExtIntEvent(&g_Ctx, EVT_WORK, 0, 0, NULL, 0, SME_EVENT_CAT_OTHER);
+	XPostThreadExtIntEvent(&g_Ctx, SME_EVENT_EXIT_LOOP, 0, 0, NULL, 0, SME_EVENT_CAT_OTHER);
+	SmeRun();
+
+	SME_TEST_CHECK(TEST_REGION_NUM*TEST_WORK_NUM == g_nWorks);
+	SME_TEST_CHECK(TEST_REGION_NUM*TEST_WORK_NUM == g_nSteps);
+	SME_TEST_CHECK(TEST_WORK_NUM == g_nTopWorks);
+	SME_TEST_CHECK(0 == g_nBad);
+	SME_TEST_CHECK(g_nThreadNum > 1);
+
+	XSetForkJoinExecutor(NULL);
+	SME_TEST_CHECK(0 == XDestroyExecutor(pExecutor));
+	printf("sme_test_region: ok\n");
+	return 0;
+}
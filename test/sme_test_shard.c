@@ -0,0 +1,167 @@
+/* ==============================================================================================================================
+ * This notice must be untouched at all times.
+ *
+ * Copyright  IntelliWizard Inc. 
+ * All rights reserved.
+ * LICENSE: LGPL. 
+ * Redistributions of source code modifications must send back to the Intelliwizard Project and republish them. 
+ * Web: http://www.intelliwizard.com
+ * eMail: info@intelliwizard.com
+ * We provide technical supports for UML StateWizard users. The StateWizard users do NOT have to pay for technical supports 
+ * from the Intelliwizard team. We accept donation, but it is not mandatory.
+ * ==============================================================================================================================*/
+// sme_test_shard.c
+// Spread session applications over the shards by key: the events of a key are handled in posting order on one shard 
+// thread, and the applications are entered and exited once at their shards.
+
+#include <pthread.h>
+#include <string.h>
+#include "sme_test.h"
+#include "sme_ext_event.h"
+#include "sme_shard.h"
+
+enum { EVT_DATA=1 };
+
+#define TEST_SHARD_NUM		4
+#define TEST_KEY_NUM		100
+#define TEST_KEY_BASE		1000
+#define TEST_EVENT_NUM		50
+
+typedef struct tagTEST_SESSION_T
+{
+	int nLast;
+	int nCount;
+	pthread_t Thread;
+	int nBad;
+	int nEntered;
+	int nExited;
+} TEST_SESSION_T;
+
+static TEST_SESSION_T g_Sessions[TEST_KEY_NUM];
+
+static int OnSessionEntry(SME_APP_T *pApp, SME_EVENT_T *pEvent)
+{
+	(void)pEvent;
+	((TEST_SESSION_T*)pApp->pData)->nEntered++;
+	return 0;
+}
+
+static int OnSessionExit(SME_APP_T *pApp, SME_EVENT_T *pEvent)
+{
+	(void)pEvent;
+	((TEST_SESSION_T*)pApp->pData)->nExited++;
+	return 0;
+}
+
+static int OnData(SME_APP_T *pApp, SME_EVENT_T *pEvent)
+{
+	TEST_SESSION_T *pSession = (TEST_SESSION_T*)pApp->pData;
+
+	if (0 == pSession->nCount)
+		pSession->Thread = pthread_self();
+	else if (!pthread_equal(pSession->Thread, pthread_self()))
+		pSession->nBad++;
+	if ((int)pEvent->Data.Int.nParam1 != pSession->nLast+1)
+		pSession->nBad++;
+	pSession->nLast = (int)pEvent->Data.Int.nParam1;
+	pSession->nCount++;
+	return 0;
+}
+
+SME_LEAF_STATE_DECLARE(Idle)
+SME_COMP_STATE_DECLARE(Session)
+
+#define SME_CURR_DEFAULT_PARENT Session
+
+SME_BEGIN_ROOT_COMP_STATE_DEF(Session, SME_NULL_ACTION, SME_NULL_ACTION)
+	SME_ON_INIT_STATE(SME_NULL_ACTION, Idle)
+SME_END_STATE_DEF
+
+SME_BEGIN_LEAF_STATE_DEF_P(Idle, OnSessionEntry, OnSessionExit)
+	SME_ON_INTERNAL_TRAN(EVT_DATA, OnData)
+SME_END_STATE_DEF
+
+// Route a new key to the shard with the least applications.
+static int RouteToLeastLoaded(XSHARDS_T *pShards, unsigned long nKey, int nShardNum, void *pParam)
+{
+	XSHARD_STAT_T Stat, Least;
+	int i, nLeast = 0;
+
+	SME_UNUSED_VOIDP_PARAM(pParam);
+	SME_UNUSED_INT_PARAM(nKey);
+	XGetShardStat(pShards, 0, &Least);
+	for (i=1; i<nShardNum; i++)
+	{
+		XGetShardStat(pShards, i, &Stat);
+		if (Stat.nAppNum < Least.nAppNum)
+		{
+			nLeast = i;
+			Least = Stat;
+		}
+	}
+	return nLeast;
+}
+
+// Add the sessions, post the events to their keys and remove them. 
+static void RunSessions(XSHARD_ROUTE_PROC_T pfnRoute)
+{
+	SME_APP_T *pApps[TEST_KEY_NUM];
+	XSHARDS_T *pShards;
+	XSHARD_STAT_T Stat;
+	unsigned long nPosted = 0;
+	int i, j;
+
+	memset(g_Sessions, 0, sizeof(g_Sessions));
+	pShards = XCreateShards(TEST_SHARD_NUM);
+	SME_TEST_CHECK(NULL != pShards && TEST_SHARD_NUM == XGetShardNum(pShards));
+	XSetShardRouteProc(pShards, pfnRoute, NULL);
+
+	for (i=0; i<TEST_KEY_NUM; i++)
+	{
+		pApps[i] = SmeCreateApp("Session", i, &SME_STATE_REF(Session));
+		pApps[i]->pData = &g_Sessions[i];
+		while (!XShardAddApp(pShards, TEST_KEY_BASE+i, pApps[i]))
+			SME_TEST_SLEEP(1);
+	}
+	SME_TEST_CHECK(!XShardAddApp(pShards, TEST_KEY_BASE, pApps[0]));
+
+	for (j=1; j<=TEST_EVENT_NUM; j++)
+		for (i=0; i<TEST_KEY_NUM; i++)
+			while (0 != XPostToKey(pShards, TEST_KEY_BASE+i, EVT_DATA, j, 0, SME_EVENT_CAT_OTHER))
+				SME_TEST_SLEEP(1);
+	SME_TEST_CHECK(0 != XPostToKey(pShards, TEST_KEY_BASE-1, EVT_DATA, 0, 0, SME_EVENT_CAT_OTHER));
+
+	for (i=0; i<TEST_KEY_NUM; i++)
+		while (!XShardRemoveApp(pShards, TEST_KEY_BASE+i))
+			SME_TEST_SLEEP(1);
+	SME_TEST_CHECK(!XShardRemoveApp(pShards, TEST_KEY_BASE));
+
+	for (i=0; i<TEST_SHARD_NUM; i++)
+	{
+		XGetShardStat(pShards, i, &Stat);
+		SME_TEST_CHECK(0 == Stat.nAppNum);
+		nPosted += Stat.nPostedNum;
+	}
+	SME_TEST_CHECK(TEST_EVENT_NUM*TEST_KEY_NUM == nPosted);
+	XDestroyShards(pShards);
+
+	for (i=0; i<TEST_KEY_NUM; i++)
+	{
+		SME_TEST_CHECK(TEST_EVENT_NUM == g_Sessions[i].nCount && 0 == g_Sessions[i].nBad);
+		SME_TEST_CHECK(1 == g_Sessions[i].nEntered && 1 == g_Sessions[i].nExited);
+		SmeDestroyApp(pApps[i]);
+	}
+}
+
+int main()
+{
+	SME_TEST_INIT();
+	SmeSetExtEventOprProc(XGetExtEvent, XDelExtEvent, XPostThreadExtIntEvent, XPostThreadExtPtrEvent, XInitMsgBuf, XFreeMsgBuf);
+	SmeSetExtEventBatchProc(XPostThreadExtEventBatch);
+
+	RunSessions(NULL);
+	RunSessions(RouteToLeastLoaded);
+
+	printf("sme_test_shard: ok\n");
+	return 0;
+}
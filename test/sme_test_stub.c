@@ -0,0 +1,77 @@
+/* ==============================================================================================================================
+ * This notice must be untouched at all times.
+ *
+ * Copyright  IntelliWizard Inc. 
+ * All rights reserved.
+ * LICENSE: LGPL. 
+ * Redistributions of source code modifications must send back to the Intelliwizard Project and republish them. 
+ * Web: http://www.intelliwizard.com
+ * eMail: info@intelliwizard.com
+ * We provide technical supports for UML StateWizard users. The StateWizard users do NOT have to pay for technical supports 
+ * from the Intelliwizard team. We accept donation, but it is not mandatory.
+ * ==============================================================================================================================*/
+// sme_test_stub.c
+// The library is built with NO_THREAD_SUPPORT, where the embedder provides the mutex and event functions of the
+// cross-platform layer. The test drivers provide them on pthreads.
+
+#include <pthread.h>
+#include "sme_test.h"
+
+int XCreateMutex(XMUTEX *pMutex)
+{
+	return pthread_mutex_init(pMutex, NULL);
+}
+
+int XDestroyMutex(XMUTEX *pMutex)
+{
+	return pthread_mutex_destroy(pMutex);
+}
+
+int XMutexLock(XMUTEX *pMutex)
+{
+	return pthread_mutex_lock(pMutex);
+}
+
+int XMutexUnlock(XMUTEX *pMutex)
+{
+	return pthread_mutex_unlock(pMutex);
+}
+
+int XCreateEvent(XEVENT *pEvent)
+{
+	return pthread_cond_init(pEvent, NULL);
+}
+
+int XDestroyEvent(XEVENT *pEvent)
+{
+	return pthread_cond_destroy(pEvent);
+}
+
+// Take the thread-safe actions and wake up the waiting threads.
+int XSignalEvent(XEVENT *pEvent, XMUTEX *pMutex, XTHREAD_SAFE_ACTION_T pAction, void *pActionParam)
+{
+	if (NULL==pEvent || NULL==pMutex)
+		return -1;
+	pthread_mutex_lock(pMutex);
+	if (pAction)
+		(*pAction)(pActionParam);
+	pthread_cond_broadcast(pEvent);
+	pthread_mutex_unlock(pMutex);
+	return 0;
+}
+
+// Wait for the condition once, and take the thread-safe actions unless the wait fails.
+int XWaitForEvent(XEVENT *pEvent, XMUTEX *pMutex, XIS_CODITION_OK_T pIsConditionOK, void *pCondParam,
+				  XTHREAD_SAFE_ACTION_T pAction, void *pActionParam)
+{
+	int ret = 0;
+	if (NULL==pEvent || NULL==pMutex || NULL==pIsConditionOK)
+		return -1;
+	pthread_mutex_lock(pMutex);
+	if (!(*pIsConditionOK)(pCondParam))
+		ret = pthread_cond_wait(pEvent, pMutex);
+	if (0==ret && pAction)
+		(*pAction)(pActionParam);
+	pthread_mutex_unlock(pMutex);
+	return ret;
+}